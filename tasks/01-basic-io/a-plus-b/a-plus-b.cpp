@@ -1,5 +1,252 @@
 #include "a-plus-b.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// The batch interface. a-plus-b.h declares only the scalar Sum, so it is
+// declared here; the tests and the benchmark declare the parts they use.
+
+// out[i] = Sum(a[i], b[i]). All three spans must have the same size; `out`
+// may be the same as `a` or `b`, but must not partially overlap them.
+void Sum(std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out);
+
+// Sum of all values modulo 2^32, like folding them with Sum.
+uint32_t SumAll(std::span<const uint32_t> values);
+
+namespace sum_detail {
+
+// Instruction sets the batch functions are written for, ordered from the
+// slowest. The batch functions above use BestIsa(); the overloads below are
+// for tests and benchmarks, which declare Isa opaquely and go by the values.
+enum class Isa {
+    Scalar = 0,
+    Sse2 = 1,
+    Avx2 = 2,
+    Avx512 = 3,
+};
+
+static_assert(static_cast<int>(Isa::Avx512) == 3,
+              "test.cpp and bench.cpp count 4 instruction sets");
+
+Isa BestIsa();
+
+void Sum(Isa isa, std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out);
+
+uint32_t SumAll(Isa isa, std::span<const uint32_t> values);
+
+}  // namespace sum_detail
+
 uint32_t Sum(uint32_t a, uint32_t b) {
     return a + b;
 }
+
+namespace {
+
+using sum_detail::Isa;
+
+// Every batch kernel handles as many elements as its vectors allow and
+// leaves the tail to the next narrower one, down to the scalar loop, which
+// is defined in terms of the scalar Sum.
+void SumScalar(const uint32_t* a, const uint32_t* b, uint32_t* out,
+               size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = Sum(a[i], b[i]);
+    }
+}
+
+uint32_t SumAllScalar(const uint32_t* values, size_t size) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        sum = Sum(sum, values[i]);
+    }
+    return sum;
+}
+
+#if defined(__x86_64__)
+
+// Integer vector additions wrap around like uint32_t ones do.
+
+void SumSse2(const uint32_t* a, const uint32_t* b, uint32_t* out,
+             size_t size) {
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_add_epi32(x, y));
+    }
+    SumScalar(a + i, b + i, out + i, size - i);
+}
+
+uint32_t Reduce(__m128i acc) {
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0b01'00'11'10));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0b10'11'00'01));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+}
+
+// Several accumulators, so that the additions do not wait for each other.
+uint32_t SumAllSse2(const uint32_t* values, size_t size) {
+    auto* p = reinterpret_cast<const __m128i*>(values);
+    __m128i acc[4] = {};
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16, p += 4) {
+        for (int j = 0; j < 4; ++j) {
+            acc[j] = _mm_add_epi32(acc[j], _mm_loadu_si128(p + j));
+        }
+    }
+    for (; i + 4 <= size; i += 4, ++p) {
+        acc[0] = _mm_add_epi32(acc[0], _mm_loadu_si128(p));
+    }
+    __m128i total = _mm_add_epi32(_mm_add_epi32(acc[0], acc[1]),
+                                  _mm_add_epi32(acc[2], acc[3]));
+    return Sum(Reduce(total), SumAllScalar(values + i, size - i));
+}
+
+__attribute__((target("avx2"))) void SumAvx2(const uint32_t* a,
+                                             const uint32_t* b, uint32_t* out,
+                                             size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i x =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_add_epi32(x, y));
+    }
+    SumSse2(a + i, b + i, out + i, size - i);
+}
+
+__attribute__((target("avx2"))) uint32_t SumAllAvx2(const uint32_t* values,
+                                                    size_t size) {
+    auto* p = reinterpret_cast<const __m256i*>(values);
+    __m256i acc[4] = {};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32, p += 4) {
+        for (int j = 0; j < 4; ++j) {
+            acc[j] = _mm256_add_epi32(acc[j], _mm256_loadu_si256(p + j));
+        }
+    }
+    __m256i total = _mm256_add_epi32(_mm256_add_epi32(acc[0], acc[1]),
+                                     _mm256_add_epi32(acc[2], acc[3]));
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(total),
+                                 _mm256_extracti128_si256(total, 1));
+    return Sum(Reduce(half), SumAllSse2(values + i, size - i));
+}
+
+__attribute__((target("avx512f"))) void SumAvx512(const uint32_t* a,
+                                                  const uint32_t* b,
+                                                  uint32_t* out, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        _mm512_storeu_si512(out + i, _mm512_add_epi32(x, y));
+    }
+    SumAvx2(a + i, b + i, out + i, size - i);
+}
+
+__attribute__((target("avx512f"))) uint32_t SumAllAvx512(
+    const uint32_t* values, size_t size) {
+    __m512i acc[4] = {};
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        for (int j = 0; j < 4; ++j) {
+            acc[j] = _mm512_add_epi32(acc[j],
+                                      _mm512_loadu_si512(values + i + 16 * j));
+        }
+    }
+    __m512i total = _mm512_add_epi32(_mm512_add_epi32(acc[0], acc[1]),
+                                     _mm512_add_epi32(acc[2], acc[3]));
+    // Extracting halves of a zmm register trips -Wuninitialized in GCC 12.
+    alignas(64) uint32_t lanes[16];
+    _mm512_store_si512(lanes, total);
+    __m128i quarter = _mm_setzero_si128();
+    for (int j = 0; j < 4; ++j) {
+        quarter = _mm_add_epi32(
+            quarter, _mm_load_si128(reinterpret_cast<__m128i*>(lanes) + j));
+    }
+    return Sum(Reduce(quarter), SumAllAvx2(values + i, size - i));
+}
+
+#endif
+
+struct Kernels {
+    void (*sum)(const uint32_t*, const uint32_t*, uint32_t*, size_t);
+    uint32_t (*sum_all)(const uint32_t*, size_t);
+};
+
+Isa DetectIsa() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f")) {
+        return Isa::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::Avx2;
+    }
+    return Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+// Instruction sets the CPU does not have fall back to the best one it has.
+Kernels KernelsFor(Isa isa) {
+    switch (std::min(isa, sum_detail::BestIsa())) {
+#if defined(__x86_64__)
+        case Isa::Avx512:
+            return {SumAvx512, SumAllAvx512};
+        case Isa::Avx2:
+            return {SumAvx2, SumAllAvx2};
+        case Isa::Sse2:
+            return {SumSse2, SumAllSse2};
+#endif
+        default:
+            return {SumScalar, SumAllScalar};
+    }
+}
+
+const Kernels& BestKernels() {
+    static const Kernels kernels = KernelsFor(sum_detail::BestIsa());
+    return kernels;
+}
+
+}  // namespace
+
+void Sum(std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out) {
+    assert(a.size() == out.size() && b.size() == out.size());
+    BestKernels().sum(a.data(), b.data(), out.data(), out.size());
+}
+
+uint32_t SumAll(std::span<const uint32_t> values) {
+    return BestKernels().sum_all(values.data(), values.size());
+}
+
+namespace sum_detail {
+
+Isa BestIsa() {
+    static const Isa isa = DetectIsa();
+    return isa;
+}
+
+void Sum(Isa isa, std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out) {
+    assert(a.size() == out.size() && b.size() == out.size());
+    KernelsFor(isa).sum(a.data(), b.data(), out.data(), out.size());
+}
+
+uint32_t SumAll(Isa isa, std::span<const uint32_t> values) {
+    return KernelsFor(isa).sum_all(values.data(), values.size());
+}
+
+}  // namespace sum_detail
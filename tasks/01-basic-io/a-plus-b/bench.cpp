@@ -0,0 +1,99 @@
+#include "a-plus-b.h"
+
+#include <benchmark/compiler.hpp>
+#include <benchmark/timer.hpp>
+#include <pcg-random.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+// Defined in a-plus-b.cpp.
+namespace sum_detail {
+
+// From 0 (scalar) to 3 (avx512), ordered from the slowest.
+enum class Isa;
+
+Isa BestIsa();
+
+void Sum(Isa isa, std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out);
+uint32_t SumAll(Isa isa, std::span<const uint32_t> values);
+
+}  // namespace sum_detail
+
+// Prints the cost per element of adding two arrays of N uint32_t (4096 and
+// 2^24) with the scalar Sum called in a loop and with every batch kernel
+// the CPU supports, and the same for SumAll.
+
+namespace {
+
+using sum_detail::Isa;
+
+constexpr const char* kIsaNames[] = {"scalar", "sse2", "avx2", "avx512"};
+
+template <class F>
+double NanosPerElement(size_t size, F&& f) {
+    constexpr size_t kElementsPerRun = size_t{1} << 28;
+    size_t runs = kElementsPerRun / size;
+    f();
+    CPUTimer timer;
+    for (size_t i = 0; i < runs; ++i) {
+        f();
+    }
+    auto ns = std::chrono::duration<double, std::nano>(
+                  timer.GetTimes().wall_time)
+                  .count();
+    return ns / static_cast<double>(runs * size);
+}
+
+void Bench(size_t size) {
+    PCGRandom rng{4243};
+    std::vector<uint32_t> a(size);
+    std::vector<uint32_t> b(size);
+    std::vector<uint32_t> out(size);
+    for (size_t i = 0; i < size; ++i) {
+        a[i] = rng();
+        b[i] = rng();
+    }
+
+    std::printf("%zu elements, ns per element\n", size);
+    std::printf("%-16s %10s %10s\n", "kernel", "Sum", "SumAll");
+
+    double loop = NanosPerElement(size, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = Sum(a[i], b[i]);
+        }
+        DoNotOptimize(out.data());
+    });
+    double loop_all = NanosPerElement(size, [&] {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum = Sum(sum, a[i]);
+        }
+        DoNotOptimize(sum);
+    });
+    std::printf("%-16s %10.3f %10.3f\n", "scalar call", loop, loop_all);
+
+    for (int i = 0; i <= static_cast<int>(sum_detail::BestIsa()); ++i) {
+        auto isa = static_cast<Isa>(i);
+        double batch = NanosPerElement(size, [&] {
+            sum_detail::Sum(isa, a, b, out);
+            DoNotOptimize(out.data());
+        });
+        double batch_all = NanosPerElement(
+            size, [&] { DoNotOptimize(sum_detail::SumAll(isa, a)); });
+        std::printf("%-16s %10.3f %10.3f\n", kIsaNames[i], batch, batch_all);
+    }
+}
+
+}  // namespace
+
+int main() {
+    // In L1 and in memory.
+    Bench(4096);
+    Bench(size_t{1} << 24);
+    return 0;
+}
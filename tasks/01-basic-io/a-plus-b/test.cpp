@@ -2,9 +2,96 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <pcg-random.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// The batch interface defined in a-plus-b.cpp.
+void Sum(std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out);
+uint32_t SumAll(std::span<const uint32_t> values);
+
+namespace sum_detail {
+
+// From 0 (scalar) to 3 (avx512), see a-plus-b.cpp.
+enum class Isa;
+
+void Sum(Isa isa, std::span<const uint32_t> a, std::span<const uint32_t> b,
+         std::span<uint32_t> out);
+uint32_t SumAll(Isa isa, std::span<const uint32_t> values);
+
+}  // namespace sum_detail
+
 TEST_CASE("Simple") {
     CHECK(Sum(0, 0) == 0);
     CHECK(Sum(10, 123) == 133);
 
     CHECK(Sum(1UL << 31, 1UL << 31) == 0);
 }
+
+using sum_detail::Isa;
+
+constexpr int kIsaCount = 4;
+
+TEST_CASE("Batch") {
+    PCGRandom rng{4243};
+    constexpr size_t kMaxSize = 300;
+
+    std::vector<uint32_t> a(kMaxSize);
+    std::vector<uint32_t> b(kMaxSize);
+    for (size_t i = 0; i < kMaxSize; ++i) {
+        // Plenty of overflows.
+        a[i] = rng() | (1u << 31);
+        b[i] = i % 3 == 0 ? std::numeric_limits<uint32_t>::max() : rng();
+    }
+
+    for (int value = 0; value < kIsaCount; ++value) {
+        auto isa = static_cast<Isa>(value);
+        // Every offset and size, to cover all vector tails.
+        for (size_t offset = 0; offset < 4; ++offset) {
+            for (size_t size = 0; offset + size <= kMaxSize; ++size) {
+                INFO("isa = " << static_cast<int>(isa) << ", offset = "
+                              << offset << ", size = " << size);
+                auto x = std::span<const uint32_t>{a}.subspan(offset, size);
+                auto y = std::span<const uint32_t>{b}.subspan(offset, size);
+
+                std::vector<uint32_t> out(size + 1, 42);
+                sum_detail::Sum(isa, x, y, std::span{out}.first(size));
+                uint32_t expected_all = 0;
+                for (size_t i = 0; i < size; ++i) {
+                    REQUIRE(out[i] == Sum(x[i], y[i]));
+                    expected_all = Sum(expected_all, x[i]);
+                }
+                REQUIRE(out[size] == 42);
+                REQUIRE(sum_detail::SumAll(isa, x) == expected_all);
+            }
+        }
+    }
+}
+
+TEST_CASE("BatchDispatch") {
+    std::vector<uint32_t> a(1000);
+    std::vector<uint32_t> b(1000);
+    for (uint32_t i = 0; i < a.size(); ++i) {
+        a[i] = std::numeric_limits<uint32_t>::max() - i;
+        b[i] = 2 * i;
+    }
+
+    std::vector<uint32_t> out(a.size());
+    Sum(a, b, out);
+    for (uint32_t i = 0; i < a.size(); ++i) {
+        REQUIRE(out[i] == i - 1);
+    }
+
+    // In place.
+    Sum(a, b, a);
+    CHECK(a == out);
+
+    // out[0] is 2^32 - 1, so its sum wraps around.
+    CHECK(SumAll(b) == 999'000);
+    CHECK(SumAll(out) == 499'500 - 1'000);
+    CHECK(SumAll({}) == 0);
+}
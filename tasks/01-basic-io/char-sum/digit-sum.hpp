@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace digit_sum_detail {
+
+inline constexpr size_t kReadBufferSize = 1 << 18;
+inline constexpr size_t kMapWindow = 1 << 24;
+
+inline uint64_t SumDigitsScalar(const char* data, size_t size) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        auto digit = static_cast<uint8_t>(data[i] - '0');
+        sum += digit <= 9 ? digit : 0;
+    }
+    return sum;
+}
+
+#if defined(__x86_64__)
+
+// Every block is handled without branches: bytes are shifted by '0', the
+// ones that are not digits are zeroed, and psadbw adds up each group of
+// eight bytes into a 64-bit lane, which never overflows.
+inline uint64_t SumDigitsSse2(const char* data, size_t size) {
+    const __m128i zero_char = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        auto* p = reinterpret_cast<const __m128i*>(data + i);
+        __m128i d = _mm_sub_epi8(_mm_loadu_si128(p), zero_char);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, nine), d);
+        acc = _mm_add_epi64(acc,
+                            _mm_sad_epu8(_mm_and_si128(d, is_digit), zero));
+    }
+    uint64_t sum = static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+                   static_cast<uint64_t>(
+                       _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+    return sum + SumDigitsScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline uint64_t SumDigitsAvx2(
+    const char* data, size_t size) {
+    const __m256i zero_char = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+
+    size_t i = 0;
+    // Two independent blocks per iteration hide the latency of psadbw.
+    __m256i acc2 = _mm256_setzero_si256();
+    for (; i + 64 <= size; i += 64) {
+        auto* p = reinterpret_cast<const __m256i*>(data + i);
+        __m256i d1 = _mm256_sub_epi8(_mm256_loadu_si256(p), zero_char);
+        __m256i d2 = _mm256_sub_epi8(_mm256_loadu_si256(p + 1), zero_char);
+        __m256i m1 = _mm256_cmpeq_epi8(_mm256_min_epu8(d1, nine), d1);
+        __m256i m2 = _mm256_cmpeq_epi8(_mm256_min_epu8(d2, nine), d2);
+        acc = _mm256_add_epi64(
+            acc, _mm256_sad_epu8(_mm256_and_si256(d1, m1), zero));
+        acc2 = _mm256_add_epi64(
+            acc2, _mm256_sad_epu8(_mm256_and_si256(d2, m2), zero));
+    }
+    acc = _mm256_add_epi64(acc, acc2);
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return sum + SumDigitsSse2(data + i, size - i);
+}
+
+using Kernel = uint64_t (*)(const char*, size_t);
+
+inline Kernel SelectKernel() {
+    return __builtin_cpu_supports("avx2") ? SumDigitsAvx2 : SumDigitsSse2;
+}
+
+#endif
+
+}  // namespace digit_sum_detail
+
+// Sum of all ASCII decimal digits in `data`. Uses AVX2 when the CPU has it
+// and SSE2 otherwise; on other architectures a scalar loop the compiler is
+// free to vectorize.
+inline uint64_t SumDigits(const char* data, size_t size) {
+#if defined(__x86_64__)
+    static const digit_sum_detail::Kernel kernel =
+        digit_sum_detail::SelectKernel();
+    return kernel(data, size);
+#else
+    return digit_sum_detail::SumDigitsScalar(data, size);
+#endif
+}
+
+namespace digit_sum_detail {
+
+// Regular files are mapped a window at a time from the current offset, so
+// memory use does not depend on the file size. Returns 1 if `fd` can not be
+// mapped and has to be read instead.
+inline int SumMapped(int fd, uint64_t* sum) {
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        return 1;
+    }
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    // Files like the ones in /proc report zero size but are not empty.
+    if (offset == -1 || offset >= st.st_size) {
+        return 1;
+    }
+
+    auto page = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+    off_t pos = offset - offset % page;
+    while (pos < st.st_size) {
+        auto len = static_cast<size_t>(
+            std::min<off_t>(kMapWindow, st.st_size - pos));
+        void* window = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, pos);
+        if (window == MAP_FAILED) {
+            // Nothing is consumed yet if the very first window fails.
+            return pos <= offset ? 1 : -errno;
+        }
+        madvise(window, len, MADV_SEQUENTIAL);
+        size_t skip = pos < offset ? static_cast<size_t>(offset - pos) : 0;
+        *sum += SumDigits(static_cast<const char*>(window) + skip, len - skip);
+        munmap(window, len);
+        pos += static_cast<off_t>(len);
+    }
+    lseek(fd, st.st_size, SEEK_SET);
+    return 0;
+}
+
+}  // namespace digit_sum_detail
+
+// Sums the digits of everything readable from `fd` in O(1) memory. Returns
+// 0 or -errno.
+inline int SumDigitsFromFd(int fd, uint64_t* sum) {
+    *sum = 0;
+    if (int res = digit_sum_detail::SumMapped(fd, sum); res <= 0) {
+        return res;
+    }
+
+    auto buf = std::make_unique<char[]>(digit_sum_detail::kReadBufferSize);
+    while (true) {
+        ssize_t res = read(fd, buf.get(), digit_sum_detail::kReadBufferSize);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (res == 0) {
+            return 0;
+        }
+        *sum += SumDigits(buf.get(), static_cast<size_t>(res));
+    }
+}
@@ -1,61 +1,41 @@
-#include <algorithm>
-#include <cctype>  // std::isdigit
+#include "digit-sum.hpp"
+
+#include <cerrno>
 #include <charconv>
-#include <cstddef>
-#include <cstdio>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <fcntl.h>
-#include <string>
-#include <sys/types.h>
-#include <system_error>
-#include <unistd.h>
-#include <vector>
 
-std::vector<char> readStdin() {
-    int numBytes;
-    char buf[BUFSIZ];
-    std::vector<char> input;
-    input.reserve(BUFSIZ);
-    while ((numBytes = read(STDIN_FILENO, buf, BUFSIZ)) > 0) {
-        input.insert(input.end(), buf, buf + numBytes);
-    }
-    return input;
-}
+#include <unistd.h>
 
-int sumDigitsInString(const std::vector<char>& input) {
-    int result = 0;
-    std::for_each(input.begin(), input.end(), [&result](char x) {
-        if (std::isdigit(x)) {
-            result += x - '0';
+int WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t res = write(fd, data, size);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
         }
-    });
-    return result;
-}
-
-void writeStdout(const std::string& str) {
-    auto totalBytes = str.size();
-    ssize_t numBytes = 0;
-    size_t writtenBytes = 0;
-    while ((numBytes = write(STDOUT_FILENO, str.c_str() + writtenBytes,
-                             totalBytes - writtenBytes)) > 0) {
-        writtenBytes += numBytes;
-    }
-    if (write(1, "\n", 1) < 0) {
-        exit(1);
+        data += res;
+        size -= static_cast<size_t>(res);
     }
+    return 0;
 }
 
 int main() {
-    std::vector<char> input = readStdin();
-    int result = sumDigitsInString(input);
-
-    char buf[BUFSIZ];
-    auto [_, ec] = std::to_chars(buf, buf + BUFSIZ, result);
+    uint64_t sum;
+    if (int err = SumDigitsFromFd(STDIN_FILENO, &sum); err != 0) {
+        const char* message = std::strerror(-err);
+        WriteAll(STDERR_FILENO, message, std::strlen(message));
+        WriteAll(STDERR_FILENO, "\n", 1);
+        return EXIT_FAILURE;
+    }
 
-    if (ec != std::errc{}) {
-        writeStdout(std::make_error_code(ec).message());
-    } else {
-        writeStdout(buf);
+    char buf[24];
+    auto [end, _] = std::to_chars(buf, buf + sizeof(buf) - 1, sum);
+    *end++ = '\n';
+    if (WriteAll(STDOUT_FILENO, buf, end - buf) != 0) {
+        return EXIT_FAILURE;
     }
 }
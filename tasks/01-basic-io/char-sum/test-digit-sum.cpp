@@ -0,0 +1,125 @@
+#include "digit-sum.hpp"
+
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr const char* kFileName = "/tmp/deleteme-char-sum";
+
+std::string RandomBytes(size_t size, PCGRandom& rng) {
+    std::string s(size, ' ');
+    for (auto& c : s) {
+        // Mostly digits and their neighbours, to hit the range edges.
+        c = static_cast<char>(rng() % 2 ? '0' - 3 + rng() % 16 : rng());
+    }
+    return s;
+}
+
+uint64_t NaiveSum(std::string_view s) {
+    uint64_t sum = 0;
+    for (char c : s) {
+        if (c >= '0' && c <= '9') {
+            sum += c - '0';
+        }
+    }
+    return sum;
+}
+
+struct TempFile {
+    explicit TempFile(std::string_view data) {
+        fd = open(kFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        INTERNAL_ASSERT(fd != -1);
+        size_t pos = 0;
+        while (pos < data.size()) {
+            ssize_t w = write(fd, data.data() + pos, data.size() - pos);
+            INTERNAL_ASSERT(w > 0);
+            pos += w;
+        }
+        INTERNAL_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    }
+
+    ~TempFile() {
+        close(fd);
+        unlink(kFileName);
+    }
+
+    int fd;
+};
+
+TEST_CASE("Example") {
+    std::string_view s = "1abcd23 4\n";
+    CHECK(SumDigits(s.data(), s.size()) == 10);
+    CHECK(SumDigits(s.data(), 0) == 0);
+}
+
+TEST_CASE("Kernels") {
+    PCGRandom rng{4243};
+    auto data = RandomBytes(1 << 12, rng);
+
+    for (size_t iter = 0; iter < 2000; ++iter) {
+        size_t offset = rng() % 64;
+        size_t size = rng() % (data.size() - offset);
+        std::string_view s{data.data() + offset, size};
+        auto expected = NaiveSum(s);
+
+        REQUIRE(SumDigits(s.data(), s.size()) == expected);
+#if defined(__x86_64__)
+        REQUIRE(digit_sum_detail::SumDigitsSse2(s.data(), s.size()) ==
+                expected);
+        if (__builtin_cpu_supports("avx2")) {
+            REQUIRE(digit_sum_detail::SumDigitsAvx2(s.data(), s.size()) ==
+                    expected);
+        }
+#endif
+    }
+}
+
+TEST_CASE("AllNines") {
+    std::string s(1 << 20, '9');
+    CHECK(SumDigits(s.data(), s.size()) == 9 * s.size());
+}
+
+TEST_CASE("RegularFile") {
+    PCGRandom rng{43};
+    // Spans several mapping windows.
+    auto data = RandomBytes(digit_sum_detail::kMapWindow * 2 + 12345, rng);
+    TempFile file{data};
+
+    uint64_t sum;
+    REQUIRE(SumDigitsFromFd(file.fd, &sum) == 0);
+    CHECK(sum == NaiveSum(data));
+    CHECK(lseek(file.fd, 0, SEEK_CUR) == static_cast<off_t>(data.size()));
+
+    // Starts at the current offset, not at the beginning.
+    REQUIRE(lseek(file.fd, 5000, SEEK_SET) == 5000);
+    REQUIRE(SumDigitsFromFd(file.fd, &sum) == 0);
+    CHECK(sum == NaiveSum(std::string_view{data}.substr(5000)));
+
+    REQUIRE(SumDigitsFromFd(file.fd, &sum) == 0);
+    CHECK(sum == 0);
+}
+
+TEST_CASE("Pipe") {
+    PCGRandom rng{4243};
+    auto data = RandomBytes(10000, rng);
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    REQUIRE(write(fds[1], data.data(), data.size()) ==
+            static_cast<ssize_t>(data.size()));
+    close(fds[1]);
+
+    uint64_t sum;
+    REQUIRE(SumDigitsFromFd(fds[0], &sum) == 0);
+    CHECK(sum == NaiveSum(data));
+    close(fds[0]);
+
+    CHECK(SumDigitsFromFd(-1, &sum) == -EBADF);
+}
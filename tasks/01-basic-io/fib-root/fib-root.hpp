@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include <unistd.h>
+
+namespace fib_detail {
+
+// Every Fibonacci number that fits into uint64_t, numbered as in README:
+// kFibs[i] is the number with index i (1, 1, 2, 3, 5, ...). The table is
+// padded to a power of two with the maximal value so the search below
+// needs no bounds checks.
+inline constexpr size_t kFibCount = 93;
+inline constexpr size_t kTableSize = 128;
+
+inline constexpr auto kFibs = [] {
+    std::array<uint64_t, kTableSize> fibs{};
+    fibs[0] = 1;
+    fibs[1] = 1;
+    for (size_t i = 2; i < kFibCount; ++i) {
+        fibs[i] = fibs[i - 1] + fibs[i - 2];
+    }
+    for (size_t i = kFibCount; i < kTableSize; ++i) {
+        fibs[i] = std::numeric_limits<uint64_t>::max();
+    }
+    return fibs;
+}();
+
+static_assert(kFibs[kFibCount - 1] == 12200160415121876738ull);
+static_assert(kFibs[kFibCount - 1] > kFibs[kFibCount - 2]);
+
+}  // namespace fib_detail
+
+// Index of the largest Fibonacci number not exceeding `x`, -1 for zero.
+//
+// It is the number of table entries <= x minus one. The count is found with
+// a fixed-length binary search whose steps compile to conditional moves, so
+// there are no mispredicted branches however random the input is.
+constexpr int64_t FibRoot(uint64_t x) {
+    using fib_detail::kFibs;
+
+    size_t count = 0;
+    for (size_t step = fib_detail::kTableSize / 2; step > 0; step /= 2) {
+        count += kFibs[count + step - 1] <= x ? step : 0;
+    }
+    // Padding entries compare <= only for the maximal x.
+    count = count < fib_detail::kFibCount ? count : fib_detail::kFibCount;
+    return static_cast<int64_t>(count) - 1;
+}
+
+static_assert(FibRoot(0) == -1);
+static_assert(FibRoot(1) == 1);
+static_assert(FibRoot(4) == 3);
+static_assert(FibRoot(9) == 5);
+static_assert(FibRoot(std::numeric_limits<uint64_t>::max()) == 92);
+
+namespace fib_detail {
+
+inline constexpr size_t kBufferSize = 1 << 16;
+inline constexpr uint8_t kNotHex = 0xff;
+
+inline constexpr auto kHexValue = [] {
+    std::array<uint8_t, 256> values{};
+    for (auto& v : values) {
+        v = kNotHex;
+    }
+    for (int c = '0'; c <= '9'; ++c) {
+        values[c] = static_cast<uint8_t>(c - '0');
+    }
+    for (int c = 'a'; c <= 'f'; ++c) {
+        values[c] = static_cast<uint8_t>(c - 'a' + 10);
+        values[c - 'a' + 'A'] = static_cast<uint8_t>(c - 'a' + 10);
+    }
+    return values;
+}();
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+           c == '\f';
+}
+
+// Lowercase hex without leading zeros, the way std::hex prints int64_t:
+// negative values come out in two's complement.
+inline char* FormatHex(int64_t value, char* out) {
+    auto bits = static_cast<uint64_t>(value);
+    int digits = 1;
+    while (digits < 16 && (bits >> (4 * digits)) != 0) {
+        ++digits;
+    }
+    for (int i = digits - 1; i >= 0; --i) {
+        *out++ = "0123456789abcdef"[(bits >> (4 * i)) & 0xf];
+    }
+    return out;
+}
+
+class Output {
+  public:
+    explicit Output(int fd)
+        : fd_{fd}, buffer_{std::make_unique<char[]>(kBufferSize)} {
+    }
+
+    int PutRoot(int64_t root) {
+        if (size_ + 17 > kBufferSize) {
+            if (int err = Flush(); err != 0) {
+                return err;
+            }
+        }
+        char* end = FormatHex(root, buffer_.get() + size_);
+        *end++ = '\n';
+        size_ = static_cast<size_t>(end - buffer_.get());
+        return 0;
+    }
+
+    int Flush() {
+        size_t done = 0;
+        while (done < size_) {
+            ssize_t res = write(fd_, buffer_.get() + done, size_ - done);
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -errno;
+            }
+            done += static_cast<size_t>(res);
+        }
+        size_ = 0;
+        return 0;
+    }
+
+  private:
+    int fd_;
+    std::unique_ptr<char[]> buffer_;
+    size_t size_ = 0;
+};
+
+}  // namespace fib_detail
+
+// Reads whitespace separated int64_t numbers in hex from `in_fd` and writes
+// their Fibonacci roots in hex to `out_fd`, one per line. Works on fixed
+// buffers, so the amount of numbers is not limited.
+//
+// Like stream extraction with std::hex, an optional 0x prefix is accepted,
+// and processing stops at the first malformed or out of range number. A
+// number followed by some other character, like "12g", is still printed
+// before stopping, as extraction reads it and fails on the next one.
+// Returns 0 or -errno.
+inline int PrintFibRoots(int in_fd, int out_fd) {
+    using fib_detail::kHexValue;
+    using fib_detail::kNotHex;
+
+    fib_detail::Output output{out_fd};
+    auto buffer = std::make_unique<char[]>(fib_detail::kBufferSize);
+
+    uint64_t value = 0;
+    int digits = -1;  // In the current number, -1 between numbers.
+    bool prefix_allowed = false;
+    bool malformed = false;
+    bool stopped = false;
+
+    while (!malformed && !stopped) {
+        ssize_t res = read(in_fd, buffer.get(), fib_detail::kBufferSize);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (res == 0) {
+            break;
+        }
+
+        for (ssize_t i = 0; i < res; ++i) {
+            char c = buffer[i];
+            uint8_t hex = kHexValue[static_cast<uint8_t>(c)];
+            if (hex != kNotHex) {
+                if (digits == -1) {
+                    digits = 0;
+                    value = 0;
+                    prefix_allowed = hex == 0;
+                } else {
+                    prefix_allowed = false;
+                }
+                // Values above INT64_MAX do not fit into int64_t.
+                if (value > (std::numeric_limits<int64_t>::max() >> 4)) {
+                    malformed = true;
+                    break;
+                }
+                value = (value << 4) | hex;
+                ++digits;
+            } else if (fib_detail::IsSpace(c)) {
+                if (digits == 0) {
+                    malformed = true;  // A bare "0x".
+                    break;
+                }
+                if (digits != -1) {
+                    if (int err = output.PutRoot(FibRoot(value)); err != 0) {
+                        return err;
+                    }
+                    digits = -1;
+                }
+            } else if ((c == 'x' || c == 'X') && prefix_allowed) {
+                // "0x" is consumed, the number itself follows.
+                digits = 0;
+                prefix_allowed = false;
+            } else {
+                // Ends the pending number, if any, which is printed below.
+                stopped = true;
+                break;
+            }
+        }
+    }
+    if (!malformed && digits > 0) {
+        if (int err = output.PutRoot(FibRoot(value)); err != 0) {
+            return err;
+        }
+    }
+    return output.Flush();
+}
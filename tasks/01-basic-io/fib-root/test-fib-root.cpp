@@ -0,0 +1,119 @@
+#include "fib-root.hpp"
+
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <ios>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+int64_t NaiveFibRoot(uint64_t x) {
+    if (x == 0) {
+        return -1;
+    }
+    uint64_t a = 1;
+    uint64_t b = 1;
+    int64_t index = 1;
+    // b is the number with the index `index`, a is the previous one.
+    while (b <= x - a && a + b <= x) {
+        uint64_t c = a + b;
+        a = b;
+        b = c;
+        ++index;
+    }
+    return index;
+}
+
+// Feeds `input` to PrintFibRoots and returns what it printed.
+std::string Run(const std::string& input) {
+    int in = memfd_create("in", MFD_CLOEXEC);
+    int out = memfd_create("out", MFD_CLOEXEC);
+    INTERNAL_ASSERT(in != -1);
+    INTERNAL_ASSERT(out != -1);
+    INTERNAL_ASSERT(write(in, input.data(), input.size()) ==
+                    static_cast<ssize_t>(input.size()));
+    INTERNAL_ASSERT(lseek(in, 0, SEEK_SET) == 0);
+    INTERNAL_ASSERT(PrintFibRoots(in, out) == 0);
+
+    std::string result;
+    char buf[4096];
+    ssize_t r;
+    while ((r = pread(out, buf, sizeof(buf), result.size())) > 0) {
+        result.append(buf, r);
+    }
+    close(in);
+    close(out);
+    return result;
+}
+
+// The stream-based implementation this replaces.
+std::string Reference(const std::string& input) {
+    std::stringstream in(input);
+    std::stringstream out;
+    in >> std::hex;
+    out << std::hex;
+    int64_t number;
+    while (in >> number) {
+        out << FibRoot(number) << "\n";
+    }
+    return out.str();
+}
+
+TEST_CASE("Table") {
+    for (uint64_t x = 0; x < 10000; ++x) {
+        REQUIRE(FibRoot(x) == NaiveFibRoot(x));
+    }
+    for (size_t i = 3; i < fib_detail::kFibCount; ++i) {
+        uint64_t f = fib_detail::kFibs[i];
+        CHECK(FibRoot(f - 1) == static_cast<int64_t>(i) - 1);
+        CHECK(FibRoot(f) == static_cast<int64_t>(i));
+        CHECK(FibRoot(f + 1) == static_cast<int64_t>(i));
+    }
+    PCGRandom rng{4243};
+    for (size_t i = 0; i < 100000; ++i) {
+        uint64_t x = (static_cast<uint64_t>(rng()) << 32 | rng()) >>
+                     (rng() % 64);
+        REQUIRE(FibRoot(x) == NaiveFibRoot(x));
+    }
+}
+
+TEST_CASE("Example") {
+    CHECK(Run("1 2 3 9 20\n") == "1\n2\n3\n5\n7\n");
+    CHECK(Run("") == "");
+    CHECK(Run("7fffffffffffffff") == "5b\n");
+}
+
+TEST_CASE("Format") {
+    CHECK(Run("0x20\n0XA  \t\n  0 ") == "7\n5\nffffffffffffffff\n");
+    CHECK(Run("1 2 zz 3") == "1\n2\n");
+    CHECK(Run("1 0x 3") == "1\n");
+    CHECK(Run("1 8000000000000000 3") == "1\n");
+    CHECK(Run("00000000000000000001 5") == "1\n4\n");
+
+    // A number glued to a non-digit is read, the next extraction fails.
+    CHECK(Run("1 12g 3") == "1\n6\n");
+    CHECK(Run("1 12g 3") == Reference("1 12g 3"));
+    CHECK(Run("5 0x1f_ 2") == Reference("5 0x1f_ 2"));
+    CHECK(Run("5\n-") == Reference("5\n-"));
+}
+
+TEST_CASE("Random") {
+    PCGRandom rng{43};
+    std::stringstream input;
+    input << std::hex;
+    // Far more than one read buffer, so numbers cross buffer boundaries.
+    for (size_t i = 0; i < 100000; ++i) {
+        uint64_t x = (static_cast<uint64_t>(rng()) << 31 | rng()) >>
+                     (rng() % 63);
+        input << x << (rng() % 4 == 0 ? "\n" : " ");
+    }
+    auto text = input.str();
+    CHECK(Run(text) == Reference(text));
+}
@@ -1,101 +1,272 @@
 #pragma once
 
-#include <cassert>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
 #include <utility>
 
-class List {
+namespace list_detail {
+
+struct Node {
+    Node* left;
+    Node* right;
+    int value;
+};
+
+// Every node is a separate allocation.
+class HeapNodes {
+  public:
+    Node* New(int value, Node* left, Node* right) {
+        return new Node{left, right, value};
+    }
+
+    void Delete(Node* node) {
+        delete node;
+    }
+
+    void Reserve(size_t) {
+    }
+
+    void DeleteAll(Node* head) {
+        while (head != nullptr) {
+            delete std::exchange(head, head->right);
+        }
+    }
+
+    void Adopt(HeapNodes&) {
+    }
+
+    void Swap(HeapNodes&) {
+    }
+};
+
+// Nodes are cut from chunks that are owned by the list, so nodes pushed one
+// after another lie next to each other in memory, and clearing frees the
+// chunks without looking at the nodes. Popped nodes go to a free list and
+// are reused first.
+//
+// The chunks can not be shared between lists, so Splice moves all of the
+// other list's chunks to this one. The other list's spare nodes are kept
+// only if this list has none; otherwise they stay unused until Clear.
+class SlabNodes {
+  public:
+    SlabNodes() = default;
+
+    SlabNodes(const SlabNodes&) = delete;
+    SlabNodes& operator=(const SlabNodes&) = delete;
+
+    ~SlabNodes() {
+        DeleteAll(nullptr);
+    }
+
+    Node* New(int value, Node* left, Node* right) {
+        Node* node;
+        if (free_ != nullptr) {
+            node = std::exchange(free_, free_->right);
+        } else {
+            if (bump_ == bump_end_) {
+                AddChunk(next_capacity_);
+            }
+            node = bump_++;
+        }
+        return new (node) Node{left, right, value};
+    }
+
+    void Delete(Node* node) {
+        node->right = free_;
+        free_ = node;
+    }
+
+    // Makes the next `count` nodes come from one contiguous run.
+    void Reserve(size_t count) {
+        if (free_ == nullptr &&
+            static_cast<size_t>(bump_end_ - bump_) < count) {
+            AddChunk(std::max(count, next_capacity_));
+        }
+    }
+
+    void DeleteAll(Node*) {
+        while (chunks_ != nullptr) {
+            auto* chunk = std::exchange(chunks_, chunks_->next);
+            ::operator delete(chunk);
+        }
+        Forget();
+    }
+
+    void Adopt(SlabNodes& other) {
+        if (other.chunks_ == nullptr) {
+            return;
+        }
+        if (chunks_ == nullptr) {
+            Swap(other);
+            return;
+        }
+        last_chunk_->next = other.chunks_;
+        last_chunk_ = other.last_chunk_;
+        if (free_ == nullptr) {
+            free_ = other.free_;
+        }
+        if (bump_ == bump_end_) {
+            bump_ = other.bump_;
+            bump_end_ = other.bump_end_;
+        }
+        next_capacity_ = std::max(next_capacity_, other.next_capacity_);
+        other.Forget();
+    }
+
+    void Swap(SlabNodes& other) {
+        std::swap(chunks_, other.chunks_);
+        std::swap(last_chunk_, other.last_chunk_);
+        std::swap(free_, other.free_);
+        std::swap(bump_, other.bump_);
+        std::swap(bump_end_, other.bump_end_);
+        std::swap(next_capacity_, other.next_capacity_);
+    }
+
+  private:
+    struct Chunk {
+        Chunk* next;
+    };
+
+    static constexpr size_t kMinChunk = 32;
+    static constexpr size_t kMaxChunk = size_t{1} << 16;
+
+    // Nodes follow the header right away.
+    static_assert(sizeof(Chunk) % alignof(Node) == 0);
+
+    void Forget() {
+        chunks_ = nullptr;
+        last_chunk_ = nullptr;
+        free_ = nullptr;
+        bump_ = nullptr;
+        bump_end_ = nullptr;
+        next_capacity_ = kMinChunk;
+    }
+
+    void AddChunk(size_t capacity) {
+        void* memory = ::operator new(sizeof(Chunk) + capacity * sizeof(Node));
+        auto* chunk = new (memory) Chunk{nullptr};
+        if (chunks_ == nullptr) {
+            chunks_ = chunk;
+        } else {
+            last_chunk_->next = chunk;
+        }
+        last_chunk_ = chunk;
+        bump_ = reinterpret_cast<Node*>(chunk + 1);
+        bump_end_ = bump_ + capacity;
+        next_capacity_ = std::min(capacity * 2, kMaxChunk);
+    }
+
+    Chunk* chunks_ = nullptr;
+    Chunk* last_chunk_ = nullptr;
+    Node* free_ = nullptr;
+    Node* bump_ = nullptr;
+    Node* bump_end_ = nullptr;
+    size_t next_capacity_ = kMinChunk;
+};
+
+}  // namespace list_detail
+
+// `Nodes` decides where the nodes come from, see list_detail.
+template <class Nodes>
+class BasicList {
   public:
     // Non-copyable
-    List(const List&) = delete;
-    List& operator=(const List&) = delete;
+    BasicList(const BasicList&) = delete;
+    BasicList& operator=(const BasicList&) = delete;
 
-    List(List&& other) : List() {
+    BasicList(BasicList&& other) : BasicList() {
         Swap(other);
     }
 
-    List& operator=(List&& other) {
-        List tmp{std::move(other)};
+    BasicList& operator=(BasicList&& other) {
+        BasicList tmp{std::move(other)};
         Swap(tmp);
         return *this;
     }
 
-    List() {
+    BasicList() {
     }
 
-    ~List() {
+    ~BasicList() {
         Clear();
     }
 
     void PushBack(int value) {
-        if (tail == nullptr) {
-            CreateFirstNode(value);
-            return;
+        auto newTail = nodes_.New(value, tail_, nullptr);
+        if (tail_ == nullptr) {
+            head_ = newTail;
+        } else {
+            tail_->right = newTail;
         }
-        auto newTail = new Node{value, tail, nullptr};
-        tail->setRightPtr(newTail);
-        tail = newTail;
+        tail_ = newTail;
     }
 
     void PushFront(int value) {
-        if (tail == nullptr) {
-            CreateFirstNode(value);
-            return;
+        auto newHead = nodes_.New(value, nullptr, head_);
+        if (head_ == nullptr) {
+            tail_ = newHead;
+        } else {
+            head_->left = newHead;
+        }
+        head_ = newHead;
+    }
+
+    // Same as calling PushBack for every value, but the nodes are
+    // allocated in one go when possible.
+    void Append(std::span<const int> values) {
+        nodes_.Reserve(values.size());
+        for (int value : values) {
+            PushBack(value);
         }
-        auto newHead = new Node{value, nullptr, head};
-        head->setLeftPtr(newHead);
-        head = newHead;
     }
 
     void PopBack() {
-        auto newTail = tail->getLeftPtr();
+        auto newTail = tail_->left;
         if (newTail != nullptr) {
-            newTail->setRightPtr(nullptr);
+            newTail->right = nullptr;
         } else {
-            head = nullptr;
+            head_ = nullptr;
         }
-        delete tail;
-        tail = newTail;
+        nodes_.Delete(tail_);
+        tail_ = newTail;
     }
 
     void PopFront() {
-        auto newHead = head->getRightPtr();
+        auto newHead = head_->right;
         if (newHead != nullptr) {
-            newHead->setLeftPtr(nullptr);
+            newHead->left = nullptr;
         } else {
-            tail = nullptr;
+            tail_ = nullptr;
         }
-        delete head;
-        head = newHead;
+        nodes_.Delete(head_);
+        head_ = newHead;
     }
 
     int& Back() {
-        return tail->getValue();
+        return tail_->value;
     }
 
     int& Front() {
-        return head->getValue();
+        return head_->value;
     }
 
     bool IsEmpty() const {
-        return head == nullptr;
+        return head_ == nullptr;
     }
 
-    void Swap(List& other) {
-        std::swap(head, other.head);
-        std::swap(tail, other.tail);
+    void Swap(BasicList& other) {
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        nodes_.Swap(other.nodes_);
     }
 
     void Clear() {
-        if (IsEmpty()) {
-            return;
-        }
-        auto curNode = head;
-        auto nextNode = curNode->getRightPtr();
-        while (curNode != nullptr) {
-            nextNode = curNode->getRightPtr();
-            delete curNode;
-            curNode = nextNode;
-        }
+        nodes_.DeleteAll(head_);
+        head_ = nullptr;
+        tail_ = nullptr;
     }
 
     // https://en.cppreference.com/w/cpp/container/list/splice
@@ -103,80 +274,219 @@ class List {
     // l1 = {1, 2, 3};
     // l1.Splice({4, 5, 6});
     // l1 == {1, 2, 3, 4, 5, 6};
-    void Splice(List& other) {
+    void Splice(BasicList& other) {
         if (other.IsEmpty()) {
             return;
         }
         if (IsEmpty()) {
-            head = other.head;
-            tail = other.tail;
+            head_ = other.head_;
         } else {
-            tail->setRightPtr(other.head);
-            other.head->setLeftPtr(tail);
-            tail = other.tail;
+            tail_->right = other.head_;
+            other.head_->left = tail_;
         }
-        other.head = nullptr;
-        other.tail = nullptr;
+        tail_ = other.tail_;
+        nodes_.Adopt(other.nodes_);
+        other.head_ = nullptr;
+        other.tail_ = nullptr;
     }
 
     template <class F>
     void ForEachElement(F&& f) const {
-        if (IsEmpty()) {
-            return;
-        }
-        auto curNode = head;
-        auto nextNode = curNode->getRightPtr();
-        while (curNode != nullptr) {
-            nextNode = curNode->getRightPtr();
-            f(curNode->getValue());
-            curNode = nextNode;
+        for (auto node = head_; node != nullptr; node = node->right) {
+            f(node->value);
         }
     }
 
   private:
-    class Node {
-        Node* left = nullptr;
-        Node* right = nullptr;  // use unique_ptr
-        int value;
+    using Node = list_detail::Node;
+
+    Node* head_ = nullptr;
+    Node* tail_ = nullptr;
+    Nodes nodes_;
+};
+
+// SlabList is the same list with nodes pooled in chunks, see SlabNodes.
+using List = BasicList<list_detail::HeapNodes>;
+using SlabList = BasicList<list_detail::SlabNodes>;
+
+// Same interface, but every node holds up to kCapacity consecutive values,
+// so walking the list touches one cache line per several elements and
+// allocations happen once per node instead of once per element.
+//
+// Values of a node occupy [begin, end) of its array. Nodes created by
+// PushFront are filled from the right and the ones created by PushBack from
+// the left, so both ends grow in O(1). Splice links nodes as they are, so
+// nodes in the middle may be partially filled.
+class UnrolledList {
+  public:
+    UnrolledList(const UnrolledList&) = delete;
+    UnrolledList& operator=(const UnrolledList&) = delete;
+
+    UnrolledList(UnrolledList&& other) : UnrolledList() {
+        Swap(other);
+    }
 
-      public:
-        Node(int value) : value{value} {
+    UnrolledList& operator=(UnrolledList&& other) {
+        UnrolledList tmp{std::move(other)};
+        Swap(tmp);
+        return *this;
+    }
+
+    UnrolledList() {
+    }
+
+    ~UnrolledList() {
+        Clear();
+    }
+
+    void PushBack(int value) {
+        if (tail_ == nullptr || tail_->end == kCapacity) {
+            LinkBack(NewNode(tail_, nullptr, 0));
         }
+        tail_->values[tail_->end++] = value;
+    }
 
-        Node(int value, Node* left, Node* right)
-            : left{left}, right{right}, value{value} {
+    void PushFront(int value) {
+        if (head_ == nullptr || head_->begin == 0) {
+            LinkFront(NewNode(nullptr, head_, kCapacity));
         }
+        head_->values[--head_->begin] = value;
+    }
 
-        void setLeftPtr(Node* ptr) {
-            left = ptr;
+    void Append(std::span<const int> values) {
+        while (!values.empty()) {
+            if (tail_ == nullptr || tail_->end == kCapacity) {
+                LinkBack(NewNode(tail_, nullptr, 0));
+            }
+            size_t count = std::min<size_t>(values.size(),
+                                            kCapacity - tail_->end);
+            std::copy_n(values.begin(), count, tail_->values + tail_->end);
+            tail_->end += static_cast<uint32_t>(count);
+            values = values.subspan(count);
         }
+    }
 
-        void setRightPtr(Node* ptr) {
-            right = ptr;
+    void PopBack() {
+        if (--tail_->end != tail_->begin) {
+            return;
         }
+        auto node = tail_;
+        tail_ = node->left;
+        if (tail_ != nullptr) {
+            tail_->right = nullptr;
+        } else {
+            head_ = nullptr;
+        }
+        delete node;
+    }
 
-        void setValue(int newValue) {
-            value = newValue;
+    void PopFront() {
+        if (++head_->begin != head_->end) {
+            return;
+        }
+        auto node = head_;
+        head_ = node->right;
+        if (head_ != nullptr) {
+            head_->left = nullptr;
+        } else {
+            tail_ = nullptr;
         }
+        delete node;
+    }
 
-        Node* getLeftPtr() {
-            return left;
+    int& Back() {
+        return tail_->values[tail_->end - 1];
+    }
+
+    int& Front() {
+        return head_->values[head_->begin];
+    }
+
+    bool IsEmpty() const {
+        return head_ == nullptr;
+    }
+
+    void Swap(UnrolledList& other) {
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+    }
+
+    void Clear() {
+        while (head_ != nullptr) {
+            delete std::exchange(head_, head_->right);
         }
+        tail_ = nullptr;
+    }
 
-        Node* getRightPtr() {
-            return right;
+    void Splice(UnrolledList& other) {
+        if (other.IsEmpty()) {
+            return;
+        }
+        if (IsEmpty()) {
+            head_ = other.head_;
+        } else {
+            tail_->right = other.head_;
+            other.head_->left = tail_;
         }
+        tail_ = other.tail_;
+        other.head_ = nullptr;
+        other.tail_ = nullptr;
+    }
 
-        int& getValue() {
-            return value;
+    template <class F>
+    void ForEachElement(F&& f) const {
+        for (auto node = head_; node != nullptr; node = node->right) {
+            for (uint32_t i = node->begin; i < node->end; ++i) {
+                f(node->values[i]);
+            }
         }
+    }
+
+  private:
+    static constexpr size_t kNodeSize = 128;
+
+    static constexpr uint32_t kCapacity =
+        (kNodeSize - 2 * sizeof(void*) - 2 * sizeof(uint32_t)) / sizeof(int);
+
+    // Two cache lines: the links, the bounds and the values.
+    struct alignas(64) Node {
+        Node* left;
+        Node* right;
+        uint32_t begin;
+        uint32_t end;
+        int values[kCapacity];
     };
 
-    Node* head = nullptr;
-    Node* tail = nullptr;
+    static_assert(sizeof(Node) == kNodeSize);
 
-    void CreateFirstNode(int value) {
-        assert(head == nullptr && tail == nullptr);
-        head = tail = new Node{value};
+    // The values are left uninitialized.
+    static Node* NewNode(Node* left, Node* right, uint32_t begin) {
+        auto node = new Node;
+        node->left = left;
+        node->right = right;
+        node->begin = begin;
+        node->end = begin;
+        return node;
     }
+
+    void LinkBack(Node* node) {
+        if (tail_ == nullptr) {
+            head_ = node;
+        } else {
+            tail_->right = node;
+        }
+        tail_ = node;
+    }
+
+    void LinkFront(Node* node) {
+        if (head_ == nullptr) {
+            tail_ = node;
+        } else {
+            head_->left = node;
+        }
+        head_ = node;
+    }
+
+    Node* head_ = nullptr;
+    Node* tail_ = nullptr;
 };
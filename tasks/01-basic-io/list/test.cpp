@@ -2,11 +2,16 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <benchmark/run.hpp>
+#include <build.hpp>
 #include <overload.hpp>
 
+#include <cstdint>
 #include <list>
+#include <numeric>
 #include <random>
 #include <source_location>
+#include <span>
 #include <variant>
 #include <vector>
 
@@ -34,6 +39,10 @@ class CorrectList {
         inner_.push_front(value);
     }
 
+    void Append(std::span<const int> values) {
+        inner_.insert(inner_.end(), values.begin(), values.end());
+    }
+
     void PopBack() {
         inner_.pop_back();
     }
@@ -58,6 +67,10 @@ class CorrectList {
         inner_.swap(other.inner_);
     }
 
+    void Clear() {
+        inner_.clear();
+    }
+
     void Splice(CorrectList& other) {
         inner_.splice(inner_.end(), other.inner_);
     }
@@ -186,7 +199,8 @@ TEST_CASE("Functioning") {
     }
 }
 
-template <class T, class F>
+// Choices 9 and 10 are Append and Clear.
+template <class T, size_t kChoices = 9, class F>
 void Operate(F&& report) {
     static constexpr size_t kMinLists = 5;
     static constexpr size_t kMaxLists = 20;
@@ -207,7 +221,7 @@ void Operate(F&& report) {
     };
 
     for (size_t i = 0; i < 200'000; ++i) {
-        auto choice = rng() % 9;
+        auto choice = rng() % kChoices;
         switch (choice) {
         case 0: {
             if (lists.size() == kMaxLists) {
@@ -291,11 +305,35 @@ void Operate(F&& report) {
             lists[idx1] = std::move(lists[idx2]);
             break;
         }
+        case 9: {
+            auto& l = lists[pick_one()];
+            int values[64];
+            auto count = rng() % std::size(values);
+            for (size_t j = 0; j < count; ++j) {
+                values[j] = static_cast<int>(rng() % 1024);
+            }
+            l.Append(std::span<const int>{values, count});
+            report(l.IsEmpty());
+            if (!l.IsEmpty()) {
+                report(l.Back());
+            }
+            break;
+        }
+        case 10: {
+            if (rng() % 8 != 0) {
+                continue;
+            }
+            auto& l = lists[pick_one()];
+            report(CollectToVec(l));
+            l.Clear();
+            report(l.IsEmpty());
+            break;
+        }
         }
     }
 }
 
-template <class F>
+template <class L = List, class F>
 void CheckBehaveTheSame(F&& fun) {
     using Record = std::variant<int, std::vector<int>>;
     std::vector<std::pair<Record, std::source_location>> history;
@@ -326,7 +364,7 @@ void CheckBehaveTheSame(F&& fun) {
     };
 
     size_t current = 0;
-    fun.template operator()<List>([&history, &current, format_record]<class T>(
+    fun.template operator()<L>([&history, &current, format_record]<class T>(
                                       T value,
                                       std::source_location loc =
                                           std::source_location::current()) {
@@ -344,3 +382,125 @@ TEST_CASE("StressTestBehavioral") {
     CheckBehaveTheSame(
         []<class T>(auto report) { Operate<T>(std::move(report)); });
 }
+
+TEST_CASE("StressTestAppendClear") {
+    auto operate = []<class T>(auto report) {
+        Operate<T, 11>(std::move(report));
+    };
+    CheckBehaveTheSame<List>(operate);
+    CheckBehaveTheSame<SlabList>(operate);
+    CheckBehaveTheSame<UnrolledList>(operate);
+}
+
+template <class T>
+void CheckAppend() {
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+
+    T l;
+    l.Append({});
+    REQUIRE(l.IsEmpty());
+
+    l.PushBack(-1);
+    l.Append(values);
+    l.PushFront(-2);
+    l.Append(std::span<const int>{values}.first(10));
+
+    std::vector<int> expected = {-2, -1};
+    expected.insert(expected.end(), values.begin(), values.end());
+    expected.insert(expected.end(), values.begin(), values.begin() + 10);
+    REQUIRE(CollectToVec(l) == expected);
+
+    l.Clear();
+    REQUIRE(l.IsEmpty());
+    REQUIRE(CollectToVec(l) == std::vector<int>{});
+
+    // The list is usable after Clear.
+    l.Append(values);
+    l.PopFront();
+    l.PopBack();
+    REQUIRE(l.Front() == 1);
+    REQUIRE(l.Back() == 998);
+}
+
+TEST_CASE("Append") {
+    CheckAppend<List>();
+    CheckAppend<SlabList>();
+    CheckAppend<UnrolledList>();
+}
+
+struct LargeTimes {
+    CPUTimer::Times fill;
+    CPUTimer::Times iterate;
+    CPUTimer::Times clear;
+};
+
+// Appends, sums up and clears kLargeSize elements.
+template <class T>
+LargeTimes RunLarge() {
+    constexpr int kLargeSize = 10'000'000;
+    std::vector<int> values(kLargeSize);
+    std::iota(values.begin(), values.end(), 0);
+    auto expected = std::accumulate(values.begin(), values.end(), int64_t{0});
+
+    T l;
+    LargeTimes times;
+    times.fill = Run([&] { l.Append(values); });
+    int64_t sum = 0;
+    times.iterate =
+        Run([&] { l.ForEachElement([&](int v) { sum += v; }); });
+    REQUIRE(sum == expected);
+    times.clear = Run([&] { l.Clear(); });
+    REQUIRE(l.IsEmpty());
+    return times;
+}
+
+// std::vector with the interface RunLarge needs.
+class VectorList {
+  public:
+    void Append(std::span<const int> values) {
+        inner_.insert(inner_.end(), values.begin(), values.end());
+    }
+
+    template <class F>
+    void ForEachElement(F&& f) const {
+        for (auto x : inner_) {
+            f(x);
+        }
+    }
+
+    void Clear() {
+        inner_.clear();
+        inner_.shrink_to_fit();
+    }
+
+    bool IsEmpty() const {
+        return inner_.empty();
+    }
+
+  private:
+    std::vector<int> inner_;
+};
+
+// Compared with a vector of the same size: up to `slowdown` times slower,
+// with some slack for the noise of short runs. Timings only mean something
+// in release builds.
+template <class T>
+void CheckLarge(int slowdown) {
+    using namespace std::chrono_literals;
+    auto vector = RunLarge<VectorList>();
+    auto list = RunLarge<T>();
+    if constexpr (kBuildType == BuildType::Release) {
+        auto bound = [slowdown](CPUTimer::Times times) {
+            return times.cpu_time * slowdown + 20ms;
+        };
+        CHECK(list.fill.cpu_time < bound(vector.fill));
+        CHECK(list.iterate.cpu_time < bound(vector.iterate));
+        CHECK(list.clear.cpu_time < bound(vector.clear));
+    }
+}
+
+TEST_CASE("Large") {
+    CheckLarge<SlabList>(8);
+    CheckLarge<UnrolledList>(4);
+}
@@ -0,0 +1,123 @@
+#include "reverse-list.hpp"
+
+#include <benchmark/compiler.hpp>
+#include <benchmark/timer.hpp>
+#include <pcg-random.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+#include <sys/mman.h>
+
+// Defined in reverse-list.cpp.
+ListNode* ReverseParallel(ListNode* node, size_t threads);
+
+// Reverses lists of N nodes (argv[1], 10^7 by default) laid out in three
+// ways and prints wall time per node:
+//   contiguous - nodes follow each other in memory;
+//   shuffled   - nodes are linked in random order, every step is a miss;
+//   hugepage   - shuffled, but in memory backed by huge pages, so the misses
+//                do not also miss the TLB.
+
+namespace {
+
+class Nodes {
+  public:
+    Nodes(size_t count, bool huge) : size_{count * sizeof(ListNode)} {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        void* memory = MAP_FAILED;
+        if (huge) {
+            memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                          flags | MAP_HUGETLB, -1, 0);
+        }
+        if (memory == MAP_FAILED) {
+            memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (memory == MAP_FAILED) {
+                std::perror("mmap");
+                std::exit(1);
+            }
+            // No reserved huge pages, ask for transparent ones.
+            if (huge && madvise(memory, size_, MADV_HUGEPAGE) != 0) {
+                std::perror("madvise");
+            }
+        }
+        nodes_ = static_cast<ListNode*>(memory);
+    }
+
+    Nodes(const Nodes&) = delete;
+    Nodes& operator=(const Nodes&) = delete;
+
+    ~Nodes() {
+        munmap(nodes_, size_);
+    }
+
+    ListNode* Link(const std::vector<size_t>& order) {
+        for (size_t i = 0; i < order.size(); ++i) {
+            auto& node = nodes_[order[i]];
+            node.value = static_cast<int>(i);
+            node.next = i + 1 < order.size() ? &nodes_[order[i + 1]] : nullptr;
+        }
+        return &nodes_[order[0]];
+    }
+
+  private:
+    size_t size_;
+    ListNode* nodes_;
+};
+
+template <class F>
+double NanosPerNode(Nodes& nodes, const std::vector<size_t>& order, F&& f) {
+    constexpr int kRuns = 3;
+    auto best = CPUTimer::WallClock::duration::max();
+    for (int i = 0; i < kRuns; ++i) {
+        auto head = nodes.Link(order);
+        CPUTimer timer;
+        DoNotOptimize(f(head));
+        best = std::min(best, timer.GetTimes().wall_time);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(best).count();
+    return ns / static_cast<double>(order.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    if (count == 0) {
+        std::fprintf(stderr, "Usage: %s [NODES]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<size_t> shuffled = order;
+    PCGRandom rng{4243};
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    struct Layout {
+        const char* name;
+        bool huge;
+        const std::vector<size_t>* order;
+    };
+    Layout layouts[] = {
+        {"contiguous", false, &order},
+        {"shuffled", false, &shuffled},
+        {"hugepage", true, &shuffled},
+    };
+
+    std::printf("%zu nodes, ns per node\n", count);
+    std::printf("%-12s %10s %10s\n", "layout", "serial", "parallel");
+    for (const auto& layout : layouts) {
+        Nodes nodes{count, layout.huge};
+        double serial = NanosPerNode(nodes, *layout.order, Reverse);
+        double parallel = NanosPerNode(nodes, *layout.order, [](ListNode* n) {
+            return ReverseParallel(n, 0);
+        });
+        std::printf("%-12s %10.2f %10.2f\n", layout.name, serial, parallel);
+    }
+    return 0;
+}
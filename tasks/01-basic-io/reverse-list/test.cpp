@@ -2,9 +2,17 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <pcg-random.hpp>
+
+#include <algorithm>
 #include <array>
+#include <numeric>
 #include <span>
 #include <utility>
+#include <vector>
+
+// Defined in reverse-list.cpp.
+ListNode* ReverseParallel(ListNode* node, size_t threads);
 
 inline void FreeList(ListNode* node) {
     while (node != nullptr) {
@@ -86,3 +94,51 @@ TEST_CASE("BigList") {
     std::vector<ListNode> nodes(15'000);
     CheckReverseOn(nodes);
 }
+
+// Links `nodes` in the order given by `order` and reverses it in parallel.
+void CheckParallelOn(std::span<ListNode> nodes, std::span<const size_t> order,
+                     size_t threads) {
+    for (size_t i = 0; i < order.size(); ++i) {
+        auto& node = nodes[order[i]];
+        node.value = static_cast<int>(i);
+        node.next = i + 1 < order.size() ? &nodes[order[i + 1]] : nullptr;
+    }
+
+    ListNode* head = order.empty() ? nullptr : &nodes[order[0]];
+    auto reversed = ReverseParallel(head, threads);
+    if (order.empty()) {
+        CHECK(reversed == nullptr);
+        return;
+    }
+    REQUIRE(reversed == &nodes[order.back()]);
+
+    size_t count = 0;
+    for (auto node = reversed; node != nullptr; node = node->next) {
+        REQUIRE(count < order.size());
+        REQUIRE(node == &nodes[order[order.size() - 1 - count]]);
+        ++count;
+    }
+    REQUIRE(count == order.size());
+}
+
+TEST_CASE("Parallel") {
+    PCGRandom rng{424243};
+    std::vector<ListNode> nodes(1'000'003);
+    std::vector<size_t> order(nodes.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    auto check = [&](size_t size, size_t threads) {
+        INFO("size = " << size << ", threads = " << threads);
+        CheckParallelOn(nodes, std::span{order}.first(size), threads);
+    };
+
+    for (size_t size : {0, 1, 2, 4096, 65535, 65536, 65537, 300'007}) {
+        check(size, 0);
+        check(size, 3);
+    }
+
+    std::shuffle(order.begin(), order.end(), rng);
+    for (size_t threads : {0, 1, 2, 5, 64}) {
+        check(order.size(), threads);
+    }
+}
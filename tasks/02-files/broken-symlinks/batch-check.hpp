@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class PathStatus : uint8_t {
+    Ok,
+    BrokenSymlink,
+    Missing,
+    Error,
+};
+
+struct PathInfo {
+    PathStatus status;
+    int error = 0;  // Errno for PathStatus::Error.
+};
+
+namespace check_detail {
+
+inline constexpr size_t kOutputChunk = 1 << 16;
+
+// Only the type and the existence of a path matter here: automounts are not
+// triggered and remote attributes are not refreshed.
+inline constexpr int kStatxFlags = AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC;
+
+// Same decision as stat() followed by lstat(), but the common case (not a
+// symlink) costs one call, and the target is only resolved for symlinks.
+inline PathInfo Classify(int dirfd, const char* path) {
+    struct statx stx;
+    if (statx(dirfd, path, kStatxFlags | AT_SYMLINK_NOFOLLOW, STATX_TYPE,
+              &stx) != 0) {
+        if (errno == ENOENT) {
+            return {PathStatus::Missing};
+        }
+        return {PathStatus::Error, errno};
+    }
+    if ((stx.stx_mask & STATX_TYPE) != 0 && !S_ISLNK(stx.stx_mode)) {
+        return {PathStatus::Ok};
+    }
+    // No fields at all are needed to see whether the target exists.
+    if (statx(dirfd, path, kStatxFlags, 0, &stx) != 0) {
+        return {PathStatus::BrokenSymlink};
+    }
+    return {PathStatus::Ok};
+}
+
+// Splits a path into the directory to open and the name inside it. Paths
+// with a trailing slash have no name and are checked as a whole.
+inline std::string_view ParentOf(std::string_view path) {
+    auto pos = path.rfind('/');
+    if (pos == std::string_view::npos) {
+        return ".";
+    }
+    return pos == 0 ? path.substr(0, 1) : path.substr(0, pos);
+}
+
+inline std::string_view NameOf(std::string_view path) {
+    auto pos = path.rfind('/');
+    return pos == std::string_view::npos ? path : path.substr(pos + 1);
+}
+
+}  // namespace check_detail
+
+// Classifies every path like `stat` + `lstat` would. The result is in the
+// order of `paths`.
+//
+// Paths are grouped by their parent directory. Each parent with more than
+// one path is opened once with O_PATH, and its children are checked with
+// statx relative to it, so the kernel walks the common prefix once per
+// directory instead of once per path. Paths that are alone in their
+// directory, or whose parent can not be opened, are checked as given.
+inline std::vector<PathInfo> ClassifyPaths(
+    std::span<const std::string_view> paths) {
+    using check_detail::Classify;
+    using check_detail::ParentOf;
+
+    std::vector<PathInfo> result(paths.size());
+    std::vector<size_t> order(paths.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return ParentOf(paths[a]) < ParentOf(paths[b]);
+    });
+
+    std::string buf;
+    auto c_str = [&buf](std::string_view s) {
+        buf.assign(s);
+        return buf.c_str();
+    };
+
+    for (size_t begin = 0; begin < order.size();) {
+        auto parent = ParentOf(paths[order[begin]]);
+        size_t end = begin + 1;
+        while (end < order.size() && ParentOf(paths[order[end]]) == parent) {
+            ++end;
+        }
+
+        int dirfd = -1;
+        if (end - begin > 1) {
+            dirfd = open(c_str(parent), O_PATH | O_DIRECTORY | O_CLOEXEC);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            auto path = paths[order[i]];
+            auto name = check_detail::NameOf(path);
+            if (dirfd != -1 && !name.empty()) {
+                result[order[i]] = Classify(dirfd, c_str(name));
+            } else {
+                result[order[i]] = Classify(AT_FDCWD, c_str(path));
+            }
+        }
+        if (dirfd != -1) {
+            close(dirfd);
+        }
+        begin = end;
+    }
+    return result;
+}
+
+// Prints the report for `paths` to `fd`, one line per path, in large
+// chunks. Returns 0 or -errno if writing failed.
+inline int PrintFileInfos(std::span<const std::string_view> paths, int fd) {
+    auto infos = ClassifyPaths(paths);
+
+    std::string out;
+    auto flush = [&out, fd] {
+        std::string_view rest = out;
+        while (!rest.empty()) {
+            ssize_t res = write(fd, rest.data(), rest.size());
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -errno;
+            }
+            rest.remove_prefix(static_cast<size_t>(res));
+        }
+        out.clear();
+        return 0;
+    };
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        switch (infos[i].status) {
+            case PathStatus::Ok:
+                out.append(paths[i]);
+                break;
+            case PathStatus::BrokenSymlink:
+                out.append(paths[i]).append(" (broken symlink)");
+                break;
+            case PathStatus::Missing:
+                out.append(paths[i]).append(" (missing)");
+                break;
+            case PathStatus::Error:
+                out.append(std::strerror(infos[i].error)).append(" WTF!");
+                break;
+        }
+        out.push_back('\n');
+        if (out.size() >= check_detail::kOutputChunk) {
+            if (int err = flush(); err != 0) {
+                return err;
+            }
+        }
+    }
+    return flush();
+}
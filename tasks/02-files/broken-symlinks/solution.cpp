@@ -1,31 +1,64 @@
+#include "batch-check.hpp"
+
 #include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
 
-#include <cstring>
-#include <sys/stat.h>
-#include <sys/types.h>
+#include <fcntl.h>
 #include <unistd.h>
 
-void PrintFileInfo(const char* filename) {
-    struct stat sb;
-    if (stat(filename, &sb) != 0) {
-        if (lstat(filename, &sb) == 0) {
-            std::cout << filename << " (broken symlink)" << std::endl;
-            return;
+// Reads the whole manifest: one path per line.
+int ReadManifest(const char* path, std::string* data) {
+    int fd = std::strcmp(path, "-") == 0 ? dup(STDIN_FILENO)
+                                        : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -errno;
+    }
+    char buf[1 << 16];
+    while (true) {
+        ssize_t res = read(fd, buf, sizeof(buf));
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            close(fd);
+            return -err;
         }
-        if (errno == ENOENT) {
-            std::cout << filename << " (missing)" << std::endl;
-        } else {
-            std::cout << std::strerror(errno) << " WTF!\n";
+        if (res == 0) {
+            break;
         }
-
-    } else {
-        std::cout << filename << '\n';
+        data->append(buf, res);
     }
+    close(fd);
+    return 0;
 }
 
 int main(int argc, const char* argv[]) {
-    for (int i = 1; i < argc; ++i) {
-        PrintFileInfo(argv[i]);
+    std::string manifest;
+    std::vector<std::string_view> paths;
+
+    if (argc == 3 && std::strcmp(argv[1], "--manifest") == 0) {
+        if (int err = ReadManifest(argv[2], &manifest); err != 0) {
+            std::cerr << "Failed to read " << argv[2] << ": "
+                      << std::strerror(-err) << '\n';
+            return 1;
+        }
+        std::string_view rest = manifest;
+        while (!rest.empty()) {
+            auto pos = std::min(rest.find('\n'), rest.size());
+            paths.push_back(rest.substr(0, pos));
+            rest.remove_prefix(std::min(pos + 1, rest.size()));
+        }
+    } else {
+        paths.assign(argv + 1, argv + argc);
+    }
+
+    if (int err = PrintFileInfos(paths, STDOUT_FILENO); err != 0) {
+        std::cerr << "Failed to write: " << std::strerror(-err) << '\n';
+        return 1;
     }
 }
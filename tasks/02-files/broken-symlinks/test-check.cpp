@@ -0,0 +1,204 @@
+#include "batch-check.hpp"
+
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr const char* kRoot = "/tmp/deleteme-broken-symlinks";
+
+void RemoveTree(const char* path) {
+    nftw(
+        path,
+        [](const char* p, const struct stat*, int, FTW*) { return remove(p); },
+        64, FTW_DEPTH | FTW_PHYS);
+}
+
+struct TempTree {
+    TempTree() {
+        RemoveTree(kRoot);
+        INTERNAL_ASSERT(mkdir(kRoot, 0755) == 0);
+    }
+
+    ~TempTree() {
+        RemoveTree(kRoot);
+    }
+
+    void Dir(const std::string& path) const {
+        INTERNAL_ASSERT(mkdir(Full(path).c_str(), 0755) == 0);
+    }
+
+    void File(const std::string& path) const {
+        int fd = open(Full(path).c_str(), O_WRONLY | O_CREAT, 0644);
+        INTERNAL_ASSERT(fd != -1);
+        close(fd);
+    }
+
+    void Link(const std::string& path, const std::string& target) const {
+        INTERNAL_ASSERT(symlink(target.c_str(), Full(path).c_str()) == 0);
+    }
+
+    static std::string Full(const std::string& path) {
+        return std::string{kRoot} + "/" + path;
+    }
+};
+
+// The straightforward per-path check: stat, then lstat.
+PathInfo Reference(const std::string& path) {
+    struct stat sb;
+    if (stat(path.c_str(), &sb) == 0) {
+        return {PathStatus::Ok};
+    }
+    if (lstat(path.c_str(), &sb) == 0) {
+        return {PathStatus::BrokenSymlink};
+    }
+    if (errno == ENOENT) {
+        return {PathStatus::Missing};
+    }
+    return {PathStatus::Error, errno};
+}
+
+std::string Print(const std::vector<std::string_view>& paths) {
+    int fd = memfd_create("check", MFD_CLOEXEC);
+    INTERNAL_ASSERT(fd != -1);
+    INTERNAL_ASSERT(PrintFileInfos(paths, fd) == 0);
+
+    std::string out;
+    char buf[4096];
+    ssize_t r;
+    while ((r = pread(fd, buf, sizeof(buf), out.size())) > 0) {
+        out.append(buf, r);
+    }
+    INTERNAL_ASSERT(r == 0);
+    close(fd);
+    return out;
+}
+
+TEST_CASE("Example") {
+    TempTree tree;
+    tree.File("regular");
+    tree.Link("symlink_good", "regular");
+    tree.Link("symlink_bad", "/non/existent");
+
+    auto regular = TempTree::Full("regular");
+    auto good = TempTree::Full("symlink_good");
+    auto bad = TempTree::Full("symlink_bad");
+    std::vector<std::string_view> paths = {regular, good, bad,
+                                           "/non/existent", good};
+    CHECK(Print(paths) == regular + "\n" + good + "\n" + bad +
+                              " (broken symlink)\n/non/existent (missing)\n" +
+                              good + "\n");
+}
+
+TEST_CASE("Errors") {
+    TempTree tree;
+    tree.File("file");
+    tree.Link("loop", "loop");
+
+    std::vector<std::string> paths = {
+        TempTree::Full("file/x"), TempTree::Full("file/"),
+        TempTree::Full("loop"),   TempTree::Full("loop/x"),
+        "",
+    };
+    std::vector<std::string_view> views(paths.begin(), paths.end());
+    auto infos = ClassifyPaths(views);
+    REQUIRE(infos.size() == paths.size());
+
+    CHECK(infos[0].status == PathStatus::Error);
+    CHECK(infos[0].error == ENOTDIR);
+    CHECK(infos[1].status == PathStatus::Error);
+    CHECK(infos[1].error == ENOTDIR);
+    CHECK(infos[2].status == PathStatus::BrokenSymlink);
+    CHECK(infos[3].status == PathStatus::Error);
+    CHECK(infos[3].error == ELOOP);
+    CHECK(infos[4].status == PathStatus::Missing);
+
+    CHECK(Print({views[0]}) == std::string{std::strerror(ENOTDIR)} + " WTF!\n");
+}
+
+TEST_CASE("Random") {
+    PCGRandom rng{4243};
+    TempTree tree;
+
+    std::vector<std::string> dirs = {""};
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 600; ++i) {
+        const auto& parent = dirs[rng() % dirs.size()];
+        std::string name = parent + "e" + std::to_string(i);
+        names.push_back(name);
+        switch (rng() % 5) {
+            case 0:
+                tree.Dir(name);
+                dirs.push_back(name + "/");
+                break;
+            case 1:
+                tree.File(name);
+                break;
+            case 2:
+                // Relative to the link's own directory, may dangle.
+                tree.Link(name, "e" + std::to_string(rng() % 600));
+                break;
+            case 3:
+                tree.Link(name, TempTree::Full(names[rng() % names.size()]));
+                break;
+            default:
+                break;  // Missing.
+        }
+    }
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < 3000; ++i) {
+        auto path = TempTree::Full(names[rng() % names.size()]);
+        switch (rng() % 8) {
+            case 0:
+                path += "/";
+                break;
+            case 1:
+                path += "/e" + std::to_string(rng() % 600);
+                break;
+            default:
+                break;
+        }
+        paths.push_back(std::move(path));
+    }
+
+    std::vector<std::string_view> views(paths.begin(), paths.end());
+    auto infos = ClassifyPaths(views);
+    REQUIRE(infos.size() == paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        INFO(paths[i]);
+        auto expected = Reference(paths[i]);
+        REQUIRE(infos[i].status == expected.status);
+        REQUIRE(infos[i].error == expected.error);
+    }
+}
+
+TEST_CASE("RelativePaths") {
+    TempTree tree;
+    tree.Dir("d");
+    tree.File("d/f");
+    tree.Link("d/good", "f");
+    tree.Link("d/bad", "nope");
+
+    char cwd[4096];
+    REQUIRE(getcwd(cwd, sizeof(cwd)) != nullptr);
+    REQUIRE(chdir(kRoot) == 0);
+    std::vector<std::string_view> paths = {"d", "d/f", "d/good", "d/bad",
+                                           "d/nope", "d/f"};
+    auto out = Print(paths);
+    REQUIRE(chdir(cwd) == 0);
+    CHECK(out == "d\nd/f\nd/good\nd/bad (broken symlink)\n"
+                 "d/nope (missing)\nd/f\n");
+}
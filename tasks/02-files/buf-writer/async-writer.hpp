@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// What Write does when every buffer is waiting for the flusher.
+enum class Backpressure {
+    Block,   // Wait until the flusher frees a buffer.
+    Reject,  // Fail with -EAGAIN without consuming any of the data.
+};
+
+// Buffered writer that hands full buffers to a background flusher thread,
+// so Write only copies data and never waits for write(2) unless all
+// `buf_count` buffers are in flight.
+//
+// Buffers are filled and flushed strictly round-robin, which keeps the
+// output ordered without any queue: buffer `submitted_ % count` is the next
+// one to fill and buffer `completed_ % count` is the next one to write.
+//
+// Write errors happen in the background, so they are sticky: the first
+// failure is returned from every following call and the rest of the data is
+// dropped. Like BufWriter, the writer does not own the descriptor and must
+// be used from a single producer thread.
+class AsyncBufWriter {
+  public:
+    AsyncBufWriter(int fd, size_t buf_capacity, size_t buf_count = 2,
+                   Backpressure policy = Backpressure::Block)
+        : fd_{fd},
+          capacity_{buf_capacity},
+          count_{std::max<size_t>(buf_count, 2)},
+          policy_{policy},
+          storage_{new char[capacity_ * count_]},
+          sizes_(count_) {
+        flusher_ = std::thread([this] { FlusherLoop(); });
+    }
+
+    // Non-copyable
+    AsyncBufWriter(const AsyncBufWriter&) = delete;
+    AsyncBufWriter& operator=(const AsyncBufWriter&) = delete;
+
+    // Non-movable
+    AsyncBufWriter(AsyncBufWriter&&) = delete;
+    AsyncBufWriter& operator=(AsyncBufWriter&&) = delete;
+
+    int Write(std::string_view data) {
+        if (int err = error_.load(std::memory_order_relaxed)) {
+            return err;
+        }
+        if (policy_ == Backpressure::Reject && !HasSpaceFor(data.size())) {
+            return -EAGAIN;
+        }
+
+        while (!data.empty()) {
+            if (!has_current_) {
+                if (int err = AcquireBuffer()) {
+                    return err;
+                }
+            }
+            size_t chunk = std::min(capacity_ - size_, data.size());
+            std::memcpy(Current() + size_, data.data(), chunk);
+            size_ += chunk;
+            data.remove_prefix(chunk);
+            if (size_ == capacity_) {
+                Submit();
+            }
+        }
+        return 0;
+    }
+
+    // Hands the current buffer to the flusher. Does not wait for the data to
+    // reach the descriptor, use Sync for that.
+    int Flush() {
+        if (has_current_ && size_ != 0) {
+            Submit();
+        }
+        return error_.load(std::memory_order_relaxed);
+    }
+
+    // Waits until everything written so far reaches the descriptor and then
+    // asks the kernel to make it durable. Descriptors that cannot be synced
+    // (pipes, sockets, ttys) are only drained.
+    int Sync() {
+        Flush();
+        {
+            std::unique_lock lock{mutex_};
+            done_.wait(lock, [this] { return completed_ == submitted_; });
+        }
+        if (int err = error_.load()) {
+            return err;
+        }
+        if (fdatasync(fd_) == -1 && errno != EINVAL && errno != EROFS) {
+            return -errno;
+        }
+        return 0;
+    }
+
+    ~AsyncBufWriter() {
+        Flush();
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+        work_.notify_one();
+        flusher_.join();
+        delete[] storage_;
+    }
+
+  private:
+    char* Buffer(uint64_t seq) {
+        return storage_ + (seq % count_) * capacity_;
+    }
+
+    char* Current() {
+        return Buffer(submitted_);
+    }
+
+    bool HasSpaceFor(size_t bytes) {
+        std::lock_guard lock{mutex_};
+        size_t busy = submitted_ - completed_ + (has_current_ ? 1 : 0);
+        size_t space = (count_ - busy) * capacity_;
+        if (has_current_) {
+            space += capacity_ - size_;
+        }
+        return bytes <= space;
+    }
+
+    int AcquireBuffer() {
+        std::unique_lock lock{mutex_};
+        done_.wait(lock, [this] { return submitted_ - completed_ < count_; });
+        has_current_ = true;
+        size_ = 0;
+        return error_.load(std::memory_order_relaxed);
+    }
+
+    void Submit() {
+        sizes_[submitted_ % count_] = size_;
+        {
+            std::lock_guard lock{mutex_};
+            ++submitted_;
+        }
+        has_current_ = false;
+        size_ = 0;
+        work_.notify_one();
+    }
+
+    void FlusherLoop() {
+        std::unique_lock lock{mutex_};
+        while (true) {
+            work_.wait(lock,
+                       [this] { return stop_ || completed_ < submitted_; });
+            if (completed_ == submitted_) {
+                return;
+            }
+
+            uint64_t seq = completed_;
+            lock.unlock();
+            if (error_.load(std::memory_order_relaxed) == 0) {
+                if (int res = FlushArray(Buffer(seq), sizes_[seq % count_])) {
+                    error_.store(res);
+                }
+            }
+            lock.lock();
+
+            ++completed_;
+            done_.notify_all();
+        }
+    }
+
+    int FlushArray(const char* buf, size_t count) {
+        size_t written = 0;
+        while (written < count) {
+            ssize_t res = ::write(fd_, buf + written, count - written);
+            if (res == -1) {
+                return -errno;
+            }
+            written += static_cast<size_t>(res);
+        }
+        return 0;
+    }
+
+    const int fd_;
+    const size_t capacity_;
+    const size_t count_;
+    const Backpressure policy_;
+    char* const storage_;
+    std::vector<size_t> sizes_;
+
+    // Owned by the producer.
+    bool has_current_ = false;
+    size_t size_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    uint64_t submitted_ = 0;
+    uint64_t completed_ = 0;
+    bool stop_ = false;
+    std::atomic<int> error_{0};
+
+    std::thread flusher_;
+};
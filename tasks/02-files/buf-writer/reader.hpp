@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+// Read-side counterpart of BufWriter. Views returned by Peek and ReadLine
+// point into the reader's own storage and stay valid until the next call
+// to any reader method.
+//
+// Regular files are mapped as a whole (from the current offset) unless
+// Backend::Read is requested. Mapped input is never copied and needs no
+// syscalls after construction. The mmap backend leaves the descriptor's
+// offset untouched, the read backend moves it past whatever is buffered.
+//
+// Methods return 0 on success and -errno if reading failed. Like BufWriter,
+// the reader does not own the descriptor.
+class BufReader {
+  public:
+    enum class Backend {
+        Auto,
+        Read,
+    };
+
+    BufReader(int fd, size_t buf_capacity, Backend backend = Backend::Auto)
+        : fd_{fd}, capacity_{std::max<size_t>(buf_capacity, 1)} {
+        if (backend == Backend::Auto && TryMap()) {
+            return;
+        }
+        buffer_ = new char[capacity_];
+        data_ = buffer_;
+    }
+
+    // Non-copyable
+    BufReader(const BufReader&) = delete;
+    BufReader& operator=(const BufReader&) = delete;
+
+    // Non-movable
+    BufReader(BufReader&&) = delete;
+    BufReader& operator=(BufReader&&) = delete;
+
+    ~BufReader() {
+        if (mapping_ != nullptr) {
+            munmap(mapping_, mapping_size_);
+        } else {
+            delete[] buffer_;
+        }
+    }
+
+    bool IsMapped() const {
+        return mapping_ != nullptr;
+    }
+
+    // Makes at least `n` bytes available (fewer only at end of input) and
+    // returns everything buffered. Grows the buffer if `n` exceeds it.
+    int Peek(size_t n, std::string_view* data) {
+        int res = Fill(n);
+        *data = Buffered();
+        return res;
+    }
+
+    // Drops `n` bytes (at most what the last Peek returned).
+    void Consume(size_t n) {
+        begin_ += std::min(n, end_ - begin_);
+        scanned_ = std::max(scanned_, begin_);
+    }
+
+    // Returns 1 and the next line without its '\n', 0 at end of input. The
+    // last line does not need to be terminated.
+    int ReadLine(std::string_view* line) {
+        while (true) {
+            // glibc's memchr is vectorized, and every byte is scanned once:
+            // `scanned_` remembers where the previous refill stopped.
+            auto* found = static_cast<const char*>(
+                std::memchr(data_ + scanned_, '\n', end_ - scanned_));
+            if (found != nullptr) {
+                size_t len = found - (data_ + begin_);
+                *line = {data_ + begin_, len};
+                begin_ = scanned_ = begin_ + len + 1;
+                return 1;
+            }
+            scanned_ = end_;
+
+            if (eof_) {
+                if (begin_ == end_) {
+                    return 0;
+                }
+                *line = Buffered();
+                begin_ = end_;
+                return 1;
+            }
+            if (int res = Fill(end_ - begin_ + 1); res != 0) {
+                return res;
+            }
+        }
+    }
+
+    // Reads one fixed-size record. Returns 1 on success, 0 at end of input
+    // and -ENODATA if the input ends in the middle of a record.
+    template <class T>
+    int ReadRecord(T* record) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (int res = Fill(sizeof(T)); res != 0) {
+            return res;
+        }
+        size_t available = end_ - begin_;
+        if (available < sizeof(T)) {
+            return available == 0 ? 0 : -ENODATA;
+        }
+        std::memcpy(record, data_ + begin_, sizeof(T));
+        Consume(sizeof(T));
+        return 1;
+    }
+
+  private:
+    std::string_view Buffered() const {
+        return {data_ + begin_, end_ - begin_};
+    }
+
+    bool TryMap() {
+        struct stat st;
+        if (fstat(fd_, &st) == -1 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+        off_t offset = lseek(fd_, 0, SEEK_CUR);
+        // Files like the ones in /proc report zero size but are not empty.
+        if (offset == -1 || offset >= st.st_size) {
+            return false;
+        }
+
+        auto page = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+        off_t aligned = offset - offset % page;
+        mapping_size_ = static_cast<size_t>(st.st_size - aligned);
+        void* mapped =
+            mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd_, aligned);
+        if (mapped == MAP_FAILED) {
+            mapping_size_ = 0;
+            return false;
+        }
+        madvise(mapped, mapping_size_, MADV_SEQUENTIAL);
+
+        mapping_ = mapped;
+        data_ = static_cast<const char*>(mapped) + (offset - aligned);
+        end_ = static_cast<size_t>(st.st_size - offset);
+        eof_ = true;
+        return true;
+    }
+
+    int Fill(size_t n) {
+        if (end_ - begin_ >= n || eof_) {
+            return 0;
+        }
+
+        if (begin_ + n > capacity_) {
+            size_t size = end_ - begin_;
+            if (n > capacity_) {
+                char* grown = new char[std::max(n, 2 * capacity_)];
+                std::memcpy(grown, buffer_ + begin_, size);
+                delete[] buffer_;
+                buffer_ = grown;
+                capacity_ = std::max(n, 2 * capacity_);
+            } else {
+                std::memmove(buffer_, buffer_ + begin_, size);
+            }
+            scanned_ -= begin_;
+            begin_ = 0;
+            end_ = size;
+            data_ = buffer_;
+        }
+
+        while (end_ - begin_ < n) {
+            ssize_t res = ::read(fd_, buffer_ + end_, capacity_ - end_);
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -errno;
+            }
+            if (res == 0) {
+                eof_ = true;
+                break;
+            }
+            end_ += static_cast<size_t>(res);
+        }
+        return 0;
+    }
+
+    int fd_;
+    size_t capacity_;
+    char* buffer_ = nullptr;
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+
+    const char* data_ = nullptr;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    size_t scanned_ = 0;
+    bool eof_ = false;
+};
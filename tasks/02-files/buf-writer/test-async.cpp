@@ -0,0 +1,165 @@
+#include "async-writer.hpp"
+
+#include <glitch.hpp>
+
+#include <distributions.hpp>
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+
+constexpr const char* kFileName = "/tmp/deleteme-async-writer";
+
+struct SlowWriteGlitch final : WriteGuard {
+    explicit SlowWriteGlitch(int fd) : target_fd(fd) {
+    }
+
+    ssize_t Write(int fd, const void* buf, size_t count) override {
+        if (fd == target_fd) {
+            writes_count.fetch_add(1);
+            while (paused.load()) {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(delay);
+            if (auto next = next_error.exchange(0)) {
+                errno = next;
+                return -1;
+            }
+            if (trim && count > 0) {
+                count = rng() % count + 1;
+            }
+        }
+        return RealWrite(fd, buf, count);
+    }
+
+    int target_fd;
+    std::chrono::milliseconds delay{0};
+    std::atomic<bool> paused = false;
+    std::atomic<int> next_error = 0;
+    std::atomic<size_t> writes_count = 0;
+    bool trim = false;
+    PCGRandom rng{424243};
+};
+
+int OpenTarget() {
+    int fd = open(kFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    INTERNAL_ASSERT(fd != -1);
+    return fd;
+}
+
+std::string ReadTarget(int fd) {
+    std::string data;
+    char buf[4096];
+    ssize_t r;
+    while ((r = pread(fd, buf, sizeof(buf), data.size())) > 0) {
+        data.append(buf, r);
+    }
+    INTERNAL_ASSERT(r == 0);
+    close(fd);
+    unlink(kFileName);
+    return data;
+}
+
+TEST_CASE("JustWorks") {
+    int fd = OpenTarget();
+    {
+        AsyncBufWriter w(fd, 100);
+        w.Write("aba");
+        w.Write("caba");
+        w.Write("daba");
+    }
+    CHECK(ReadTarget(fd) == "abacabadaba");
+}
+
+TEST_CASE("KeepsOrder") {
+    PCGRandom rng{43};
+    int fd = OpenTarget();
+    SlowWriteGlitch g{fd};
+    g.trim = true;
+
+    std::string data;
+    {
+        UniformCharDistribution distr('a', 'z');
+        AsyncBufWriter w(fd, 7, 3);
+        for (size_t i = 0; i < 2000; ++i) {
+            std::string s(rng() % 20, ' ');
+            std::generate(s.begin(), s.end(), [&] { return distr(rng); });
+            REQUIRE(w.Write(s) == 0);
+            data += s;
+            if (i % 100 == 0) {
+                REQUIRE(w.Sync() == 0);
+            }
+        }
+    }
+    CHECK(ReadTarget(fd) == data);
+}
+
+TEST_CASE("WriteDoesNotWait") {
+    int fd = OpenTarget();
+    SlowWriteGlitch g{fd};
+    g.delay = std::chrono::milliseconds{200};
+
+    std::string line(100, 'x');
+    {
+        AsyncBufWriter w(fd, 1000, 4);
+
+        // Three buffers get full, the fourth one is the current one.
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < 35; ++i) {
+            REQUIRE(w.Write(line) == 0);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        CHECK(elapsed < g.delay / 2);
+
+        REQUIRE(w.Sync() == 0);
+        CHECK(g.writes_count.load() == 4);
+    }
+    CHECK(ReadTarget(fd).size() == 3500);
+}
+
+TEST_CASE("RejectPolicy") {
+    int fd = OpenTarget();
+    SlowWriteGlitch g{fd};
+    g.paused = true;
+
+    {
+        AsyncBufWriter w(fd, 4, 2, Backpressure::Reject);
+        REQUIRE(w.Write("abcd") == 0);
+        REQUIRE(w.Write("efg") == 0);
+        CHECK(w.Write("hi") == -EAGAIN);
+        REQUIRE(w.Write("h") == 0);
+        CHECK(w.Write("i") == -EAGAIN);
+
+        g.paused = false;
+        REQUIRE(w.Sync() == 0);
+
+        g.paused = true;
+        REQUIRE(w.Write("ijklmnop") == 0);
+        CHECK(w.Write("q") == -EAGAIN);
+        g.paused = false;
+    }
+    CHECK(ReadTarget(fd) == "abcdefghijklmnop");
+}
+
+TEST_CASE("ErrorPropagation") {
+    int fd = OpenTarget();
+    {
+        SlowWriteGlitch g{fd};
+        g.next_error = ENOSPC;
+
+        AsyncBufWriter w(fd, 3);
+        REQUIRE(w.Write("ab") == 0);
+        w.Flush();
+        CHECK(w.Sync() == -ENOSPC);
+        CHECK(w.Write("cd") == -ENOSPC);
+        CHECK(w.Flush() == -ENOSPC);
+    }
+    CHECK(ReadTarget(fd).empty());
+}
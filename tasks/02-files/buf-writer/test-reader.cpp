@@ -0,0 +1,223 @@
+#include "reader.hpp"
+
+#include <glitch.hpp>
+
+#include <distributions.hpp>
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr const char* kFileName = "/tmp/deleteme-buf-reader";
+
+struct ReadGlitch final : ReadGuard, ReadChkGuard {
+    explicit ReadGlitch(bool trim = true) : enable_trim(trim) {
+    }
+
+    ssize_t Read(int fd, void* buf, size_t count) override {
+        OnRead(&count);
+        if (auto next = std::exchange(next_error, 0)) {
+            errno = next;
+            return -1;
+        }
+        return RealRead(fd, buf, count);
+    }
+
+    ssize_t ReadChk(int fd, void* buf, size_t count, size_t buflen) override {
+        OnRead(&count);
+        return RealReadChk(fd, buf, count, buflen);
+    }
+
+    void OnRead(size_t* count) {
+        ++reads_count;
+        if (enable_trim && *count > 0) {
+            *count = rng() % *count + 1;
+        }
+    }
+
+    size_t reads_count = 0;
+    int next_error = 0;
+    bool enable_trim = true;
+    PCGRandom rng{424243};
+};
+
+// Regular file with the given contents, so both backends can be used.
+struct Input {
+    explicit Input(std::string_view data) {
+        fd = open(kFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        INTERNAL_ASSERT(fd != -1);
+        size_t pos = 0;
+        while (pos < data.size()) {
+            ssize_t w = write(fd, data.data() + pos, data.size() - pos);
+            INTERNAL_ASSERT(w > 0);
+            pos += w;
+        }
+        INTERNAL_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    }
+
+    ~Input() {
+        close(fd);
+        unlink(kFileName);
+    }
+
+    int fd;
+};
+
+std::vector<BufReader::Backend> AllBackends() {
+    return {BufReader::Backend::Auto, BufReader::Backend::Read};
+}
+
+std::string RandomText(size_t lines, PCGRandom& rng) {
+    UniformCharDistribution distr('a', 'z');
+    std::string text;
+    for (size_t i = 0; i < lines; ++i) {
+        size_t len = rng() % 4 == 0 ? rng() % 300 : rng() % 20;
+        for (size_t j = 0; j < len; ++j) {
+            text.push_back(distr(rng));
+        }
+        text.push_back('\n');
+    }
+    return text;
+}
+
+std::vector<std::string> SplitLines(std::string_view text) {
+    std::vector<std::string> lines;
+    while (!text.empty()) {
+        auto pos = std::min(text.find('\n'), text.size());
+        lines.emplace_back(text.substr(0, pos));
+        text.remove_prefix(std::min(pos + 1, text.size()));
+    }
+    return lines;
+}
+
+std::vector<std::string> ReadAllLines(BufReader& reader) {
+    std::vector<std::string> lines;
+    std::string_view line;
+    int r;
+    while ((r = reader.ReadLine(&line)) == 1) {
+        lines.emplace_back(line);
+    }
+    REQUIRE(r == 0);
+    return lines;
+}
+
+TEST_CASE("Backends") {
+    Input in{"abc\n"};
+    BufReader mapped{in.fd, 16};
+    CHECK(mapped.IsMapped());
+    BufReader plain{in.fd, 16, BufReader::Backend::Read};
+    CHECK(!plain.IsMapped());
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    BufReader piped{fds[0], 16};
+    CHECK(!piped.IsMapped());
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Lines") {
+    for (auto backend : AllBackends()) {
+        {
+            Input in{"aba\n\ncaba\nlast"};
+            BufReader reader{in.fd, 3, backend};
+            CHECK(ReadAllLines(reader) ==
+                  std::vector<std::string>{"aba", "", "caba", "last"});
+        }
+        {
+            Input in{""};
+            BufReader reader{in.fd, 3, backend};
+            CHECK(ReadAllLines(reader).empty());
+        }
+    }
+}
+
+TEST_CASE("RandomLines") {
+    PCGRandom rng{4243};
+    ReadGlitch g;
+    for (auto backend : AllBackends()) {
+        for (size_t capacity : {1, 7, 64, 4096}) {
+            auto text = RandomText(500, rng);
+            Input in{text};
+            BufReader reader{in.fd, capacity, backend};
+            CHECK(ReadAllLines(reader) == SplitLines(text));
+        }
+    }
+}
+
+TEST_CASE("PeekConsume") {
+    for (auto backend : AllBackends()) {
+        Input in{"0123456789"};
+        BufReader reader{in.fd, 4, backend};
+
+        std::string_view data;
+        REQUIRE(reader.Peek(2, &data) == 0);
+        REQUIRE(data.size() >= 2);
+        CHECK(data.substr(0, 2) == "01");
+        reader.Consume(3);
+
+        REQUIRE(reader.Peek(6, &data) == 0);
+        REQUIRE(data.size() >= 6);
+        CHECK(data.substr(0, 6) == "345678");
+        reader.Consume(6);
+
+        REQUIRE(reader.Peek(5, &data) == 0);
+        CHECK(data == "9");
+        reader.Consume(100);
+
+        REQUIRE(reader.Peek(1, &data) == 0);
+        CHECK(data.empty());
+    }
+}
+
+struct Record {
+    uint32_t id;
+    uint16_t kind;
+    char tag[6];
+};
+
+TEST_CASE("Records") {
+    PCGRandom rng{43};
+    ReadGlitch g;
+
+    std::vector<Record> records(1000);
+    for (auto& r : records) {
+        r = {.id = rng(), .kind = static_cast<uint16_t>(rng()), .tag = "tag"};
+    }
+    std::string raw(reinterpret_cast<const char*>(records.data()),
+                    records.size() * sizeof(Record));
+
+    for (auto backend : AllBackends()) {
+        Input in{raw + "xyz"};
+        BufReader reader{in.fd, 50, backend};
+        for (const auto& expected : records) {
+            Record actual;
+            REQUIRE(reader.ReadRecord(&actual) == 1);
+            REQUIRE(actual.id == expected.id);
+            REQUIRE(actual.kind == expected.kind);
+        }
+        Record tail;
+        CHECK(reader.ReadRecord(&tail) == -ENODATA);
+    }
+}
+
+TEST_CASE("ReadErrors") {
+    Input in{"abc\ndef\n"};
+    ReadGlitch g{false};
+    g.next_error = EIO;
+
+    BufReader reader{in.fd, 16, BufReader::Backend::Read};
+    std::string_view line;
+    CHECK(reader.ReadLine(&line) == -EIO);
+    REQUIRE(reader.ReadLine(&line) == 1);
+    CHECK(line == "abc");
+    CHECK(g.reads_count == 2);
+}
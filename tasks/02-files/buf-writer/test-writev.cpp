@@ -0,0 +1,231 @@
+#include "writer.hpp"
+
+#include <glitch.hpp>
+
+#include <distributions.hpp>
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr const char* kFileName = "/tmp/deleteme-buf-writer-v";
+
+// writev is not one of the calls of the glitch library, so this test wraps
+// it itself: it is linked with -Wl,-wrap=writev.
+extern "C" ssize_t __real_writev(int fd, const iovec* iov, int iovcnt);
+
+struct WriteVHook {
+    virtual ssize_t WriteV(int fd, const iovec* iov, int iovcnt) = 0;
+};
+
+WriteVHook* write_v_hook = nullptr;
+
+extern "C" ssize_t __wrap_writev(int fd, const iovec* iov, int iovcnt) {
+    if (auto hook = write_v_hook) {
+        return hook->WriteV(fd, iov, iovcnt);
+    }
+    return __real_writev(fd, iov, iovcnt);
+}
+
+struct WriteVGlitch final : WriteGuard, WriteVHook {
+    explicit WriteVGlitch(int fd, bool trim = false)
+        : target_fd(fd),
+          enable_trim(trim),
+          prev_hook_(std::exchange(write_v_hook, this)) {
+    }
+
+    ~WriteVGlitch() {
+        write_v_hook = prev_hook_;
+    }
+
+    ssize_t Write(int fd, const void* buf, size_t count) override {
+        if (fd == target_fd) {
+            ++writes_count;
+        }
+        return RealWrite(fd, buf, count);
+    }
+
+    ssize_t WriteV(int fd, const iovec* iov, int iovcnt) override {
+        if (fd != target_fd) {
+            return __real_writev(fd, iov, iovcnt);
+        }
+
+        ++writevs_count;
+        if (auto next = std::exchange(next_error, 0)) {
+            errno = next;
+            return -1;
+        }
+        if (!enable_trim) {
+            return __real_writev(fd, iov, iovcnt);
+        }
+
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            total += iov[i].iov_len;
+        }
+        size_t limit = total == 0 ? 0 : rng() % total + 1;
+        std::vector<iovec> trimmed;
+        for (int i = 0; i < iovcnt && limit > 0; ++i) {
+            size_t len = std::min(limit, iov[i].iov_len);
+            trimmed.push_back({.iov_base = iov[i].iov_base, .iov_len = len});
+            limit -= len;
+        }
+        return __real_writev(fd, trimmed.data(),
+                             static_cast<int>(trimmed.size()));
+    }
+
+    int target_fd;
+    size_t writes_count = 0;
+    size_t writevs_count = 0;
+    int next_error = 0;
+    bool enable_trim = false;
+    PCGRandom rng{424243};
+
+  private:
+    WriteVHook* prev_hook_;
+};
+
+int OpenTarget() {
+    int fd = open(kFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    INTERNAL_ASSERT(fd != -1);
+    return fd;
+}
+
+std::string ReadTarget(int fd) {
+    std::string data;
+    char buf[4096];
+    ssize_t r;
+    while ((r = pread(fd, buf, sizeof(buf), data.size())) > 0) {
+        data.append(buf, r);
+    }
+    INTERNAL_ASSERT(r == 0);
+    close(fd);
+    unlink(kFileName);
+    return data;
+}
+
+std::string RandomString(size_t size, PCGRandom& rng) {
+    UniformCharDistribution distr('a', 'z');
+    std::string s(size, ' ');
+    std::generate(s.begin(), s.end(), [&] { return distr(rng); });
+    return s;
+}
+
+TEST_CASE("SmallSlicesAreBuffered") {
+    int fd = OpenTarget();
+    {
+        WriteVGlitch g{fd};
+        BufWriter w(fd, 100);
+
+        std::string_view slices[] = {"aba", "", "caba", "daba"};
+        REQUIRE(w.WriteV(slices) == 0);
+        REQUIRE(w.WriteV(slices) == 0);
+        CHECK(g.writes_count + g.writevs_count == 0);
+
+        REQUIRE(w.Flush() == 0);
+        CHECK(g.writes_count + g.writevs_count == 1);
+    }
+    CHECK(ReadTarget(fd) == "abacabadabaabacabadaba");
+}
+
+TEST_CASE("HeadersAndBodies") {
+    PCGRandom rng{43};
+    int fd = OpenTarget();
+    std::string expected;
+    {
+        WriteVGlitch g{fd};
+        BufWriter w(fd, 1024);
+
+        for (size_t i = 0; i < 100; ++i) {
+            auto header = RandomString(rng() % 32, rng);
+            auto body = RandomString(2048 + rng() % 4096, rng);
+            std::string_view slices[] = {header, body, "\n"};
+            REQUIRE(w.WriteV(slices) == 0);
+            expected += header + body + "\n";
+        }
+        CHECK(g.writes_count == 0);
+        CHECK(g.writevs_count == 100);
+
+        // Write keeps using write.
+        REQUIRE(w.Write("tail") == 0);
+        std::string big(5000, 'x');
+        REQUIRE(w.Write(big) == 0);
+        expected += "tail" + big;
+        CHECK(g.writes_count == 2);
+        CHECK(g.writevs_count == 100);
+    }
+    CHECK(ReadTarget(fd) == expected);
+}
+
+TEST_CASE("BodiesRelativeToAverage") {
+    int fd = OpenTarget();
+    {
+        WriteVGlitch g{fd};
+        BufWriter w(fd, 1000);
+
+        // Uniform 200-byte slices are buffered as usual.
+        std::string record(200, 'r');
+        std::string_view records[] = {record};
+        for (size_t i = 0; i < 4; ++i) {
+            REQUIRE(w.WriteV(records) == 0);
+        }
+        CHECK(g.writevs_count == 0);
+        REQUIRE(w.Flush() == 0);
+
+        // Tiny writes drag the average down, so the next larger slice is a
+        // body and goes out without being copied, although it would fit.
+        for (size_t i = 0; i < 100; ++i) {
+            REQUIRE(w.Write("t") == 0);
+        }
+        std::string body(700, 'b');
+        std::string_view bodies[] = {body};
+        REQUIRE(w.WriteV(bodies) == 0);
+        CHECK(g.writes_count == 1);
+        CHECK(g.writevs_count == 1);
+    }
+    CHECK(ReadTarget(fd).size() == 4 * 200 + 100 + 700);
+}
+
+TEST_CASE("ManySlicesAndPartialWrites") {
+    PCGRandom rng{4243};
+    int fd = OpenTarget();
+    std::string expected;
+    {
+        WriteVGlitch g{fd, true};
+        BufWriter w(fd, 64);
+
+        for (size_t iter = 0; iter < 20; ++iter) {
+            std::vector<std::string> parts;
+            for (size_t i = 0; i < 300; ++i) {
+                parts.push_back(RandomString(rng() % 80, rng));
+                expected += parts.back();
+            }
+            std::vector<std::string_view> slices(parts.begin(), parts.end());
+            REQUIRE(w.WriteV(slices) == 0);
+        }
+        CHECK(g.writevs_count >= 20 * 300 / 64);
+    }
+    CHECK(ReadTarget(fd) == expected);
+}
+
+TEST_CASE("WriteVErrors") {
+    int fd = OpenTarget();
+    {
+        WriteVGlitch g{fd};
+        g.next_error = EIO;
+        BufWriter w(fd, 16);
+
+        std::string body(100, 'b');
+        std::string_view slices[] = {"head", body};
+        CHECK(w.WriteV(slices) == -EIO);
+        CHECK(w.WriteV(slices) == 0);
+    }
+    CHECK(ReadTarget(fd) == "head" + std::string(100, 'b'));
+}
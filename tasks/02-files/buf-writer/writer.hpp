@@ -1,11 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <span>
 #include <string_view>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <unused.hpp>  // TODO: remove before flight.
@@ -25,6 +28,7 @@ struct BufWriter {
     BufWriter& operator=(BufWriter&&) = delete;
 
     int Write(std::string_view data) {
+        Observe(data.size());
         if (size_ + data.size() <= capacity_) {
             std::memcpy(buffer_ + size_, data.data(), data.size());
             size_ += data.size();
@@ -52,6 +56,74 @@ struct BufWriter {
         return 0;
     }
 
+    // Gather version of Write. Small slices are copied into the buffer while
+    // there is room, large ones are referenced in place. If anything had to
+    // be referenced, the whole batch goes out with a single writev (or a few
+    // if it exceeds kMaxIov slices), otherwise it stays buffered.
+    int WriteV(std::span<const std::string_view> slices) {
+        iovec iov[kMaxIov];
+        int cnt = 0;
+        bool borrowed = false;
+        size_t tail = 0;  // Start of the buffer part not covered by iov yet.
+
+        // Writes out everything collected so far, including bytes buffered
+        // after the last iov entry.
+        auto drain = [&]() -> int {
+            if (size_ != tail) {
+                iov[cnt++] = {.iov_base = buffer_ + tail,
+                              .iov_len = size_ - tail};
+            }
+            int res = FlushIov(iov, cnt);
+            cnt = 0;
+            tail = size_ = 0;
+            return res;
+        };
+        // The last iov slot is always kept for drain.
+        auto push = [&](const char* base, size_t len) -> int {
+            if (cnt == kMaxIov - 1) {
+                if (int res = drain(); res != 0) {
+                    return res;
+                }
+            }
+            iov[cnt++] = {.iov_base = const_cast<char*>(base), .iov_len = len};
+            return 0;
+        };
+        // Turns bytes buffered since the last iov entry into an entry.
+        auto seal = [&]() -> int {
+            if (size_ == tail) {
+                return 0;
+            }
+            if (cnt == kMaxIov - 1) {
+                return drain();
+            }
+            iov[cnt++] = {.iov_base = buffer_ + tail, .iov_len = size_ - tail};
+            tail = size_;
+            return 0;
+        };
+
+        for (std::string_view slice : slices) {
+            bool large = IsLarge(slice.size());
+            Observe(slice.size());
+            if (slice.empty()) {
+                continue;
+            }
+            if (!large && size_ + slice.size() <= capacity_) {
+                std::memcpy(buffer_ + size_, slice.data(), slice.size());
+                size_ += slice.size();
+                continue;
+            }
+            if (int res = seal(); res != 0) {
+                return res;
+            }
+            if (int res = push(slice.data(), slice.size()); res != 0) {
+                return res;
+            }
+            borrowed = true;
+        }
+
+        return borrowed ? drain() : 0;
+    }
+
     int Flush() {
         int res = FlushArray(buffer_, size_);
         size_ = 0;
@@ -64,6 +136,54 @@ struct BufWriter {
     }
 
   private:
+    static constexpr int kMaxIov = 64;
+
+    // Slices of WriteV that are at least kLargeFactor times bigger than the
+    // running average of all writes (and not tiny compared to the buffer)
+    // are treated as bodies and are sent uncopied. Uniform workloads thus
+    // keep the plain buffering behaviour, whatever their write size is.
+    static constexpr size_t kLargeFactor = 4;
+    static constexpr size_t kMinLargeFraction = 4;
+    static constexpr size_t kAvgShift = 3;
+
+    bool IsLarge(size_t size) const {
+        return size >= std::max(kLargeFactor * AvgSize(),
+                                capacity_ / kMinLargeFraction);
+    }
+
+    size_t AvgSize() const {
+        return avg_size_ >> kAvgShift;
+    }
+
+    // Exponential moving average with weight 1/8, kept in fixed point.
+    void Observe(size_t size) {
+        if (avg_size_ == 0) {
+            avg_size_ = size << kAvgShift;
+        } else {
+            avg_size_ = avg_size_ - AvgSize() + size;
+        }
+    }
+
+    int FlushIov(iovec* iov, int cnt) {
+        while (cnt > 0) {
+            ssize_t res = ::writev(fd_, iov, cnt);
+            if (res == -1) {
+                return -errno;
+            }
+            auto written = static_cast<size_t>(res);
+            while (cnt > 0 && written >= iov->iov_len) {
+                written -= iov->iov_len;
+                ++iov;
+                --cnt;
+            }
+            if (cnt > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
+        }
+        return 0;
+    }
+
     int FlushArray(const char* buf, size_t count) {
         size_t written = 0;
         while (written < count) {
@@ -80,4 +200,5 @@ struct BufWriter {
     char* buffer_;
     size_t size_;
     size_t capacity_;
+    size_t avg_size_ = 0;
 };
\ No newline at end of file
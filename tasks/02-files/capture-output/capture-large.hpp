@@ -0,0 +1,286 @@
+#pragma once
+
+#include <defer.hpp>
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+#include <variant>
+
+namespace capture_detail {
+
+inline constexpr size_t kUnknownSize = std::numeric_limits<size_t>::max();
+
+// Replacement for one standard descriptor. `fd` is installed in place of the
+// standard one. Pipe sinks also keep their read end in `pipe_peer`, memfd
+// sinks are read back through `fd` itself.
+struct Channel {
+    int fd = -1;
+    int pipe_peer = -1;
+
+    void Close() {
+        if (fd != -1) {
+            close(std::exchange(fd, -1));
+        }
+        if (pipe_peer != -1) {
+            close(std::exchange(pipe_peer, -1));
+        }
+    }
+};
+
+inline int GrowPipe(int fd, size_t size) {
+    int current = fcntl(fd, F_GETPIPE_SZ);
+    if (current == -1) {
+        return errno;
+    }
+    if (size <= static_cast<size_t>(current)) {
+        return 0;
+    }
+    if (size > INT_MAX) {
+        return EINVAL;
+    }
+    // Fails with EPERM above /proc/sys/fs/pipe-max-size.
+    if (fcntl(fd, F_SETPIPE_SZ, static_cast<int>(size)) == -1) {
+        return errno;
+    }
+    return 0;
+}
+
+inline int OpenMemfd(Channel* channel) {
+    int fd = memfd_create("capture", MFD_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    channel->fd = fd;
+    return 0;
+}
+
+// Output can only go to a pipe if it is known to fit: nobody drains the pipe
+// while `f` runs, so an overflowing write would block forever. Everything
+// else lands in a memfd, which grows as needed.
+inline int OpenSink(size_t max_size, Channel* channel) {
+    int fds[2];
+    if (max_size != kUnknownSize && pipe2(fds, O_CLOEXEC) == 0) {
+        if (GrowPipe(fds[1], max_size) == 0) {
+            channel->fd = fds[1];
+            channel->pipe_peer = fds[0];
+            return 0;
+        }
+        close(fds[0]);
+        close(fds[1]);
+    }
+    return OpenMemfd(channel);
+}
+
+// Input is spliced into the pipe with vmsplice, so the pipe references the
+// caller's pages instead of copying them. `input` outlives the pipe, since
+// the pipe is closed before CaptureLargeOutput returns.
+//
+// An unaligned input may need one more pipe slot than its size suggests,
+// hence SPLICE_F_NONBLOCK: running out of room gives EAGAIN instead of a
+// deadlock, and the caller falls back to a memfd.
+inline int FillPipe(int fd, std::string_view input) {
+    while (!input.empty()) {
+        iovec iov{.iov_base = const_cast<char*>(input.data()),
+                  .iov_len = input.size()};
+        ssize_t res = vmsplice(fd, &iov, 1, SPLICE_F_NONBLOCK);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        input.remove_prefix(static_cast<size_t>(res));
+    }
+    return 0;
+}
+
+inline int FillMemfd(int fd, std::string_view input) {
+    while (!input.empty()) {
+        ssize_t res = write(fd, input.data(), input.size());
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        input.remove_prefix(static_cast<size_t>(res));
+    }
+    return lseek(fd, 0, SEEK_SET) == -1 ? errno : 0;
+}
+
+inline int OpenSource(std::string_view input, Channel* channel) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == 0) {
+        if (GrowPipe(fds[1], input.size()) == 0 &&
+            FillPipe(fds[1], input) == 0) {
+            close(fds[1]);
+            channel->fd = fds[0];
+            return 0;
+        }
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    if (int err = OpenMemfd(channel)) {
+        return err;
+    }
+    return FillMemfd(channel->fd, input);
+}
+
+inline int Restore(int* saved, int count) {
+    int err = 0;
+    for (int i = 0; i < count; ++i) {
+        if (dup2(saved[i], i) == -1 && err == 0) {
+            err = errno;
+        }
+        close(saved[i]);
+        saved[i] = -1;
+    }
+    return err;
+}
+
+// Saves the standard descriptors into `saved` and installs the channels.
+// Either everything is redirected or nothing is.
+inline int Redirect(const Channel* channels, int* saved) {
+    for (int i = 0; i < 3; ++i) {
+        saved[i] = fcntl(i, F_DUPFD_CLOEXEC, 3);
+        if (saved[i] == -1) {
+            int err = errno;
+            for (int j = 0; j < i; ++j) {
+                close(saved[j]);
+            }
+            return err;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (dup2(channels[i].fd, i) == -1) {
+            int err = errno;
+            Restore(saved, 3);
+            return err;
+        }
+    }
+    return 0;
+}
+
+inline int ReadPipe(int fd, std::string* out) {
+    int pending = 0;
+    if (ioctl(fd, FIONREAD, &pending) == 0) {
+        out->reserve(static_cast<size_t>(pending));
+    }
+    char buf[1 << 16];
+    while (true) {
+        ssize_t res = read(fd, buf, sizeof(buf));
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (res == 0) {
+            return 0;
+        }
+        out->append(buf, static_cast<size_t>(res));
+    }
+}
+
+inline int ReadMemfd(int fd, std::string* out) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return errno;
+    }
+    out->resize(static_cast<size_t>(st.st_size));
+    size_t pos = 0;
+    while (pos < out->size()) {
+        ssize_t res = pread(fd, out->data() + pos, out->size() - pos, pos);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (res == 0) {
+            break;
+        }
+        pos += static_cast<size_t>(res);
+    }
+    out->resize(pos);
+    return 0;
+}
+
+inline int Drain(Channel* channel, std::string* out) {
+    if (channel->pipe_peer == -1) {
+        return ReadMemfd(channel->fd, out);
+    }
+    // Our copy of the write end is the last one, closing it gives EOF.
+    close(std::exchange(channel->fd, -1));
+    return ReadPipe(channel->pipe_peer, out);
+}
+
+}  // namespace capture_detail
+
+// Same contract as CaptureOutput, but without the 64KiB limit.
+//
+// Input of any size is fed through a pipe grown with F_SETPIPE_SZ, or through
+// a memfd if it is larger than the pipe can get. Output goes to pipes only
+// when the caller promises that each stream fits into `max_output` bytes and
+// the pipes can be grown that far; otherwise both streams are collected in
+// memfds. The standard descriptors are restored before returning, on every
+// path, and no descriptors are leaked.
+template <class F>
+std::variant<std::pair<std::string, std::string>, int>
+CaptureLargeOutput(F&& f, std::string_view input,
+                   size_t max_output = capture_detail::kUnknownSize) {
+    using capture_detail::Channel;
+
+    Channel channels[3];
+    DEFER {
+        for (auto& channel : channels) {
+            channel.Close();
+        }
+    };
+
+    if (int err = capture_detail::OpenSource(input, &channels[0])) {
+        return err;
+    }
+    for (int i = 1; i < 3; ++i) {
+        if (int err = capture_detail::OpenSink(max_output, &channels[i])) {
+            return err;
+        }
+    }
+
+    int saved[3];
+    if (int err = capture_detail::Redirect(channels, saved)) {
+        return err;
+    }
+
+    f();
+    std::cout.flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+
+    if (int err = capture_detail::Restore(saved, 3)) {
+        return err;
+    }
+
+    std::pair<std::string, std::string> output;
+    if (int err = capture_detail::Drain(&channels[1], &output.first)) {
+        return err;
+    }
+    if (int err = capture_detail::Drain(&channels[2], &output.second)) {
+        return err;
+    }
+    return output;
+}
@@ -0,0 +1,227 @@
+#include "capture-large.hpp"
+
+#include <distributions.hpp>
+#include <fd-guard.hpp>
+#include <overload.hpp>
+#include <rlim-guard.hpp>
+
+#include <catch2/catch_get_random_seed.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void Flush() {
+    std::cout.flush();
+    std::clog.flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+}
+
+template <class Rng>
+std::string GenerateStr(Rng& rng, size_t n) {
+    UniformCharDistribution dist('a', 'z');
+    std::string s(n, ' ');
+    std::generate(s.begin(), s.end(), [&rng, &dist] { return dist(rng); });
+    return s;
+}
+
+void ResetCinState() {
+    std::cin.clear();
+    std::clearerr(stdin);
+}
+
+int WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t w = write(fd, data.data(), data.size());
+        if (w == -1) {
+            return -errno;
+        }
+        data.remove_prefix(w);
+    }
+    return 0;
+}
+
+int ReadAll(int fd, std::string* data) {
+    char buf[4096];
+    while (true) {
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r == -1) {
+            return -errno;
+        }
+        if (r == 0) {
+            return 0;
+        }
+        data->append(buf, r);
+    }
+}
+
+// Well above both the default pipe capacity and the 64KiB CaptureOutput can
+// handle, and above the default /proc/sys/fs/pipe-max-size.
+static constexpr size_t kLargeSize = 3 << 20;
+
+TEST_CASE("JustWorks") {
+    FileDescriptorsGuard guard;
+
+    Flush();
+    auto result = CaptureLargeOutput(
+        [] {
+            std::cout << "Aba";
+            std::cout.flush();
+            std::cerr << "Caba";
+        },
+        "");
+    REQUIRE(result.index() == 0);
+    auto [out, err] = std::get<0>(std::move(result));
+    CHECK(out == "Aba");
+    CHECK(err == "Caba");
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("LargeIO") {
+    FileDescriptorsGuard guard;
+    std::mt19937 rng(Catch::getSeed());
+
+    for (size_t size : {size_t{1} << 16, kLargeSize}) {
+        INFO("size = " << size);
+        auto inp = GenerateStr(rng, size);
+        auto my_out = GenerateStr(rng, size);
+        auto my_err = GenerateStr(rng, size / 2);
+
+        std::string actual_inp;
+        Flush();
+        auto result = CaptureLargeOutput(
+            [&] {
+                std::cin >> actual_inp;
+                std::cout << my_out;
+                std::cerr << my_err;
+            },
+            inp);
+        ResetCinState();
+
+        CHECK(actual_inp == inp);
+        REQUIRE(result.index() == 0);
+        auto [out, err] = std::get<0>(std::move(result));
+        CHECK(out == my_out);
+        CHECK(err == my_err);
+        CHECK(guard.TestDescriptorsState());
+    }
+}
+
+TEST_CASE("BoundedOutput") {
+    FileDescriptorsGuard guard;
+    std::mt19937 rng(Catch::getSeed());
+
+    // With a known bound output goes through grown pipes.
+    static constexpr size_t kBound = 256 << 10;
+    auto my_out = GenerateStr(rng, kBound);
+    auto my_err = GenerateStr(rng, kBound - 1);
+
+    bool piped = false;
+    Flush();
+    auto result = CaptureLargeOutput(
+        [&] {
+            struct stat st;
+            piped = fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode);
+            std::cout << my_out;
+            std::cerr << my_err;
+        },
+        "", kBound);
+
+    REQUIRE(result.index() == 0);
+    auto [out, err] = std::get<0>(std::move(result));
+    CHECK(piped);
+    CHECK(out == my_out);
+    CHECK(err == my_err);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("RawIO") {
+    FileDescriptorsGuard guard;
+    std::mt19937 rng(Catch::getSeed());
+
+    for (size_t size : {size_t{10}, size_t{100} << 10, kLargeSize}) {
+        INFO("size = " << size);
+        auto input = GenerateStr(rng, size);
+        auto output = GenerateStr(rng, size);
+        auto error = GenerateStr(rng, size);
+
+        std::string real_input;
+        int out_err = 0;
+        int err_err = 0;
+        int in_err = 0;
+        auto result = CaptureLargeOutput(
+            [&] {
+                out_err = WriteAll(STDOUT_FILENO, output);
+                err_err = WriteAll(STDERR_FILENO, error);
+                in_err = ReadAll(STDIN_FILENO, &real_input);
+            },
+            input);
+
+        REQUIRE(out_err == 0);
+        REQUIRE(err_err == 0);
+        REQUIRE(in_err == 0);
+
+        REQUIRE(result.index() == 0);
+        auto [out, err] = std::get<0>(std::move(result));
+        CHECK(out == output);
+        CHECK(err == error);
+        CHECK(real_input == input);
+        CHECK(guard.TestDescriptorsState());
+    }
+}
+
+TEST_CASE("ErrorRecovery") {
+    std::mt19937 rng(Catch::getSeed());
+
+    FileDescriptorsGuard guard;
+    constexpr auto base_fd_count = 3;
+
+    for (size_t i = 0; i <= 12; ++i) {
+        INFO("i = " << i);
+
+        auto out = GenerateStr(rng, 10);
+        auto err = GenerateStr(rng, 10);
+        auto inp = GenerateStr(rng, 10);
+
+        Flush();
+        auto result = [&] {
+            RLimGuard files_guard(RLIMIT_NOFILE, base_fd_count + i);
+            return CaptureLargeOutput(
+                [&] {
+                    (std::cout << out).flush();
+                    std::cerr << err;
+                },
+                inp, 100);
+        }();
+
+        if (i < 2) {
+            REQUIRE(result.index() == 1);
+        }
+        if (i > 11) {
+            REQUIRE(result.index() == 0);
+        }
+
+        std::visit(Overload{
+                       [&](std::pair<std::string, std::string> output) {
+                           CHECK(output.first == out);
+                           CHECK(output.second == err);
+                       },
+                       [](int err) {
+                           INFO("Error code: " << err << " "
+                                               << std::strerror(err));
+                           REQUIRE((err == EBADF || err == EMFILE));
+                       },
+                   },
+                   std::move(result));
+
+        CHECK(guard.TestDescriptorsState());
+    }
+}
@@ -1,7 +1,49 @@
-#include <dirent.h>
+#include "traverse.hpp"
 
-#include <unused.hpp>  // TODO: remove before flight.
+#include <cstring>
+#include <iostream>
+#include <variant>
+
+#include <unistd.h>
 
 int main(int argc, const char* argv[]) {
-    UNUSED(argc, argv);  // TODO: remove before flight.
+    if (argc != 2 && argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " DIR [CACHE_FILE]\n";
+        return 1;
+    }
+
+    if (argc == 2) {
+        if (int err = Traverse(argv[1], STDOUT_FILENO); err != 0) {
+            std::cerr << "Failed to traverse " << argv[1] << ": "
+                      << std::strerror(-err) << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    // A missing cache is created. Any other file that fails to load is left
+    // alone, since saving the cache would replace it.
+    DirCache cache;
+    auto loaded = DirCache::Load(argv[2]);
+    if (auto* err = std::get_if<int>(&loaded)) {
+        if (*err != -ENOENT) {
+            std::cerr << "Failed to load cache " << argv[2] << ": "
+                      << std::strerror(-*err) << '\n';
+            return 1;
+        }
+    } else {
+        cache = std::get<DirCache>(std::move(loaded));
+    }
+
+    int err = TraverseCached(argv[1], STDOUT_FILENO, &cache);
+    if (err != 0) {
+        std::cerr << "Failed to traverse " << argv[1] << ": "
+                  << std::strerror(-err) << '\n';
+    }
+    if (int save_err = cache.Save(argv[2]); save_err != 0) {
+        std::cerr << "Failed to save cache " << argv[2] << ": "
+                  << std::strerror(-save_err) << '\n';
+        return 1;
+    }
+    return err == 0 ? 0 : 1;
 }
@@ -0,0 +1,315 @@
+#include "traverse.hpp"
+
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr const char* kRoot = "/tmp/deleteme-traverse";
+constexpr const char* kCacheFile = "/tmp/deleteme-traverse-cache";
+
+void RemoveTree(const char* path) {
+    nftw(
+        path,
+        [](const char* p, const struct stat*, int, FTW*) { return remove(p); },
+        64, FTW_DEPTH | FTW_PHYS);
+}
+
+// Moves mtime of every directory well into the past, so the cache does not
+// consider them recently modified.
+void BackdateDirs() {
+    nftw(
+        kRoot,
+        [](const char* p, const struct stat* st, int, FTW*) {
+            if (S_ISDIR(st->st_mode)) {
+                timespec times[2] = {{.tv_sec = 0, .tv_nsec = UTIME_OMIT},
+                                     {.tv_sec = 1000000, .tv_nsec = 0}};
+                INTERNAL_ASSERT(utimensat(AT_FDCWD, p, times, 0) == 0);
+            }
+            return 0;
+        },
+        64, FTW_PHYS);
+}
+
+// Fresh empty directory at kRoot, removed with everything inside on exit.
+struct TempTree {
+    TempTree() {
+        RemoveTree(kRoot);
+        INTERNAL_ASSERT(mkdir(kRoot, 0755) == 0);
+    }
+
+    ~TempTree() {
+        RemoveTree(kRoot);
+    }
+
+    void Dir(const std::string& path) const {
+        INTERNAL_ASSERT(mkdir(Full(path).c_str(), 0755) == 0);
+    }
+
+    void File(const std::string& path) const {
+        int fd = open(Full(path).c_str(), O_WRONLY | O_CREAT, 0644);
+        INTERNAL_ASSERT(fd != -1);
+        close(fd);
+    }
+
+    void Link(const std::string& path, const char* target) const {
+        INTERNAL_ASSERT(symlink(target, Full(path).c_str()) == 0);
+    }
+
+    void Fifo(const std::string& path) const {
+        INTERNAL_ASSERT(mkfifo(Full(path).c_str(), 0644) == 0);
+    }
+
+    static std::string Full(const std::string& path) {
+        return std::string{kRoot} + "/" + path;
+    }
+};
+
+std::vector<std::string> SortedLines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        INTERNAL_ASSERT(end != std::string::npos);
+        lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+std::vector<std::string> RunTraverse(const char* root, size_t threads,
+                                     int* err, DirCache* cache = nullptr) {
+    int fd = memfd_create("traverse", MFD_CLOEXEC);
+    INTERNAL_ASSERT(fd != -1);
+    *err = cache == nullptr ? Traverse(root, fd, threads)
+                            : TraverseCached(root, fd, cache, threads);
+
+    std::string out;
+    char buf[4096];
+    ssize_t r;
+    while ((r = pread(fd, buf, sizeof(buf), out.size())) > 0) {
+        out.append(buf, r);
+    }
+    INTERNAL_ASSERT(r == 0);
+    close(fd);
+    return SortedLines(out);
+}
+
+// Straightforward readdir walk to compare against.
+void ReferenceWalk(const std::string& dir, const std::string& prefix,
+                   std::vector<std::string>* lines) {
+    DIR* d = opendir(dir.c_str());
+    INTERNAL_ASSERT(d != nullptr);
+    while (auto* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        struct stat st;
+        INTERNAL_ASSERT(lstat((dir + "/" + name).c_str(), &st) == 0);
+        bool is_dir = S_ISDIR(st.st_mode);
+        bool is_link = S_ISLNK(st.st_mode);
+        if (!is_dir && !is_link &&
+            (!S_ISREG(st.st_mode) || name[0] == '.')) {
+            continue;
+        }
+        if (is_dir) {
+            lines->push_back("d " + prefix + name + "/");
+            ReferenceWalk(dir + "/" + name, prefix + name + "/", lines);
+        } else {
+            lines->push_back((is_link ? "l " : "f ") + prefix + name);
+        }
+    }
+    closedir(d);
+}
+
+std::vector<std::string> Reference() {
+    std::vector<std::string> lines;
+    ReferenceWalk(kRoot, "", &lines);
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+TEST_CASE("Example") {
+    TempTree tree;
+    tree.File("a");
+    tree.Dir("b");
+    tree.File("b/c");
+    tree.Dir("d");
+    tree.Dir("d/e");
+    tree.Dir("d/e/f");
+    tree.File("d/e/f/g");
+    tree.Fifo("p");
+    tree.Link("l", "d/e");
+    tree.Dir(".hidden");
+    tree.File(".hidden/.file");
+    tree.File(".hidden/x..y");
+    tree.Link(".hidden/.link", ".nope");
+
+    std::vector<std::string> expected = {
+        "d .hidden/",      "d b/", "d d/",  "d d/e/",    "d d/e/f/",
+        "f .hidden/x..y",  "f a",  "f b/c", "f d/e/f/g", "l .hidden/.link",
+        "l l",
+    };
+    std::sort(expected.begin(), expected.end());
+
+    for (size_t threads : {1, 2, 4}) {
+        int err;
+        CHECK(RunTraverse(kRoot, threads, &err) == expected);
+        CHECK(err == 0);
+    }
+}
+
+TEST_CASE("Empty") {
+    TempTree tree;
+    int err;
+    CHECK(RunTraverse(kRoot, 3, &err).empty());
+    CHECK(err == 0);
+    // One thread per CPU.
+    CHECK(RunTraverse(kRoot, 0, &err).empty());
+    CHECK(err == 0);
+    CHECK(Traverse(kRoot, STDOUT_FILENO, 0) == 0);
+}
+
+TEST_CASE("Errors") {
+    TempTree tree;
+    tree.File("file");
+
+    int err;
+    CHECK(RunTraverse("/tmp/deleteme-traverse/none", 2, &err).empty());
+    CHECK(err == -ENOENT);
+    CHECK(RunTraverse("/tmp/deleteme-traverse/file", 2, &err).empty());
+    CHECK(err == -ENOTDIR);
+}
+
+std::vector<std::string> FillRandom(const TempTree& tree, size_t count,
+                                    PCGRandom& rng) {
+    std::vector<std::string> dirs = {""};
+    for (size_t i = 0; i < count; ++i) {
+        const auto& parent = dirs[rng() % dirs.size()];
+        std::string name = parent + (rng() % 8 == 0 ? "." : "") + "e" +
+                           std::to_string(i);
+        switch (rng() % 4) {
+            case 0:
+                tree.Dir(name);
+                dirs.push_back(name + "/");
+                break;
+            case 1:
+                tree.Link(name, "../x");
+                break;
+            case 2:
+                if (rng() % 4 == 0) {
+                    tree.Fifo(name);
+                    break;
+                }
+                [[fallthrough]];
+            default:
+                tree.File(name);
+        }
+    }
+    return dirs;
+}
+
+TEST_CASE("Random") {
+    PCGRandom rng{4243};
+    TempTree tree;
+    FillRandom(tree, 3000, rng);
+
+    auto expected = Reference();
+    for (size_t threads : {1, 2, 8, 0}) {
+        int err;
+        CHECK(RunTraverse(kRoot, threads, &err) == expected);
+        CHECK(err == 0);
+    }
+}
+
+TEST_CASE("Incremental") {
+    PCGRandom rng{424243};
+    TempTree tree;
+    auto dirs = FillRandom(tree, 2000, rng);
+    BackdateDirs();
+
+    DirCache cache;
+    int err;
+    auto expected = Reference();
+    CHECK(RunTraverse(kRoot, 4, &err, &cache) == expected);
+    CHECK(err == 0);
+    CHECK(cache.Size() == dirs.size());
+    CHECK(cache.LastStats().listed == dirs.size());
+    CHECK(cache.LastStats().reused == 0);
+
+    CHECK(RunTraverse(kRoot, 4, &err, &cache) == expected);
+    CHECK(err == 0);
+    CHECK(cache.LastStats().listed == 0);
+    CHECK(cache.LastStats().reused == dirs.size());
+
+    // Only the touched directories are read again.
+    tree.File(dirs[1] + "new");
+    tree.Dir(dirs[2] + "new-dir");
+    tree.File(dirs[2] + "new-dir/inner");
+    expected = Reference();
+    for (size_t threads : {1, 3}) {
+        CHECK(RunTraverse(kRoot, threads, &err, &cache) == expected);
+        CHECK(err == 0);
+        CHECK(cache.Size() == dirs.size() + 1);
+        CHECK(cache.LastStats().listed == 3);
+        CHECK(cache.LastStats().reused == dirs.size() - 2);
+    }
+}
+
+TEST_CASE("RecentlyModified") {
+    TempTree tree;
+    tree.Dir("a");
+    tree.File("a/b");
+
+    DirCache cache;
+    int err;
+    RunTraverse(kRoot, 2, &err, &cache);
+    // Same second as the first scan: mtime alone can not tell whether the
+    // directories changed since.
+    tree.File("a/c");
+    CHECK(RunTraverse(kRoot, 2, &err, &cache) == Reference());
+    CHECK(cache.LastStats().reused == 0);
+}
+
+TEST_CASE("CacheFile") {
+    PCGRandom rng{4243};
+    TempTree tree;
+    auto dirs = FillRandom(tree, 500, rng);
+    BackdateDirs();
+    unlink(kCacheFile);
+
+    auto loaded = DirCache::Load(kCacheFile);
+    REQUIRE(std::get<int>(loaded) == -ENOENT);
+
+    DirCache cache;
+    int err;
+    auto expected = RunTraverse(kRoot, 2, &err, &cache);
+    REQUIRE(cache.Save(kCacheFile) == 0);
+
+    loaded = DirCache::Load(kCacheFile);
+    REQUIRE(loaded.index() == 0);
+    cache = std::get<DirCache>(std::move(loaded));
+    CHECK(cache.Size() == dirs.size());
+    CHECK(RunTraverse(kRoot, 2, &err, &cache) == expected);
+    CHECK(cache.LastStats().reused == dirs.size());
+
+    REQUIRE(truncate(kCacheFile, 100) == 0);
+    CHECK(std::get<int>(DirCache::Load(kCacheFile)) == -EINVAL);
+    unlink(kCacheFile);
+}
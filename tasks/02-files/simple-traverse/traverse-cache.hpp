@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace traverse_detail {
+class Walker;
+}  // namespace traverse_detail
+
+// Listings of directories from a previous traversal, keyed by (dev, inode).
+//
+// A directory's mtime and ctime change whenever an entry is added, removed
+// or renamed in it, so a directory whose timestamps match the cached ones
+// can be printed from the cache without reading it. Its subdirectories
+// still have to be checked one by one: their changes do not propagate up.
+//
+// Timestamps have limited resolution, so a directory changed right after it
+// was listed may keep its old mtime. Directories modified less than
+// kRacyMargin seconds before the scan that cached them are never trusted.
+class DirCache {
+  public:
+    struct Key {
+        uint64_t dev;
+        uint64_t ino;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct Entry {
+        std::string name;
+        unsigned char d_type;
+    };
+
+    struct Dir {
+        timespec mtime;
+        timespec ctime;
+        std::vector<Entry> entries;
+    };
+
+    struct Stats {
+        size_t listed = 0;
+        size_t reused = 0;
+    };
+
+    static constexpr time_t kRacyMargin = 2;
+
+    // Returns -ENOENT if there is no cache yet and -EINVAL if the file is
+    // not a cache or is corrupted.
+    static std::variant<DirCache, int> Load(const char* path) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return -errno;
+        }
+        std::string data;
+        char buf[1 << 16];
+        while (true) {
+            ssize_t res = read(fd, buf, sizeof(buf));
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                int err = errno;
+                close(fd);
+                return -err;
+            }
+            if (res == 0) {
+                break;
+            }
+            data.append(buf, static_cast<size_t>(res));
+        }
+        close(fd);
+
+        DirCache cache;
+        if (!cache.Parse(data)) {
+            return -EINVAL;
+        }
+        return cache;
+    }
+
+    // Writes the cache next to `path` and renames it into place, so an
+    // interrupted save never leaves a truncated cache behind.
+    int Save(const char* path) const {
+        std::string data;
+        Put(&data, kMagic);
+        Put(&data, scan_start_);
+        Put(&data, static_cast<uint64_t>(dirs_.size()));
+        for (const auto& [key, dir] : dirs_) {
+            Put(&data, key);
+            Put(&data, dir.mtime);
+            Put(&data, dir.ctime);
+            Put(&data, static_cast<uint32_t>(dir.entries.size()));
+            for (const auto& entry : dir.entries) {
+                Put(&data, entry.d_type);
+                Put(&data, static_cast<uint16_t>(entry.name.size()));
+                data.append(entry.name);
+            }
+        }
+
+        std::string tmp = std::string{path} + ".tmp";
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+        if (fd == -1) {
+            return -errno;
+        }
+        std::string_view rest = data;
+        while (!rest.empty()) {
+            ssize_t res = write(fd, rest.data(), rest.size());
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                int err = errno;
+                close(fd);
+                unlink(tmp.c_str());
+                return -err;
+            }
+            rest.remove_prefix(static_cast<size_t>(res));
+        }
+        if (close(fd) == -1 || rename(tmp.c_str(), path) == -1) {
+            int err = errno;
+            unlink(tmp.c_str());
+            return -err;
+        }
+        return 0;
+    }
+
+    size_t Size() const {
+        return dirs_.size();
+    }
+
+    const Stats& LastStats() const {
+        return stats_;
+    }
+
+  private:
+    friend class traverse_detail::Walker;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>{}(key.ino * 0x9e3779b97f4a7c15 ^
+                                         key.dev);
+        }
+    };
+
+    static constexpr uint64_t kMagic = 0x3143525641525454;  // "TTRAVRC1"
+
+    static Key KeyOf(const struct stat& st) {
+        return {.dev = st.st_dev, .ino = st.st_ino};
+    }
+
+    static bool Equal(const timespec& a, const timespec& b) {
+        return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+    }
+
+    template <class T>
+    static void Put(std::string* data, const T& value) {
+        data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <class T>
+    static bool Get(std::string_view* data, T* value) {
+        if (data->size() < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(value, data->data(), sizeof(T));
+        data->remove_prefix(sizeof(T));
+        return true;
+    }
+
+    // Cached listing of the directory described by `st`, or nullptr if it
+    // is unknown or may have changed.
+    const Dir* Find(const struct stat& st) const {
+        auto it = dirs_.find(KeyOf(st));
+        if (it == dirs_.end()) {
+            return nullptr;
+        }
+        const auto& dir = it->second;
+        if (!Equal(dir.mtime, st.st_mtim) || !Equal(dir.ctime, st.st_ctim)) {
+            return nullptr;
+        }
+        if (dir.mtime.tv_sec + kRacyMargin > scan_start_.tv_sec) {
+            return nullptr;
+        }
+        return &dir;
+    }
+
+    void Insert(const struct stat& st, std::vector<Entry> entries) {
+        dirs_[KeyOf(st)] = Dir{.mtime = st.st_mtim,
+                               .ctime = st.st_ctim,
+                               .entries = std::move(entries)};
+    }
+
+    void Merge(DirCache&& other) {
+        dirs_.merge(std::move(other.dirs_));
+        stats_.listed += other.stats_.listed;
+        stats_.reused += other.stats_.reused;
+    }
+
+    bool Parse(std::string_view data) {
+        uint64_t magic;
+        uint64_t count;
+        if (!Get(&data, &magic) || magic != kMagic ||
+            !Get(&data, &scan_start_) || !Get(&data, &count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            Key key;
+            Dir dir;
+            uint32_t size;
+            if (!Get(&data, &key) || !Get(&data, &dir.mtime) ||
+                !Get(&data, &dir.ctime) || !Get(&data, &size)) {
+                return false;
+            }
+            for (uint32_t j = 0; j < size; ++j) {
+                Entry entry;
+                uint16_t len;
+                if (!Get(&data, &entry.d_type) || !Get(&data, &len) ||
+                    data.size() < len) {
+                    return false;
+                }
+                entry.name = data.substr(0, len);
+                data.remove_prefix(len);
+                dir.entries.push_back(std::move(entry));
+            }
+            dirs_.emplace(key, std::move(dir));
+        }
+        return data.empty();
+    }
+
+    std::unordered_map<Key, Dir, KeyHash> dirs_;
+    timespec scan_start_{};
+    Stats stats_;
+};
@@ -0,0 +1,440 @@
+#pragma once
+
+#include "traverse-cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace traverse_detail {
+
+inline constexpr size_t kDirentBufferSize = 1 << 17;
+inline constexpr size_t kOutputChunk = 1 << 16;
+
+// Entry kinds in the d/f/l output format.
+inline char TypeChar(unsigned char d_type) {
+    switch (d_type) {
+        case DT_DIR:
+            return 'd';
+        case DT_LNK:
+            return 'l';
+        default:
+            return 'f';
+    }
+}
+
+inline unsigned char ModeToDirentType(mode_t mode) {
+    if (S_ISDIR(mode)) {
+        return DT_DIR;
+    }
+    if (S_ISLNK(mode)) {
+        return DT_LNK;
+    }
+    if (S_ISREG(mode)) {
+        return DT_REG;
+    }
+    return DT_UNKNOWN;
+}
+
+// Only what `ls` shows: fifos, sockets and devices are skipped, and so are
+// hidden files, but not hidden directories and symlinks.
+inline bool IsVisible(const char* name, unsigned char d_type) {
+    if (d_type != DT_REG && d_type != DT_DIR && d_type != DT_LNK) {
+        return false;
+    }
+    return name[0] != '.' || d_type != DT_REG;
+}
+
+// Calls `f(name, d_type)` for every entry of `dirfd` except "." and "..".
+// Entries are fetched with getdents64 into `buf`, so a directory costs one
+// syscall per `size` bytes of names. DT_UNKNOWN (reported by some file
+// drivers) is resolved with a single fstatat. Returns 0 or -errno.
+template <class F>
+int ForEachDirent(int dirfd, char* buf, size_t size, F&& f) {
+    while (true) {
+        ssize_t read = getdents64(dirfd, buf, size);
+        if (read == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (read == 0) {
+            return 0;
+        }
+
+        for (ssize_t pos = 0; pos < read;) {
+            auto* entry = reinterpret_cast<dirent64*>(buf + pos);
+            pos += entry->d_reclen;
+
+            const char* name = entry->d_name;
+            if (name[0] == '.' &&
+                (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            unsigned char d_type = entry->d_type;
+            if (d_type == DT_UNKNOWN) {
+                struct stat st;
+                if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+                    if (errno == ENOENT) {
+                        continue;  // Removed since getdents64.
+                    }
+                    return -errno;
+                }
+                d_type = ModeToDirentType(st.st_mode);
+            }
+            f(name, d_type);
+        }
+    }
+}
+
+// Owns an open directory. Shared by the tasks of its subdirectories, so
+// they can be opened relative to it, and closed when the last one is done.
+struct DirHandle {
+    explicit DirHandle(int fd) : fd{fd} {
+    }
+
+    DirHandle(const DirHandle&) = delete;
+    DirHandle& operator=(const DirHandle&) = delete;
+
+    ~DirHandle() {
+        close(fd);
+    }
+
+    int fd;
+};
+
+inline int OpenSubdir(int parent_fd, const char* name) {
+    return openat(parent_fd, name,
+                  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+}
+
+// Lines of one worker, written out in large chunks. Appending needs no
+// synchronization; only the write itself is serialized, since writes of
+// more than PIPE_BUF bytes to a pipe may otherwise interleave.
+class OutputBuffer {
+  public:
+    OutputBuffer(int fd, std::mutex* write_mutex)
+        : fd_{fd}, write_mutex_{write_mutex} {
+        buffer_.reserve(kOutputChunk + PATH_MAX + 4);
+    }
+
+    int Append(char type, std::string_view prefix, std::string_view name) {
+        buffer_.push_back(type);
+        buffer_.push_back(' ');
+        buffer_.append(prefix);
+        buffer_.append(name);
+        if (type == 'd') {
+            buffer_.push_back('/');
+        }
+        buffer_.push_back('\n');
+        return buffer_.size() >= kOutputChunk ? Flush() : 0;
+    }
+
+    int Flush() {
+        std::lock_guard guard{*write_mutex_};
+        std::string_view data = buffer_;
+        while (!data.empty()) {
+            ssize_t res = write(fd_, data.data(), data.size());
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                buffer_.clear();
+                return -errno;
+            }
+            data.remove_prefix(static_cast<size_t>(res));
+        }
+        buffer_.clear();
+        return 0;
+    }
+
+  private:
+    int fd_;
+    std::mutex* write_mutex_;
+    std::string buffer_;
+};
+
+// A directory still to be listed: `name` relative to `parent`, printed as
+// `path` (which already ends with '/').
+struct Task {
+    std::shared_ptr<DirHandle> parent;
+    std::string path;
+    size_t name_offset;
+};
+
+// Directories are spread over workers, each with its own deque. A worker
+// takes the newest task from its own deque, which keeps the walk close to
+// depth-first and the number of open directories small, and steals the
+// oldest (usually the largest) subtree from others when it runs dry.
+//
+// With `cache` set, unchanged directories are printed from it instead of
+// being read, and every worker records what it saw into its own DirCache.
+class Walker {
+  public:
+    Walker(int out_fd, size_t workers_count, const DirCache* cache = nullptr)
+        : workers_(workers_count), cache_{cache} {
+        outputs_.reserve(workers_count);
+        for (size_t i = 0; i < workers_count; ++i) {
+            outputs_.emplace_back(out_fd, &write_mutex_);
+        }
+        if (cache_ != nullptr) {
+            fresh_.resize(workers_count);
+        }
+    }
+
+    int Run(int root_fd) {
+        root_ = std::make_shared<DirHandle>(root_fd);
+        Push(0, Task{.parent = nullptr, .path = {}, .name_offset = 0});
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers_.size(); ++i) {
+            threads.emplace_back([this, i] { Work(i); });
+        }
+        Work(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        root_.reset();
+        for (auto& output : outputs_) {
+            SetError(output.Flush());
+        }
+        return error_.load();
+    }
+
+    // Everything seen by the last Run, valid for scans after `scan_start`.
+    DirCache TakeCache(timespec scan_start) {
+        DirCache cache;
+        for (auto& fresh : fresh_) {
+            cache.Merge(std::move(fresh));
+        }
+        cache.scan_start_ = scan_start;
+        return cache;
+    }
+
+  private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Push(size_t worker, Task task) {
+        // Counted before it becomes visible: a thief may finish it before
+        // we get to the counters otherwise.
+        pending_.fetch_add(1);
+        queued_.fetch_add(1);
+        {
+            std::lock_guard guard{workers_[worker].mutex};
+            workers_[worker].tasks.push_back(std::move(task));
+        }
+        if (sleepers_.load() > 0) {
+            std::lock_guard guard{idle_mutex_};
+            idle_.notify_one();
+        }
+    }
+
+    std::optional<Task> Pop(size_t worker) {
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            auto& victim = workers_[(worker + i) % workers_.size()];
+            std::lock_guard guard{victim.mutex};
+            if (victim.tasks.empty()) {
+                continue;
+            }
+            Task task;
+            if (i == 0) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+            } else {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+            queued_.fetch_sub(1);
+            return task;
+        }
+        return std::nullopt;
+    }
+
+    void Work(size_t worker) {
+        std::vector<char> buf(kDirentBufferSize);
+        while (true) {
+            auto task = Pop(worker);
+            if (!task) {
+                std::unique_lock lock{idle_mutex_};
+                sleepers_.fetch_add(1);
+                idle_.wait(lock, [this] {
+                    return queued_.load() > 0 || pending_.load() == 0;
+                });
+                sleepers_.fetch_sub(1);
+                if (pending_.load() == 0) {
+                    return;
+                }
+                continue;
+            }
+
+            List(worker, std::move(*task), buf);
+            if (pending_.fetch_sub(1) == 1) {
+                std::lock_guard guard{idle_mutex_};
+                idle_.notify_all();
+            }
+        }
+    }
+
+    void List(size_t worker, Task task, std::vector<char>& buf) {
+        std::shared_ptr<DirHandle> dir;
+        if (task.parent == nullptr) {
+            dir = root_;
+        } else {
+            // The trailing '/' is not part of the name.
+            task.path.back() = '\0';
+            int fd = OpenSubdir(task.parent->fd,
+                                task.path.c_str() + task.name_offset);
+            task.path.back() = '/';
+            task.parent.reset();
+            if (fd == -1) {
+                SetError(-errno);
+                return;
+            }
+            dir = std::make_shared<DirHandle>(fd);
+        }
+
+        auto& output = outputs_[worker];
+        std::string_view prefix = task.path;
+        auto visit = [&](const char* name, unsigned char d_type) {
+            SetError(output.Append(TypeChar(d_type), prefix, name));
+            if (d_type == DT_DIR) {
+                std::string path{prefix};
+                path.append(name);
+                path.push_back('/');
+                Push(worker, Task{.parent = dir,
+                                  .path = std::move(path),
+                                  .name_offset = prefix.size()});
+            }
+        };
+
+        std::vector<DirCache::Entry> entries;
+        auto list = [&] {
+            return ForEachDirent(
+                dir->fd, buf.data(), buf.size(),
+                [&](const char* name, unsigned char d_type) {
+                    if (!IsVisible(name, d_type)) {
+                        return;
+                    }
+                    visit(name, d_type);
+                    if (cache_ != nullptr) {
+                        entries.push_back({name, d_type});
+                    }
+                });
+        };
+
+        struct stat st;
+        if (cache_ == nullptr || fstat(dir->fd, &st) == -1) {
+            SetError(list());
+            return;
+        }
+
+        auto& fresh = fresh_[worker];
+        if (const auto* cached = cache_->Find(st)) {
+            for (const auto& entry : cached->entries) {
+                visit(entry.name.c_str(), entry.d_type);
+            }
+            fresh.Insert(st, cached->entries);
+            ++fresh.stats_.reused;
+            return;
+        }
+
+        int res = list();
+        ++fresh.stats_.listed;
+        if (res == 0) {
+            fresh.Insert(st, std::move(entries));
+        }
+        SetError(res);
+    }
+
+    void SetError(int err) {
+        if (err != 0) {
+            int expected = 0;
+            error_.compare_exchange_strong(expected, err);
+        }
+    }
+
+    std::shared_ptr<DirHandle> root_;
+    std::vector<Worker> workers_;
+    std::vector<OutputBuffer> outputs_;
+    std::mutex write_mutex_;
+    const DirCache* cache_;
+    std::vector<DirCache> fresh_;
+
+    std::atomic<size_t> pending_ = 0;
+    std::atomic<size_t> queued_ = 0;
+    std::atomic<size_t> sleepers_ = 0;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_;
+
+    std::atomic<int> error_ = 0;
+};
+
+}  // namespace traverse_detail
+
+// Writes every visible entry below `root` to `out_fd`, one "t path" line per
+// entry (see README), in no particular order. Symlinks are not followed.
+//
+// Directories are read with getdents64 and opened relative to their parent,
+// so no full paths are resolved by the kernel. With `threads` > 1 they are
+// listed in parallel, which hides the latency of cold directories. Zero
+// means one thread per CPU.
+//
+// Unreadable directories are skipped; the walk goes on and the first error
+// is returned as -errno. Returns 0 on success.
+inline int Traverse(const char* root, int out_fd, size_t threads = 0) {
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd == -1) {
+        return -errno;
+    }
+    traverse_detail::Walker walker{out_fd, threads};
+    return walker.Run(root_fd);
+}
+
+// Same as Traverse, but reuses the listings of unchanged directories from
+// `cache`, which is replaced with the listings seen by this run. The cost
+// of a repeated scan is one fstat per directory plus reading the changed
+// ones. The caller loads and saves the cache (see DirCache).
+inline int TraverseCached(const char* root, int out_fd, DirCache* cache,
+                          size_t threads = 0) {
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    timespec scan_start;
+    clock_gettime(CLOCK_REALTIME, &scan_start);
+    int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd == -1) {
+        return -errno;
+    }
+    traverse_detail::Walker walker{out_fd, threads, cache};
+    int res = walker.Run(root_fd);
+    *cache = walker.TakeCache(scan_start);
+    return res;
+}
@@ -1,13 +1,24 @@
-#include <cstdint>
+#include "tree-index.hpp"
 
-#include <unused.hpp>  // TODO: remove before flight.
-
-struct Node {
-    int32_t key;
-    int32_t left_idx;
-    int32_t right_idx;
-};
+#include <cstring>
+#include <iostream>
+#include <variant>
 
 int main(int argc, char* argv[]) {
-    UNUSED(argc, argv);  // TODO: remove before flight.
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " TREE_FILE\n";
+        return 1;
+    }
+
+    auto opened = TreeIndex::Open(argv[1]);
+    if (auto* err = std::get_if<int>(&opened)) {
+        std::cerr << "Failed to map " << argv[1] << ": " << std::strerror(*err)
+                  << '\n';
+        return 1;
+    }
+
+    const auto& index = std::get<TreeIndex>(opened);
+    index.ForEachKey(TreeIndex::Order::Descending,
+                     [](int32_t key) { std::cout << key << ' '; });
+    std::cout << '\n';
 }
@@ -0,0 +1,187 @@
+#include "tree-index.hpp"
+
+#include <pcg-random.hpp>
+
+#include <catch2/catch_get_random_seed.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+constexpr const char* kTreeFile = "/tmp/deleteme-tree-index";
+constexpr const char* kSizesFile = "/tmp/deleteme-tree-index-sizes";
+
+void WriteTree(const std::vector<Node>& nodes) {
+    FILE* f = fopen(kTreeFile, "wb");
+    REQUIRE(f != nullptr);
+    if (!nodes.empty()) {
+        REQUIRE(fwrite(nodes.data(), sizeof(Node), nodes.size(), f) ==
+                nodes.size());
+    }
+    REQUIRE(fclose(f) == 0);
+}
+
+// Unbalanced BST built by plain insertion, so the height is random as well.
+std::vector<Node> BuildTree(const std::set<int32_t>& keys, PCGRandom& rng) {
+    std::vector<int32_t> order(keys.begin(), keys.end());
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::vector<Node> nodes;
+    for (int32_t key : order) {
+        nodes.push_back({.key = key, .left_idx = 0, .right_idx = 0});
+        int32_t added = static_cast<int32_t>(nodes.size() - 1);
+        if (added == 0) {
+            continue;
+        }
+        for (int32_t cur = 0;;) {
+            auto& next = key < nodes[cur].key ? nodes[cur].left_idx
+                                              : nodes[cur].right_idx;
+            if (next == 0) {
+                next = added;
+                break;
+            }
+            cur = next;
+        }
+    }
+    return nodes;
+}
+
+TreeIndex OpenIndex(bool with_sizes) {
+    auto result = with_sizes ? TreeIndex::Open(kTreeFile, kSizesFile)
+                             : TreeIndex::Open(kTreeFile);
+    REQUIRE(result.index() == 0);
+    return std::move(*std::get_if<TreeIndex>(&result));
+}
+
+std::vector<int32_t> Collect(const TreeIndex& index, int32_t lo, int32_t hi,
+                             TreeIndex::Order order) {
+    std::vector<int32_t> keys;
+    index.ForEachInRange(lo, hi, order,
+                         [&keys](int32_t key) { keys.push_back(key); });
+    return keys;
+}
+
+TEST_CASE("Example") {
+    // tests/001.dat
+    WriteTree({
+        {7, 1, 4},
+        {3, 2, 5},
+        {2, 3, 0},
+        {1, 0, 0},
+        {9, 8, 0},
+        {5, 6, 7},
+        {4, 0, 0},
+        {6, 0, 0},
+        {8, 0, 0},
+    });
+    REQUIRE(BuildSizeIndex(kTreeFile, kSizesFile) == 0);
+    auto index = OpenIndex(true);
+
+    CHECK(index.NodeCount() == 9);
+    CHECK(index.Find(5) == 5u);
+    CHECK(index.Find(7) == 0u);
+    CHECK(!index.Find(10).has_value());
+
+    using enum TreeIndex::Order;
+    CHECK(Collect(index, 3, 7, Ascending) == std::vector{3, 4, 5, 6});
+    CHECK(Collect(index, 3, 7, Descending) == std::vector{6, 5, 4, 3});
+    CHECK(Collect(index, 7, 3, Ascending).empty());
+
+    std::vector<int32_t> all;
+    index.ForEachKey(Descending, [&all](int32_t key) { all.push_back(key); });
+    CHECK(all == std::vector{9, 8, 7, 6, 5, 4, 3, 2, 1});
+
+    CHECK(index.KthLargest(1) == 9);
+    CHECK(index.KthLargest(4) == 6);
+    CHECK(index.KthLargest(9) == 1);
+    CHECK(!index.KthLargest(0).has_value());
+    CHECK(!index.KthLargest(10).has_value());
+}
+
+TEST_CASE("Empty") {
+    WriteTree({});
+    REQUIRE(BuildSizeIndex(kTreeFile, kSizesFile) == 0);
+    auto index = OpenIndex(true);
+
+    CHECK(index.NodeCount() == 0);
+    CHECK(!index.Find(0).has_value());
+    CHECK(!index.KthLargest(1).has_value());
+    CHECK(Collect(index, -10, 10, TreeIndex::Order::Ascending).empty());
+}
+
+TEST_CASE("Errors") {
+    CHECK(std::get<int>(TreeIndex::Open("/nonexistent")) == ENOENT);
+
+    WriteTree({{1, 0, 0}, {2, 0, 0}});
+    FILE* f = fopen(kTreeFile, "ab");
+    REQUIRE(f != nullptr);
+    fputc(0, f);
+    fclose(f);
+    CHECK(std::get<int>(TreeIndex::Open(kTreeFile)) == EINVAL);
+
+    WriteTree({{1, 0, 0}, {2, 0, 0}});
+    REQUIRE(BuildSizeIndex(kTreeFile, kSizesFile) == 0);
+    WriteTree({{1, 0, 0}, {2, 0, 0}, {3, 0, 0}});
+    CHECK(std::get<int>(TreeIndex::Open(kTreeFile, kSizesFile)) == EINVAL);
+}
+
+TEST_CASE("Corrupted") {
+    // Out of range index and a cycle through the root.
+    WriteTree({{5, 100, 1}, {7, 0, 1}});
+    auto index = OpenIndex(false);
+
+    CHECK(!index.Find(8).has_value());
+    CHECK(Collect(index, 0, 10, TreeIndex::Order::Ascending).size() <= 2);
+    CHECK(BuildSizeIndex(kTreeFile, kSizesFile) == -EINVAL);
+}
+
+TEST_CASE("Random") {
+    PCGRandom rng{Catch::getSeed()};
+
+    for (int iter = 0; iter < 20; ++iter) {
+        std::set<int32_t> keys;
+        size_t count = rng() % 2000 + 1;
+        while (keys.size() < count) {
+            keys.insert(static_cast<int32_t>(rng() % 10'000) - 5'000);
+        }
+        keys.insert(std::numeric_limits<int32_t>::max());
+        keys.insert(std::numeric_limits<int32_t>::min());
+
+        WriteTree(BuildTree(keys, rng));
+        REQUIRE(BuildSizeIndex(kTreeFile, kSizesFile) == 0);
+        auto index = OpenIndex(true);
+
+        std::vector<int32_t> sorted(keys.begin(), keys.end());
+        std::vector<int32_t> all;
+        index.ForEachKey(TreeIndex::Order::Ascending,
+                         [&all](int32_t key) { all.push_back(key); });
+        REQUIRE(all == sorted);
+
+        for (int q = 0; q < 200; ++q) {
+            int32_t key = static_cast<int32_t>(rng() % 12'000) - 6'000;
+            auto found = index.Find(key);
+            REQUIRE(found.has_value() == keys.contains(key));
+            if (found) {
+                REQUIRE(index.At(*found).key == key);
+            }
+
+            int32_t lo = static_cast<int32_t>(rng() % 12'000) - 6'000;
+            int32_t hi = lo + static_cast<int32_t>(rng() % 3'000);
+            std::vector<int32_t> expected(keys.lower_bound(lo),
+                                          keys.lower_bound(hi));
+            REQUIRE(Collect(index, lo, hi, TreeIndex::Order::Ascending) ==
+                    expected);
+            std::reverse(expected.begin(), expected.end());
+            REQUIRE(Collect(index, lo, hi, TreeIndex::Order::Descending) ==
+                    expected);
+
+            size_t k = rng() % sorted.size() + 1;
+            REQUIRE(index.KthLargest(k) == sorted[sorted.size() - k]);
+        }
+    }
+
+    std::remove(kTreeFile);
+    std::remove(kSizesFile);
+}
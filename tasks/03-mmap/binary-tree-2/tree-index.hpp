@@ -0,0 +1,371 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <optional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <variant>
+#include <vector>
+
+struct Node {
+    int32_t key;
+    int32_t left_idx;
+    int32_t right_idx;
+};
+
+static_assert(sizeof(Node) == 12);
+
+// Read-only view of a mapped file. Empty files are represented by an empty
+// mapping, since mmap refuses zero-length regions.
+struct MappedFile {
+    MappedFile() = default;
+
+    static std::variant<MappedFile, int> Open(const char* path) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return errno;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            int err = errno;
+            close(fd);
+            return err;
+        }
+
+        MappedFile file;
+        file.size_ = static_cast<size_t>(st.st_size);
+        if (file.size_ != 0) {
+            void* data =
+                mmap(nullptr, file.size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                int err = errno;
+                close(fd);
+                return err;
+            }
+            file.data_ = data;
+        }
+        close(fd);
+        return file;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other)
+        : data_{std::exchange(other.data_, nullptr)},
+          size_{std::exchange(other.size_, 0)} {
+    }
+
+    MappedFile& operator=(MappedFile&& other) {
+        MappedFile tmp{std::move(other)};
+        std::swap(data_, tmp.data_);
+        std::swap(size_, tmp.size_);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(data_, size_);
+        }
+    }
+
+    const void* Data() const {
+        return data_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // Queries touch a handful of nodes scattered over the file, so
+    // readahead only pollutes the page cache.
+    void AdviseRandom() const {
+        if (data_ != nullptr) {
+            madvise(data_, size_, MADV_RANDOM);
+        }
+    }
+
+  private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Query engine over a binary search tree stored in the `Node` file format
+// (root at index 0, child index 0 means "no child"). The tree is never
+// loaded: every query walks the mapping and keeps O(h) state.
+//
+// Child indices pointing outside of the file are treated as empty subtrees,
+// and walks are cut after visiting NodeCount() nodes, so a corrupted file
+// yields garbage results but never a crash or an endless loop.
+class TreeIndex {
+  public:
+    enum class Order {
+        Ascending,
+        Descending,
+    };
+
+    static std::variant<TreeIndex, int> Open(const char* tree_path) {
+        auto tree = MappedFile::Open(tree_path);
+        if (auto* err = std::get_if<int>(&tree)) {
+            return *err;
+        }
+
+        TreeIndex index;
+        index.tree_ = std::move(std::get<MappedFile>(tree));
+        if (index.tree_.Size() % sizeof(Node) != 0) {
+            return EINVAL;
+        }
+        index.tree_.AdviseRandom();
+        return index;
+    }
+
+    // Opens the tree together with a subtree-size sidecar produced by
+    // BuildSizeIndex. The sidecar enables KthLargest.
+    static std::variant<TreeIndex, int> Open(const char* tree_path,
+                                             const char* sizes_path) {
+        auto result = Open(tree_path);
+        auto* index = std::get_if<TreeIndex>(&result);
+        if (index == nullptr) {
+            return result;
+        }
+
+        auto sizes = MappedFile::Open(sizes_path);
+        if (auto* err = std::get_if<int>(&sizes)) {
+            return *err;
+        }
+        index->sizes_ = std::move(std::get<MappedFile>(sizes));
+        if (index->sizes_.Size() != index->NodeCount() * sizeof(uint32_t)) {
+            return EINVAL;
+        }
+        index->sizes_.AdviseRandom();
+        return result;
+    }
+
+    size_t NodeCount() const {
+        return tree_.Size() / sizeof(Node);
+    }
+
+    bool HasSizes() const {
+        return sizes_.Data() != nullptr;
+    }
+
+    Node At(size_t idx) const {
+        Node node;
+        std::memcpy(&node, Nodes() + idx * sizeof(Node), sizeof(node));
+        return node;
+    }
+
+    // Returns index of the node holding `key`.
+    std::optional<size_t> Find(int32_t key) const {
+        size_t steps = 0;
+        for (int64_t idx = Root(); idx != kNone && steps++ < NodeCount();) {
+            Node node = At(idx);
+            if (node.key == key) {
+                return idx;
+            }
+            idx = Child(key < node.key ? node.left_idx : node.right_idx);
+        }
+        return std::nullopt;
+    }
+
+    // Calls `f(key)` for every key in [lo, hi) in the requested order.
+    template <class F>
+    void ForEachInRange(int32_t lo, int32_t hi, Order order, F&& f) const {
+        Scan(lo, hi, order, f);
+    }
+
+    template <class F>
+    void ForEachKey(Order order, F&& f) const {
+        Scan(std::numeric_limits<int32_t>::min(),
+             int64_t{std::numeric_limits<int32_t>::max()} + 1, order, f);
+    }
+
+    // Returns the k-th largest key, k is 1-based. Requires the sidecar and
+    // runs in O(h).
+    std::optional<int32_t> KthLargest(size_t k) const {
+        if (!HasSizes() || k == 0) {
+            return std::nullopt;
+        }
+
+        size_t steps = 0;
+        for (int64_t idx = Root(); idx != kNone && steps++ < NodeCount();) {
+            Node node = At(idx);
+            size_t right = SubtreeSize(Child(node.right_idx));
+            if (k <= right) {
+                idx = Child(node.right_idx);
+            } else if (k == right + 1) {
+                return node.key;
+            } else {
+                k -= right + 1;
+                idx = Child(node.left_idx);
+            }
+        }
+        return std::nullopt;
+    }
+
+  private:
+    static constexpr int64_t kNone = -1;
+
+    TreeIndex() = default;
+
+    const char* Nodes() const {
+        return static_cast<const char*>(tree_.Data());
+    }
+
+    int64_t Root() const {
+        return NodeCount() == 0 ? kNone : 0;
+    }
+
+    int64_t Child(int32_t idx) const {
+        if (idx <= 0 || static_cast<size_t>(idx) >= NodeCount()) {
+            return kNone;
+        }
+        return idx;
+    }
+
+    size_t SubtreeSize(int64_t idx) const {
+        if (idx == kNone) {
+            return 0;
+        }
+        uint32_t size;
+        std::memcpy(&size,
+                    static_cast<const char*>(sizes_.Data()) +
+                        idx * sizeof(uint32_t),
+                    sizeof(size));
+        return size;
+    }
+
+    // Bounded in-order walk. `near` is the child holding smaller keys in
+    // the scan direction: everything left of `lo` (or right of `hi`) is
+    // skipped without being pushed, so the walk only touches the two
+    // boundary paths and the reported keys.
+    template <class F>
+    void Scan(int64_t lo, int64_t hi, Order order, F& f) const {
+        if (lo >= hi) {
+            return;
+        }
+        bool asc = order == Order::Ascending;
+        auto near = [asc](const Node& n) {
+            return asc ? n.left_idx : n.right_idx;
+        };
+        auto far = [asc](const Node& n) {
+            return asc ? n.right_idx : n.left_idx;
+        };
+        auto before_range = [&](const Node& n) {
+            return asc ? n.key < lo : n.key >= hi;
+        };
+        auto after_range = [&](const Node& n) {
+            return asc ? n.key >= hi : n.key < lo;
+        };
+
+        std::vector<int64_t> stack;
+        size_t budget = NodeCount();
+        auto descend = [&](int64_t idx) {
+            while (idx != kNone && budget != 0) {
+                --budget;
+                Node node = At(idx);
+                if (before_range(node)) {
+                    idx = Child(far(node));
+                } else {
+                    stack.push_back(idx);
+                    idx = Child(near(node));
+                }
+            }
+        };
+
+        descend(Root());
+        while (!stack.empty()) {
+            Node node = At(stack.back());
+            stack.pop_back();
+            if (after_range(node)) {
+                return;
+            }
+            f(node.key);
+            descend(Child(far(node)));
+        }
+    }
+
+    MappedFile tree_;
+    MappedFile sizes_;
+};
+
+// Builds the subtree-size sidecar for `tree_path`: a native-endian array
+// of uint32_t, like the tree itself, where element i is the size of the
+// subtree rooted at node i (unreachable nodes get 0). Uses a post-order
+// walk with O(h) memory and writes the result through a shared mapping.
+// Returns 0 or -errno.
+inline int BuildSizeIndex(const char* tree_path, const char* sizes_path) {
+    auto opened = TreeIndex::Open(tree_path);
+    if (auto* err = std::get_if<int>(&opened)) {
+        return -*err;
+    }
+    const auto& tree = std::get<TreeIndex>(opened);
+    size_t count = tree.NodeCount();
+
+    int fd = open(sizes_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return -errno;
+    }
+    size_t bytes = count * sizeof(uint32_t);
+    if (ftruncate(fd, static_cast<off_t>(bytes)) == -1) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+    if (count == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* mapped =
+        mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = mapped == MAP_FAILED ? errno : 0;
+    close(fd);
+    if (err != 0) {
+        return -err;
+    }
+    auto* sizes = static_cast<uint32_t*>(mapped);
+
+    auto child = [count](int32_t idx) -> int64_t {
+        if (idx <= 0 || static_cast<size_t>(idx) >= count) {
+            return -1;
+        }
+        return idx;
+    };
+    auto size_of = [sizes](int64_t idx) -> uint32_t {
+        return idx == -1 ? 0 : sizes[idx];
+    };
+
+    // Zero-filled pages double as the "not computed yet" marker.
+    std::vector<int64_t> stack{0};
+    while (!stack.empty()) {
+        if (stack.size() > count) {
+            munmap(mapped, bytes);
+            return -EINVAL;  // Cycle
+        }
+        Node node = tree.At(stack.back());
+        int64_t left = child(node.left_idx);
+        int64_t right = child(node.right_idx);
+        if (left != -1 && sizes[left] == 0) {
+            stack.push_back(left);
+            continue;
+        }
+        if (right != -1 && sizes[right] == 0) {
+            stack.push_back(right);
+            continue;
+        }
+        sizes[stack.back()] = 1 + size_of(left) + size_of(right);
+        stack.pop_back();
+    }
+
+    munmap(mapped, bytes);
+    return 0;
+}
@@ -1,50 +1,165 @@
 #pragma once
 
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <span>
+#include <type_traits>
+#include <utility>
 #include <variant>
 
-#include <unused.hpp>  // TODO: remove before flight.
+#include <sys/mman.h>
+#include <unistd.h>
 
-struct RingBuffer {
-    using ElementType = int64_t;
-    static constexpr size_t kPageSize = 1 << 12;
+namespace magic_detail {
 
-    static std::variant<RingBuffer, int> Create(size_t capacity) {
-        UNUSED(capacity);  // TODO: remove before flight.
-        return 0;  // TODO: remove before flight.
-        // TODO: your code here.
+inline constexpr size_t kPageSize = 1 << 12;
+
+inline size_t RoundUpToPages(size_t bytes) {
+    bytes = bytes == 0 ? 1 : bytes;
+    return (bytes + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+// Maps `header` bytes followed by `size` bytes of data, and then the same
+// data pages once more right after them, so that any `size` bytes starting
+// inside the data are contiguous. Both sizes are multiples of the page size.
+//
+// With fd == -1 the memory is shared anonymous and the copy is made with
+// mremap. Otherwise the first header + size bytes of `fd` are mapped, and
+// the pages stay valid in every process that maps the same file.
+//
+// Returns the start of the header, or nullptr with errno set.
+inline std::byte* MapTwice(int fd, size_t header, size_t size) {
+    size_t total = header + 2 * size;
+    void* base = mmap(nullptr, total, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    auto* bytes = static_cast<std::byte*>(base);
+
+    int flags = MAP_SHARED | MAP_FIXED | (fd == -1 ? MAP_ANONYMOUS : 0);
+    void* first = mmap(bytes, header + size, PROT_READ | PROT_WRITE, flags,
+                       fd, 0);
+    void* second = MAP_FAILED;
+    if (first != MAP_FAILED && fd == -1) {
+        // A zero old size makes mremap duplicate a shared mapping.
+        second = mremap(bytes + header, 0, size, MREMAP_MAYMOVE | MREMAP_FIXED,
+                        bytes + header + size);
+    } else if (first != MAP_FAILED) {
+        second = mmap(bytes + header + size, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, fd, static_cast<off_t>(header));
+    }
+    if (second == MAP_FAILED) {
+        int err = errno;
+        munmap(base, total);
+        errno = err;
+        return nullptr;
+    }
+    return bytes;
+}
+
+}  // namespace magic_detail
+
+// A ring buffer whose data is always contiguous: the pages are mapped
+// twice in a row, so [begin, begin + size) never needs to wrap. It does
+// not grow; see GrowableRingBuffer in growable-buffer.hpp.
+template <class T>
+class BasicRingBuffer {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(magic_detail::kPageSize % sizeof(T) == 0);
+
+  public:
+    using ElementType = T;
+    static constexpr size_t kPageSize = magic_detail::kPageSize;
+
+    static std::variant<BasicRingBuffer, int> Create(size_t capacity) {
+        size_t bytes = magic_detail::RoundUpToPages(capacity * sizeof(T));
+        std::byte* memory = magic_detail::MapTwice(-1, 0, bytes);
+        if (memory == nullptr) {
+            return errno;
+        }
+        return BasicRingBuffer{reinterpret_cast<T*>(memory),
+                               bytes / sizeof(T)};
+    }
+
+    BasicRingBuffer(BasicRingBuffer&& other)
+        : data_{std::exchange(other.data_, nullptr)},
+          capacity_{std::exchange(other.capacity_, 0)},
+          begin_{std::exchange(other.begin_, 0)},
+          size_{std::exchange(other.size_, 0)} {
+    }
+
+    BasicRingBuffer& operator=(BasicRingBuffer&& other) {
+        BasicRingBuffer tmp{std::move(other)};
+        std::swap(data_, tmp.data_);
+        std::swap(capacity_, tmp.capacity_);
+        std::swap(begin_, tmp.begin_);
+        std::swap(size_, tmp.size_);
+        return *this;
+    }
+
+    ~BasicRingBuffer() {
+        if (data_ != nullptr) {
+            munmap(data_, 2 * capacity_ * sizeof(T));
+        }
     }
 
     size_t Capacity() const {
-        return 0;  // TODO: remove before flight.
-        // TODO: your code here.
+        return capacity_;
     }
 
-    void PushBack(ElementType value) {
-        UNUSED(value);  // TODO: remove before flight.
-        // TODO: your code here.
+    void PushBack(T value) {
+        data_[begin_ + size_] = value;
+        ++size_;
     }
 
     void PopBack() {
-        // TODO: your code here.
+        --size_;
     }
 
-    void PushFront(ElementType value) {
-        UNUSED(value);  // TODO: remove before flight.
-        // TODO: your code here.
+    void PushFront(T value) {
+        begin_ = begin_ == 0 ? capacity_ - 1 : begin_ - 1;
+        data_[begin_] = value;
+        ++size_;
     }
 
     void PopFront() {
-        // TODO: your code here.
+        begin_ = begin_ + 1 == capacity_ ? 0 : begin_ + 1;
+        --size_;
+    }
+
+    // Appends `values`, which must fit.
+    void PushBackN(std::span<const T> values) {
+        std::memcpy(data_ + begin_ + size_, values.data(), values.size_bytes());
+        size_ += values.size();
     }
 
-    std::span<ElementType> Data() {
-        return {};  // TODO: remove before flight.
-        // TODO: your code here.
+    void PopFrontN(size_t count) {
+        begin_ = (begin_ + count) % capacity_;
+        size_ -= count;
+    }
+
+    // The second copy of the pages follows the first, so the elements are
+    // contiguous even when they wrap around the end of the buffer.
+    std::span<T> Data() {
+        return {data_ + begin_, size_};
     }
 
   private:
-    // TODO: your code here.
+    template <class U>
+    friend class GrowableRingBuffer;
+
+    BasicRingBuffer(T* data, size_t capacity, size_t begin = 0,
+                    size_t size = 0)
+        : data_{data}, capacity_{capacity}, begin_{begin}, size_{size} {
+    }
+
+    T* data_;
+    size_t capacity_;
+    size_t begin_;
+    size_t size_;
 };
+
+using RingBuffer = BasicRingBuffer<int64_t>;
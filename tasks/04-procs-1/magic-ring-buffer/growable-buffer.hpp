@@ -0,0 +1,175 @@
+#pragma once
+
+#include "buffer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace magic_detail {
+
+// Maps the same pages as the `size` bytes at `from` once more at `to`.
+// The source must lie within a single shared mapping.
+inline bool Duplicate(std::byte* from, size_t size, std::byte* to) {
+    return mremap(from, 0, size, MREMAP_MAYMOVE | MREMAP_FIXED, to) !=
+           MAP_FAILED;
+}
+
+}  // namespace magic_detail
+
+// A BasicRingBuffer that grows without touching the live elements. Growing
+// is not O(1), which is why it is kept apart from buffer.hpp.
+//
+// The old pages are mapped again into a larger window, starting with the
+// one that holds the first element, and fresh pages follow them. Only when
+// the elements wrap into that very page does its wrapped part, less than a
+// page, get copied. Every growth splits the mapping into a few more pieces,
+// which are kept in `cuts_` so that each one can be duplicated with a
+// single mremap.
+template <class T>
+class GrowableRingBuffer {
+  public:
+    using ElementType = T;
+    static constexpr size_t kPageSize = magic_detail::kPageSize;
+
+    static std::variant<GrowableRingBuffer, int> Create(size_t capacity) {
+        auto result = BasicRingBuffer<T>::Create(capacity);
+        if (auto* err = std::get_if<int>(&result)) {
+            return *err;
+        }
+        return GrowableRingBuffer{
+            std::move(*std::get_if<BasicRingBuffer<T>>(&result))};
+    }
+
+    size_t Capacity() const {
+        return buffer_.Capacity();
+    }
+
+    void PushBack(T value) {
+        buffer_.PushBack(value);
+    }
+
+    void PopBack() {
+        buffer_.PopBack();
+    }
+
+    void PushFront(T value) {
+        buffer_.PushFront(value);
+    }
+
+    void PopFront() {
+        buffer_.PopFront();
+    }
+
+    // Appends `values`, growing the buffer at least twice if they do not
+    // fit. Returns 0 or the error of the growth, leaving the buffer as is.
+    int PushBackN(std::span<const T> values) {
+        size_t size = buffer_.size_ + values.size();
+        if (size > buffer_.capacity_) {
+            int err = Reserve(std::max(2 * buffer_.capacity_, size));
+            if (err != 0) {
+                return err;
+            }
+        }
+        buffer_.PushBackN(values);
+        return 0;
+    }
+
+    void PopFrontN(size_t count) {
+        buffer_.PopFrontN(count);
+    }
+
+    // Grows the buffer to hold at least `capacity` elements. Data() keeps
+    // its contents but moves. Returns 0 or an error code, leaving the buffer
+    // as is.
+    int Reserve(size_t capacity) {
+        if (capacity <= buffer_.capacity_) {
+            return 0;
+        }
+        size_t old_bytes = buffer_.capacity_ * sizeof(T);
+        size_t bytes = magic_detail::RoundUpToPages(capacity * sizeof(T));
+        void* window = mmap(nullptr, 2 * bytes, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (window == MAP_FAILED) {
+            return errno;
+        }
+        auto* memory = static_cast<std::byte*>(window);
+        auto* old = reinterpret_cast<std::byte*>(buffer_.data_);
+
+        // The page with the first element goes first.
+        size_t shift = buffer_.begin_ * sizeof(T) / kPageSize * kPageSize;
+        std::vector<size_t> cuts;
+        cuts.reserve(cuts_.size() + 2);
+        for (size_t cut : cuts_) {
+            cuts.push_back((cut + old_bytes - shift) % old_bytes);
+        }
+        cuts.push_back(0);
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+        cuts.push_back(old_bytes);
+
+        // The first copy is the old pieces and then fresh pages, and the
+        // second copy repeats it piece by piece.
+        bool mapped = true;
+        for (size_t k = 0; mapped && k < cuts.size(); ++k) {
+            size_t size = PieceEnd(cuts, k, bytes) - cuts[k];
+            if (cuts[k] == old_bytes) {
+                mapped = mmap(memory + old_bytes, size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED, -1,
+                              0) != MAP_FAILED;
+            } else {
+                mapped = magic_detail::Duplicate(
+                    old + (cuts[k] + shift) % old_bytes, size,
+                    memory + cuts[k]);
+            }
+        }
+        for (size_t k = 0; mapped && k < cuts.size(); ++k) {
+            mapped = magic_detail::Duplicate(
+                memory + cuts[k], PieceEnd(cuts, k, bytes) - cuts[k],
+                memory + bytes + cuts[k]);
+        }
+        if (!mapped) {
+            int err = errno;
+            munmap(memory, 2 * bytes);
+            return err;
+        }
+
+        size_t begin = buffer_.begin_ - shift / sizeof(T);
+        size_t size = buffer_.size_;
+        if (begin + size > buffer_.capacity_) {
+            // These elements wrapped into the first page, in front of
+            // `begin`; they belong right after the old pages now.
+            std::memcpy(memory + old_bytes, memory,
+                        (begin + size - buffer_.capacity_) * sizeof(T));
+        }
+        buffer_ = BasicRingBuffer<T>{reinterpret_cast<T*>(memory),
+                                     bytes / sizeof(T), begin, size};
+        cuts_ = std::move(cuts);
+        return 0;
+    }
+
+    std::span<T> Data() {
+        return buffer_.Data();
+    }
+
+  private:
+    explicit GrowableRingBuffer(BasicRingBuffer<T> buffer)
+        : buffer_{std::move(buffer)} {
+    }
+
+    static size_t PieceEnd(const std::vector<size_t>& cuts, size_t k,
+                           size_t bytes) {
+        return k + 1 < cuts.size() ? cuts[k + 1] : bytes;
+    }
+
+    BasicRingBuffer<T> buffer_;
+    // Offsets of the separately mapped pieces of the first copy.
+    std::vector<size_t> cuts_ = {0};
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "buffer.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <utility>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace magic_detail {
+
+inline constexpr size_t kCacheLine = 64;
+inline constexpr uint64_t kStreamMagic = 0x314d525453435053;  // "SPCSTRM1"
+
+// The first page of the mapping. Positions only grow; the byte at position
+// p lives at offset p % capacity of the data. Each index is written by one
+// side only and sits on its own cache line.
+struct StreamHeader {
+    uint64_t magic;
+    uint64_t capacity;
+    alignas(kCacheLine) std::atomic<uint64_t> head;  // Written by the reader.
+    alignas(kCacheLine) std::atomic<uint64_t> tail;  // Written by the writer.
+};
+
+static_assert(sizeof(StreamHeader) <= kPageSize);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+}  // namespace magic_detail
+
+// A lock-free byte stream between one writer and one reader, built on the
+// same double mapping as RingBuffer: every span it hands out is contiguous,
+// even across the end of the buffer, so data can be parsed in place.
+//
+// The writer reserves a span, fills it and commits; the reader looks at
+// what is readable and commits what it has consumed. Commits are release
+// stores and the other side reads them with acquire, so the bytes are
+// visible before the index that covers them. Each side also keeps the
+// last index of the other side it has seen and only reloads it when that
+// one is not enough, so the indices' cache lines bounce only when needed.
+//
+// A stream made by CreateShared lives in a memfd: Fd() can be passed to
+// another process (by fork, exec or SCM_RIGHTS), which calls Attach on it.
+// One process should only write, the other only read.
+class SpscByteStream {
+  public:
+    static std::variant<SpscByteStream, int> Create(size_t capacity) {
+        return Make(-1, magic_detail::RoundUpToPages(capacity));
+    }
+
+    static std::variant<SpscByteStream, int> CreateShared(size_t capacity) {
+        int fd = memfd_create("spsc-stream", MFD_CLOEXEC);
+        if (fd == -1) {
+            return errno;
+        }
+        size_t size = magic_detail::RoundUpToPages(capacity);
+        if (ftruncate(fd, static_cast<off_t>(magic_detail::kPageSize + size)) ==
+            -1) {
+            int err = errno;
+            close(fd);
+            return err;
+        }
+        auto result = Make(fd, size);
+        if (result.index() != 0) {
+            close(fd);
+        }
+        return result;
+    }
+
+    // Maps a stream made by CreateShared in another process. Does not take
+    // ownership of `fd`.
+    static std::variant<SpscByteStream, int> Attach(int fd) {
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            return errno;
+        }
+        auto file_size = static_cast<size_t>(st.st_size);
+        if (file_size <= magic_detail::kPageSize ||
+            file_size % magic_detail::kPageSize != 0) {
+            return EINVAL;
+        }
+        size_t size = file_size - magic_detail::kPageSize;
+        std::byte* memory =
+            magic_detail::MapTwice(fd, magic_detail::kPageSize, size);
+        if (memory == nullptr) {
+            return errno;
+        }
+        SpscByteStream stream{memory, size, -1};
+        const auto* header = stream.header_;
+        if (header->magic != magic_detail::kStreamMagic ||
+            header->capacity != size) {
+            return EINVAL;
+        }
+        stream.cached_head_ = header->head.load(std::memory_order_acquire);
+        stream.cached_tail_ = header->tail.load(std::memory_order_acquire);
+        return stream;
+    }
+
+    SpscByteStream(SpscByteStream&& other)
+        : header_{std::exchange(other.header_, nullptr)},
+          data_{other.data_},
+          capacity_{other.capacity_},
+          fd_{std::exchange(other.fd_, -1)},
+          cached_head_{other.cached_head_},
+          cached_tail_{other.cached_tail_} {
+    }
+
+    SpscByteStream& operator=(SpscByteStream&& other) {
+        SpscByteStream tmp{std::move(other)};
+        std::swap(header_, tmp.header_);
+        std::swap(data_, tmp.data_);
+        std::swap(capacity_, tmp.capacity_);
+        std::swap(fd_, tmp.fd_);
+        std::swap(cached_head_, tmp.cached_head_);
+        std::swap(cached_tail_, tmp.cached_tail_);
+        return *this;
+    }
+
+    ~SpscByteStream() {
+        if (header_ != nullptr) {
+            munmap(header_, magic_detail::kPageSize + 2 * capacity_);
+        }
+        if (fd_ != -1) {
+            close(fd_);
+        }
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    // The memfd of a stream made by CreateShared, -1 otherwise.
+    int Fd() const {
+        return fd_;
+    }
+
+    // Writer side. Returns `n` contiguous writable bytes, or an empty span
+    // if less than `n` bytes are free now.
+    std::span<std::byte> ReserveWrite(size_t n) {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        if (tail + n - cached_head_ > capacity_) {
+            cached_head_ = header_->head.load(std::memory_order_acquire);
+            if (tail + n - cached_head_ > capacity_) {
+                return {};
+            }
+        }
+        return {data_ + tail % capacity_, n};
+    }
+
+    // Publishes the first `n` bytes of the last reserved span.
+    void CommitWrite(size_t n) {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        header_->tail.store(tail + n, std::memory_order_release);
+    }
+
+    // Reader side. Returns every byte written and not consumed yet, as one
+    // contiguous span.
+    std::span<const std::byte> Readable() {
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        if (cached_tail_ <= head) {
+            cached_tail_ = header_->tail.load(std::memory_order_acquire);
+        }
+        return {data_ + head % capacity_, cached_tail_ - head};
+    }
+
+    // Releases the first `n` readable bytes to the writer.
+    void CommitRead(size_t n) {
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        header_->head.store(head + n, std::memory_order_release);
+    }
+
+  private:
+    SpscByteStream(std::byte* memory, size_t capacity, int fd)
+        : header_{reinterpret_cast<magic_detail::StreamHeader*>(memory)},
+          data_{memory + magic_detail::kPageSize},
+          capacity_{capacity},
+          fd_{fd} {
+    }
+
+    static std::variant<SpscByteStream, int> Make(int fd, size_t size) {
+        std::byte* memory =
+            magic_detail::MapTwice(fd, magic_detail::kPageSize, size);
+        if (memory == nullptr) {
+            return errno;
+        }
+        SpscByteStream stream{memory, size, fd};
+        auto* header = new (memory) magic_detail::StreamHeader{
+            .magic = magic_detail::kStreamMagic,
+            .capacity = size,
+            .head = 0,
+            .tail = 0,
+        };
+        stream.header_ = header;
+        return stream;
+    }
+
+    magic_detail::StreamHeader* header_;
+    std::byte* data_;
+    size_t capacity_;
+    int fd_;
+    uint64_t cached_head_ = 0;  // The writer's view of head.
+    uint64_t cached_tail_ = 0;  // The reader's view of tail.
+};
@@ -0,0 +1,184 @@
+#include "spsc-stream.hpp"
+
+#include <mm.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_get_random_seed.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+SpscByteStream CreateStream(size_t capacity) {
+    auto result = SpscByteStream::Create(capacity);
+    REQUIRE(result.index() == 0);
+    return std::move(*std::get_if<SpscByteStream>(&result));
+}
+
+// Byte i of every stream in these tests is Expected(i).
+std::byte Expected(uint64_t position) {
+    return static_cast<std::byte>(position * 0x9E3779B97F4A7C15 >> 56);
+}
+
+// Writes `total` bytes in chunks of random size up to `max_chunk`.
+void Produce(SpscByteStream& stream, uint64_t total, size_t max_chunk,
+             uint64_t seed) {
+    PCGRandom rng{seed};
+    uint64_t position = 0;
+    while (position < total) {
+        size_t n = std::min<uint64_t>(rng() % max_chunk + 1, total - position);
+        auto span = stream.ReserveWrite(n);
+        if (span.empty()) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            span[i] = Expected(position + i);
+        }
+        stream.CommitWrite(n);
+        position += n;
+    }
+}
+
+// Reads `total` bytes in chunks of random size up to `max_chunk`, and
+// returns how many of them were wrong.
+uint64_t Consume(SpscByteStream& stream, uint64_t total, size_t max_chunk,
+                 uint64_t seed) {
+    PCGRandom rng{seed};
+    uint64_t position = 0;
+    uint64_t errors = 0;
+    while (position < total) {
+        auto span = stream.Readable();
+        if (span.empty()) {
+            std::this_thread::yield();
+            continue;
+        }
+        size_t n = std::min<size_t>(rng() % max_chunk + 1, span.size());
+        for (size_t i = 0; i < n; ++i) {
+            errors += span[i] != Expected(position + i);
+        }
+        stream.CommitRead(n);
+        position += n;
+    }
+    return errors;
+}
+
+}  // namespace
+
+TEST_CASE("JustWorks") {
+    auto stream = CreateStream(100);
+    REQUIRE(stream.Capacity() == kPageSize);
+    CHECK(stream.Fd() == -1);
+    CHECK(stream.Readable().empty());
+
+    auto span = stream.ReserveWrite(5);
+    REQUIRE(span.size() == 5);
+    std::memcpy(span.data(), "hello", 5);
+    CHECK(stream.Readable().empty());
+    stream.CommitWrite(5);
+
+    auto readable = stream.Readable();
+    REQUIRE(readable.size() == 5);
+    CHECK(std::memcmp(readable.data(), "hello", 5) == 0);
+    stream.CommitRead(2);
+    CHECK(stream.Readable().size() == 3);
+    stream.CommitRead(3);
+    CHECK(stream.Readable().empty());
+}
+
+TEST_CASE("Full") {
+    auto stream = CreateStream(kPageSize);
+    auto cap = stream.Capacity();
+
+    CHECK(stream.ReserveWrite(cap + 1).empty());
+    REQUIRE(stream.ReserveWrite(cap).size() == cap);
+    stream.CommitWrite(cap - 1);
+    CHECK(stream.ReserveWrite(2).empty());
+    CHECK(stream.ReserveWrite(1).size() == 1);
+
+    stream.CommitRead(10);
+    CHECK(stream.ReserveWrite(11).size() == 11);
+    CHECK(stream.ReserveWrite(12).empty());
+}
+
+TEST_CASE("WrapsContiguously") {
+    auto stream = CreateStream(kPageSize);
+    auto cap = stream.Capacity();
+
+    stream.ReserveWrite(cap - 10);
+    stream.CommitWrite(cap - 10);
+    stream.CommitRead(cap - 10);
+
+    // Starts 10 bytes before the end and continues in the second copy.
+    auto span = stream.ReserveWrite(100);
+    REQUIRE(span.size() == 100);
+    for (size_t i = 0; i < span.size(); ++i) {
+        span[i] = Expected(i);
+    }
+    stream.CommitWrite(100);
+
+    auto readable = stream.Readable();
+    REQUIRE(readable.size() == 100);
+    for (size_t i = 0; i < readable.size(); ++i) {
+        INFO("Checking " << i);
+        CHECK(readable[i] == Expected(i));
+    }
+}
+
+TEST_CASE("Threads") {
+    static constexpr uint64_t kTotal = 64 << 20;
+    auto stream = CreateStream(1 << 16);
+    auto seed = Catch::getSeed();
+
+    std::thread producer{[&stream, seed] {
+        Produce(stream, kTotal, 5000, seed);
+    }};
+    auto errors = Consume(stream, kTotal, 7000, seed + 1);
+    producer.join();
+    CHECK(errors == 0);
+}
+
+TEST_CASE("Processes") {
+    static constexpr uint64_t kTotal = 64 << 20;
+    auto result = SpscByteStream::CreateShared(1 << 16);
+    REQUIRE(result.index() == 0);
+    auto& writer = *std::get_if<SpscByteStream>(&result);
+    REQUIRE(writer.Fd() != -1);
+    auto seed = Catch::getSeed();
+
+    pid_t pid = fork();
+    REQUIRE(pid != -1);
+    if (pid == 0) {
+        // Checked in the child, since it must not return into Catch.
+        auto attached = SpscByteStream::Attach(writer.Fd());
+        if (attached.index() != 0) {
+            _exit(2);
+        }
+        auto& reader = *std::get_if<SpscByteStream>(&attached);
+        bool ok = reader.Capacity() == writer.Capacity() &&
+                  Consume(reader, kTotal, 7000, seed + 1) == 0;
+        _exit(ok ? 0 : 1);
+    }
+
+    Produce(writer, kTotal, 5000, seed);
+    int status;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+}
+
+TEST_CASE("AttachRejectsOtherFiles") {
+    int fd = memfd_create("not-a-stream", MFD_CLOEXEC);
+    REQUIRE(fd != -1);
+    REQUIRE(ftruncate(fd, 3 * kPageSize) == 0);
+    auto result = SpscByteStream::Attach(fd);
+    REQUIRE(result.index() == 1);
+    CHECK(*std::get_if<int>(&result) == EINVAL);
+    close(fd);
+}
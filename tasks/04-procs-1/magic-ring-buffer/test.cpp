@@ -1,4 +1,5 @@
 #include "buffer.hpp"
+#include "growable-buffer.hpp"
 
 #include <mm.hpp>
 #include <rlim-guard.hpp>
@@ -7,6 +8,7 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <array>
+#include <deque>
 #include <random>
 #include <sys/resource.h>
 #include <type_traits>
@@ -251,3 +253,120 @@ TEST_CASE("MemoryReleased") {
         CHECK(!IsValidPage(addr));
     }
 }
+
+template <class Buffer>
+Buffer CreateBasicBuffer(size_t capacity) {
+    auto result = Buffer::Create(capacity);
+    REQUIRE(result.index() == 0);
+    return std::move(*std::get_if<Buffer>(&result));
+}
+
+template <class Buffer, class T>
+void CheckContents(Buffer& buf, const std::deque<T>& model) {
+    auto data = buf.Data();
+    REQUIRE(data.size() == model.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        INFO("Checking " << i);
+        REQUIRE(data[i] == model[i]);
+    }
+}
+
+TEST_CASE("OtherTypes") {
+    RLimGuard g{RLIMIT_NOFILE, 0};
+
+    auto bytes = CreateBasicBuffer<BasicRingBuffer<uint8_t>>(10);
+    CHECK(bytes.Capacity() == kPageSize);
+    auto words = CreateBasicBuffer<BasicRingBuffer<uint16_t>>(2000);
+    CHECK(words.Capacity() == kPageSize / sizeof(uint16_t));
+
+    std::deque<uint16_t> model;
+    for (size_t i = 0; i < 3 * words.Capacity(); ++i) {
+        words.PushBack(static_cast<uint16_t>(i));
+        model.push_back(static_cast<uint16_t>(i));
+        if (model.size() == words.Capacity()) {
+            words.PopFront();
+            model.pop_front();
+        }
+    }
+    CheckContents(words, model);
+}
+
+TEST_CASE("GrowsWrapped") {
+    RLimGuard g{RLIMIT_NOFILE, 0};
+
+    using Growable = GrowableRingBuffer<RingBuffer::ElementType>;
+    auto buf = CreateBasicBuffer<Growable>(3 * kPageSize /
+                                           sizeof(RingBuffer::ElementType));
+    auto cap = buf.Capacity();
+    std::deque<RingBuffer::ElementType> model;
+
+    // The elements wrap around, and the last ones end in the page where
+    // the first one is.
+    for (size_t i = 0; i < cap + cap / 2 + 10; ++i) {
+        buf.PushBack(static_cast<RingBuffer::ElementType>(i));
+        model.push_back(static_cast<RingBuffer::ElementType>(i));
+        if (model.size() == cap) {
+            buf.PopFront();
+            model.pop_front();
+        }
+    }
+    CheckContents(buf, model);
+
+    REQUIRE(buf.Reserve(cap + 1) == 0);
+    CHECK(buf.Capacity() == cap + kPageSize / sizeof(RingBuffer::ElementType));
+    CheckContents(buf, model);
+
+    while (buf.Data().size() < buf.Capacity()) {
+        buf.PushBack(-1);
+        model.push_back(-1);
+    }
+    CheckContents(buf, model);
+    buf.PopFrontN(model.size());
+    CHECK(buf.Data().empty());
+}
+
+TEST_CASE("GrowsStress") {
+    RLimGuard g{RLIMIT_NOFILE, 0};
+
+    std::mt19937_64 rng{Catch::getSeed()};
+    using Growable = GrowableRingBuffer<RingBuffer::ElementType>;
+    auto buf = CreateBasicBuffer<Growable>(1);
+    std::deque<RingBuffer::ElementType> model;
+    std::vector<RingBuffer::ElementType> values;
+    RingBuffer::ElementType next = 0;
+
+    for (size_t i = 0; i < 2'000; ++i) {
+        INFO("Iteration " << i);
+        auto size = model.size();
+        switch (rng() % 4) {
+            case 0:
+            case 1:
+                values.resize(rng() % 1000);
+                for (auto& value : values) {
+                    value = next++;
+                    model.push_back(value);
+                }
+                REQUIRE(buf.PushBackN(values) == 0);
+                break;
+            case 2: {
+                auto count = size == 0 ? 0 : rng() % size;
+                buf.PopFrontN(count);
+                model.erase(model.begin(), model.begin() + count);
+                break;
+            }
+            default:
+                if (size != buf.Capacity() && (rng() & 1)) {
+                    buf.PushFront(next);
+                    model.push_front(next++);
+                } else if (size != 0) {
+                    buf.PopBack();
+                    model.pop_back();
+                }
+        }
+        REQUIRE(buf.Capacity() >= model.size());
+        if (rng() % 16 == 0) {
+            CheckContents(buf, model);
+        }
+    }
+    CheckContents(buf, model);
+}
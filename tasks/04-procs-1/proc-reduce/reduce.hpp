@@ -1,14 +1,533 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstddef>
 #include <cstdint>
-#include <numeric>
-#include <ranges>
-#include <unused.hpp>  // TODO: remove before flight.
+#include <ctime>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
 
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// What the pool knows about the machine. Negative values are not measured
+// yet.
+struct ReduceCosts {
+    double fork_ns = -1;        // Per forked worker.
+    double round_trip_ns = -1;  // Waking the workers and getting results.
+    size_t cpus = 0;            // Processes that can run at the same time.
+};
+
+namespace reduce_detail {
+
+inline constexpr size_t kCacheLine = 64;
+inline constexpr size_t kMaxWorkers = 256;
+inline constexpr size_t kRingSize = 4096;
+
+// The cost model. f is timed on a prefix of at least kSampleNs. The pool
+// is not even forked for work shorter than kCalibrateNs, so that measuring
+// fork can not cost much relative to the call. A chunk is at least kChunkNs
+// of work, which keeps claiming chunks cheap compared to reducing them.
+inline constexpr std::chrono::nanoseconds kSampleNs{50'000};
+inline constexpr uint64_t kSampleStep = 256;
+inline constexpr double kCalibrateNs = 2e6;
+inline constexpr double kChunkNs = 20e3;
+
+// How long the caller waits for results before it checks that no worker
+// has died with a task in hand.
+inline constexpr timespec kLivenessCheck = {.tv_sec = 0,
+                                            .tv_nsec = 20'000'000};
+
+// The words are shared between processes, so the futexes are not private.
+// Returns false if `timeout` passed.
+inline bool FutexWait(std::atomic<uint32_t>* word, uint32_t expected,
+                      const timespec* timeout = nullptr) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT,
+                   expected, timeout, nullptr, 0) != -1 ||
+           errno != ETIMEDOUT;
+}
+
+inline void FutexWake(std::atomic<uint32_t>* word, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, count,
+            nullptr, nullptr, 0);
+}
+
+// A range to reduce and the slot for its result, on a line of its own so
+// that workers writing neighbouring results do not share cache lines.
+// `done` is set with a release store once `result` is written, so tasks
+// lost with a dead worker can be told apart.
+struct alignas(kCacheLine) Task {
+    uint64_t from;
+    uint64_t to;
+    uint64_t result;
+    uint32_t done;
+};
+
+// Lives in a MAP_SHARED | MAP_ANONYMOUS mapping created before the workers
+// are forked.
+//
+// A job is published by writing the tasks and then storing
+// (count << 32 | 0) to `claim`. Workers take tasks with fetch_add on it and
+// stop at the first index >= count, so a worker that wakes up late can not
+// take a task twice or one of the next job: the index and the count it
+// compares come from the same atomic word.
+struct Shared {
+    alignas(kCacheLine) std::atomic<uint32_t> epoch{0};
+    std::atomic<bool> stop{false};
+    alignas(kCacheLine) std::atomic<uint64_t> claim{0};
+    alignas(kCacheLine) std::atomic<uint32_t> completed{0};
+    Task tasks[kRingSize];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+template <class F>
+uint64_t ReduceRange(const F& f, uint64_t init, uint64_t from, uint64_t to) {
+    for (auto i = from; i < to; ++i) {
+        init = f(init, i);
+    }
+    return init;
+}
+
+// f is associative, so a range can be folded starting from its first
+// element and then joined to the accumulator with one more call.
+template <class F>
+uint64_t ReduceTask(const F& f, const Task& task) {
+    return ReduceRange(f, task.from, task.from + 1, task.to);
+}
+
+inline size_t OnlineCpus() {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        return static_cast<size_t>(CPU_COUNT(&set));
+    }
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? static_cast<size_t>(count) : 1;
+}
+
+// The part of a call reduced by the caller while timing f.
+struct Prefix {
+    uint64_t end;
+    uint64_t acc;
+    double ns_per_element;
+};
+
+template <class F>
+Prefix ReducePrefix(const F& f, uint64_t init, uint64_t from, uint64_t to) {
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    std::chrono::nanoseconds elapsed{0};
+    uint64_t pos = from;
+    for (uint64_t step = kSampleStep; pos < to && elapsed < kSampleNs;
+         step *= 2) {
+        uint64_t end = pos + std::min(step, to - pos);
+        init = ReduceRange(f, init, pos, end);
+        pos = end;
+        elapsed = Clock::now() - start;
+    }
+    auto count = static_cast<double>(std::max<uint64_t>(pos - from, 1));
+    return {
+        .end = pos,
+        .acc = init,
+        .ns_per_element = static_cast<double>(elapsed.count()) / count,
+    };
+}
+
+// The costs measured by any pool of the process. Pools created for a
+// single call start from them, so only the first large call measures.
+struct KnownCosts {
+    static ReduceCosts Load() {
+        std::lock_guard guard{Mutex()};
+        return Costs();
+    }
+
+    static void Store(const ReduceCosts& costs) {
+        std::lock_guard guard{Mutex()};
+        Costs() = costs;
+    }
+
+    static std::mutex& Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static ReduceCosts& Costs() {
+        static ReduceCosts costs;
+        return costs;
+    }
+};
+
+}  // namespace reduce_detail
+
+// Processes that reduce ranges with one function `f` for every call of
+// Reduce, until the pool is destroyed, which waits for all of them.
+//
+// Workers are forked when first needed and call their inherited copy of f,
+// so they see the caller's memory as it was at that moment: neither f nor
+// anything it reads may change while the pool lives. A worker that dies
+// takes no results with it: the caller notices, stops the others and
+// reduces the unfinished tasks itself.
+template <class F>
+class ProcessPool {
+  public:
+    explicit ProcessPool(const F& f) : f_{&f} {
+    }
+
+    ProcessPool(const ProcessPool&) = delete;
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    ~ProcessPool() {
+        if (owner_ == getpid()) {
+            Stop();
+        }
+        if (shared_ != nullptr) {
+            munmap(shared_, sizeof(reduce_detail::Shared));
+        }
+    }
+
+    // Same result as folding [from, to) into `init` with f from left to
+    // right, using the calling process and at most `max_parallelism`
+    // workers.
+    //
+    // The caller starts folding on its own and times f on the prefix. The
+    // rest is shared only if the cost model says that pays off, taking the
+    // round trip and the forks still needed into account; otherwise, and
+    // if no worker can be forked, the caller finishes alone. Shared work
+    // is handed out in guided chunks, each a fraction of what is left, so
+    // the last chunks are small and uneven ones even out.
+    uint64_t Reduce(uint64_t from, uint64_t to, uint64_t init,
+                    size_t max_parallelism) {
+        const F& f = *f_;
+        auto prefix = reduce_detail::ReducePrefix(f, init, from, to);
+        if (prefix.end >= to) {
+            return prefix.acc;
+        }
+
+        std::lock_guard guard{mutex_};
+        ForgetIfForked();
+        size_t workers = Plan(
+            static_cast<double>(to - prefix.end) * prefix.ns_per_element,
+            std::min(max_parallelism, reduce_detail::kMaxWorkers));
+        if (workers == 0 || !Prepare(workers)) {
+            return reduce_detail::ReduceRange(f, prefix.acc, prefix.end, to);
+        }
+        workers = std::min(workers, workers_.size());
+
+        size_t count =
+            Split(prefix.end, to, prefix.ns_per_element, workers + 1);
+        if (!Run(true, count)) {
+            Abandon();
+        }
+
+        auto acc = prefix.acc;
+        for (size_t i = 0; i < count; ++i) {
+            auto& task = shared_->tasks[i];
+            if (std::atomic_ref{task.done}.load(std::memory_order_acquire) ==
+                0) {
+                task.result = reduce_detail::ReduceTask(f, task);
+            }
+            acc = f(acc, task.result);
+        }
+        return acc;
+    }
+
+    const ReduceCosts& Costs() const {
+        return costs_;
+    }
+
+    // Replaces the measured costs of this pool, for tests and experiments.
+    // Measurements made afterwards are not shared with other pools.
+    void SetCosts(const ReduceCosts& costs) {
+        std::lock_guard guard{mutex_};
+        costs_ = costs;
+        fixed_costs_ = true;
+    }
+
+  private:
+    // The pool may have been copied into a forked child of the process
+    // that created it. Its workers are not the child's, so it starts anew.
+    void ForgetIfForked() {
+        if (owner_ == getpid()) {
+            return;
+        }
+        if (shared_ != nullptr) {
+            munmap(shared_, sizeof(reduce_detail::Shared));
+            shared_ = nullptr;
+        }
+        workers_.clear();
+        owner_ = getpid();
+    }
+
+    // Number of workers to share `work_ns` of work with. Each of them,
+    // up to one less than the CPUs, divides the time left by one more
+    // process, and the ones that have to be forked add their fork cost.
+    // Without a spare CPU nothing is forked, not even to calibrate.
+    size_t Plan(double work_ns, size_t max_workers) {
+        if (costs_.cpus == 0) {
+            costs_.cpus = reduce_detail::OnlineCpus();
+        }
+        size_t limit =
+            std::min(max_workers, costs_.cpus > 1 ? costs_.cpus - 1 : 0);
+        if (limit == 0) {
+            return 0;
+        }
+        if (costs_.round_trip_ns < 0) {
+            if (work_ns < reduce_detail::kCalibrateNs || !Calibrate()) {
+                return 0;
+            }
+        }
+
+        size_t best = 0;
+        double best_ns = work_ns;
+        for (size_t workers = 1; workers <= limit; ++workers) {
+            size_t forks =
+                workers > workers_.size() ? workers - workers_.size() : 0;
+            double ns = work_ns / static_cast<double>(workers + 1) +
+                        costs_.round_trip_ns +
+                        static_cast<double>(forks) *
+                            std::max(costs_.fork_ns, 0.0);
+            if (ns < best_ns) {
+                best = workers;
+                best_ns = ns;
+            }
+        }
+        return best;
+    }
+
+    // Forks the first worker, timing it, and times a job that it does
+    // alone and that calls no f.
+    bool Calibrate() {
+        using Clock = std::chrono::steady_clock;
+
+        if (!Prepare(1)) {
+            costs_.round_trip_ns = std::numeric_limits<double>::infinity();
+            return false;
+        }
+        auto start = Clock::now();
+        shared_->tasks[0] =
+            reduce_detail::Task{.from = 0, .to = 1, .result = 0, .done = 0};
+        if (!Run(false, 1)) {
+            Abandon();
+            return false;
+        }
+        costs_.round_trip_ns = static_cast<double>(
+            std::chrono::nanoseconds{Clock::now() - start}.count());
+        Publish();
+        return true;
+    }
+
+    // Cuts [from, to) into guided chunks for `participants` processes.
+    // Returns their number.
+    size_t Split(uint64_t from, uint64_t to, double ns_per_element,
+                 size_t participants) {
+        using reduce_detail::kRingSize;
+
+        auto min_chunk = static_cast<uint64_t>(
+            reduce_detail::kChunkNs / std::max(ns_per_element, 1e-3));
+        min_chunk = std::max({min_chunk, (to - from) / (kRingSize / 2),
+                              uint64_t{1}});
+
+        size_t count = 0;
+        while (from < to) {
+            uint64_t left = to - from;
+            uint64_t chunk = std::max(min_chunk, left / (2 * participants));
+            if (chunk > left || count + 1 == kRingSize) {
+                chunk = left;
+            }
+            shared_->tasks[count++] = reduce_detail::Task{
+                .from = from,
+                .to = from + chunk,
+                .result = 0,
+                .done = 0,
+            };
+            from += chunk;
+        }
+        return count;
+    }
+
+    bool Prepare(size_t workers) {
+        if (shared_ == nullptr) {
+            void* memory = mmap(nullptr, sizeof(reduce_detail::Shared),
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                return false;
+            }
+            shared_ = new (memory) reduce_detail::Shared;
+        }
+        // Read before fork: the first job may be posted before the child
+        // gets to run, and it must not mistake that job for an old one.
+        auto epoch = shared_->epoch.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        size_t forked = 0;
+        while (workers_.size() < workers) {
+            pid_t pid = fork();
+            if (pid == -1) {
+                break;
+            }
+            if (pid == 0) {
+                WorkerMain(epoch);
+            }
+            workers_.push_back(pid);
+            ++forked;
+        }
+        if (forked != 0) {
+            std::chrono::nanoseconds elapsed =
+                std::chrono::steady_clock::now() - start;
+            costs_.fork_ns = static_cast<double>(elapsed.count()) /
+                             static_cast<double>(forked);
+            Publish();
+        }
+        return !workers_.empty();
+    }
+
+    void Publish() {
+        if (!fixed_costs_) {
+            reduce_detail::KnownCosts::Store(costs_);
+        }
+    }
+
+    // Publishes `count` tasks and waits for them, taking chunks too if
+    // `help` is set. Returns false if some worker died before all of them
+    // were done; its tasks may never be.
+    bool Run(bool help, size_t count) {
+        shared_->completed.store(0, std::memory_order_relaxed);
+        shared_->claim.store(uint64_t{count} << 32, std::memory_order_release);
+        shared_->epoch.fetch_add(1, std::memory_order_release);
+        reduce_detail::FutexWake(&shared_->epoch, INT_MAX);
+
+        if (help) {
+            Drain();
+        }
+        while (true) {
+            auto done = shared_->completed.load(std::memory_order_acquire);
+            if (done == count) {
+                return true;
+            }
+            if (!reduce_detail::FutexWait(&shared_->completed, done,
+                                          &reduce_detail::kLivenessCheck) &&
+                SomeWorkerDied()) {
+                return false;
+            }
+        }
+    }
+
+    // A worker that has exited, or that someone else has reaped, counts as
+    // dead. WNOWAIT leaves it to be reaped later.
+    bool SomeWorkerDied() const {
+        for (pid_t pid : workers_) {
+            siginfo_t info = {};
+            if (waitid(P_PID, static_cast<id_t>(pid), &info,
+                       WEXITED | WNOHANG | WNOWAIT) == -1) {
+                if (errno != EINTR) {
+                    return true;
+                }
+            } else if (info.si_pid != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Kills and reaps all workers after one of them died. Tasks they did
+    // not finish stay not done; later calls fork new workers.
+    void Abandon() {
+        for (pid_t pid : workers_) {
+            kill(pid, SIGKILL);
+        }
+        for (pid_t pid : workers_) {
+            while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) {
+            }
+        }
+        workers_.clear();
+    }
+
+    [[noreturn]] void WorkerMain(uint32_t seen) {
+        // Workers must not outlive the pool's process, however it ends.
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != owner_) {
+            _exit(0);
+        }
+
+        while (true) {
+            auto epoch = shared_->epoch.load(std::memory_order_acquire);
+            if (epoch == seen) {
+                reduce_detail::FutexWait(&shared_->epoch, seen);
+                continue;
+            }
+            seen = epoch;
+            if (shared_->stop.load(std::memory_order_acquire)) {
+                _exit(0);
+            }
+            Drain();
+        }
+    }
+
+    void Drain() {
+        while (true) {
+            auto word = shared_->claim.fetch_add(1, std::memory_order_acq_rel);
+            auto index = static_cast<uint32_t>(word);
+            auto count = static_cast<uint32_t>(word >> 32);
+            if (index >= count) {
+                return;
+            }
+
+            auto& task = shared_->tasks[index];
+            task.result = reduce_detail::ReduceTask(*f_, task);
+            std::atomic_ref{task.done}.store(1, std::memory_order_release);
+
+            auto done =
+                shared_->completed.fetch_add(1, std::memory_order_acq_rel);
+            if (done + 1 == count) {
+                reduce_detail::FutexWake(&shared_->completed, 1);
+            }
+        }
+    }
+
+    void Stop() {
+        if (shared_ == nullptr) {
+            return;
+        }
+        shared_->stop.store(true, std::memory_order_release);
+        shared_->epoch.fetch_add(1, std::memory_order_release);
+        reduce_detail::FutexWake(&shared_->epoch, INT_MAX);
+        for (pid_t pid : workers_) {
+            while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) {
+            }
+        }
+        workers_.clear();
+    }
+
+    const F* f_;
+    reduce_detail::Shared* shared_ = nullptr;
+    pid_t owner_ = getpid();
+    std::vector<pid_t> workers_;
+    ReduceCosts costs_ = reduce_detail::KnownCosts::Load();
+    bool fixed_costs_ = false;
+    std::mutex mutex_;
+};
+
+// Every call forks its own workers, if any pay off, and waits for them
+// before returning, so f may read anything the caller changes between
+// calls. What the cost model measures is kept for the next calls.
 template <class F>
 uint64_t Reduce(uint64_t from, uint64_t to, uint64_t init, F&& f,
                 size_t max_parallelism) {
-    UNUSED(max_parallelism);  // TODO: remove before flight.
-    auto r = std::views::iota(from, to);  // TODO: remove before flight.
-    return std::reduce(r.begin(), r.end(), init, f);  // TODO: remove before flight.
+    ProcessPool<std::remove_cvref_t<F>> pool{f};
+    return pool.Reduce(from, to, init, max_parallelism);
 }
@@ -9,9 +9,15 @@
 #include <catch2/catch_get_random_seed.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <cerrno>
+#include <csignal>
 #include <cstdint>
 #include <numeric>
 #include <ranges>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 template <class F>
 uint64_t CorrectReduce(uint64_t from, uint64_t to, uint64_t init, F&& f) {
@@ -127,3 +133,166 @@ TEST_CASE("NonCommutative") {
 
     CHECK(guard.TestDescriptorsState());
 }
+
+// Costs that make every call share the work with as many workers as it
+// is allowed, whatever the machine.
+constexpr ReduceCosts kFreeWorkers = {
+    .fork_ns = 0,
+    .round_trip_ns = 0,
+    .cpus = 1024,
+};
+
+TEST_CASE("PoolReuse") {
+    FileDescriptorsGuard guard;
+
+    // Not trivially copyable, served by the same workers for every call.
+    std::vector<uint64_t> masks = {1, 3, 5};
+    auto op = [masks](uint64_t lhs, uint64_t rhs) {
+        return (lhs | masks[0]) * (rhs | masks[0]);
+    };
+    ProcessPool<decltype(op)> pool{op};
+    pool.SetCosts(kFreeWorkers);
+    for (uint64_t seed = 0; seed < 20; ++seed) {
+        auto to = 3'000'000 + seed * 1000;
+        CHECK(pool.Reduce(seed, to, seed, seed % 6) ==
+              CorrectReduce(seed, to, seed, op));
+    }
+
+    // A forked child can not use the parent's workers.
+    pid_t pid = fork();
+    REQUIRE(pid != -1);
+    if (pid == 0) {
+        bool same = pool.Reduce(0, 3'000'000, 1, 2) ==
+                    CorrectReduce(0, 3'000'000, 1, op);
+        _exit(same ? 0 : 1);
+    }
+    int status;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+
+    CHECK(guard.TestDescriptorsState());
+}
+
+// Makes every call of Reduce share its work with workers while it lives.
+struct FreeWorkersForReduce {
+    FreeWorkersForReduce() {
+        reduce_detail::KnownCosts::Store(kFreeWorkers);
+    }
+
+    ~FreeWorkersForReduce() {
+        reduce_detail::KnownCosts::Store(saved);
+    }
+
+    ReduceCosts saved = reduce_detail::KnownCosts::Load();
+};
+
+TEST_CASE("CaptureByReference") {
+    FileDescriptorsGuard guard;
+    FreeWorkersForReduce free_workers;
+
+    // Trivially copyable, but reads a variable that changes between calls,
+    // which workers forked for an earlier call would not see.
+    uint64_t add = 1;
+    auto op = [&add](uint64_t lhs, uint64_t rhs) { return lhs + rhs + add; };
+    for (add = 1; add <= 4; ++add) {
+        CHECK(Reduce(0, 5'000'000, 0, op, 4) ==
+              CorrectReduce(0, 5'000'000, 0, op));
+    }
+
+    // Every call waits for its workers, so there is nothing left to reap.
+    CHECK(waitpid(-1, nullptr, WNOHANG) == -1);
+    CHECK(errno == ECHILD);
+
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("DeadWorker") {
+    FileDescriptorsGuard guard;
+
+    // Workers die on their first element, with their tasks unfinished. The
+    // caller sleeps now and then, so that they get to claim some even on a
+    // single CPU.
+    pid_t caller = getpid();
+    auto op = [caller](uint64_t lhs, uint64_t rhs) {
+        if (getpid() != caller) {
+            raise(SIGKILL);
+        } else if (rhs % 200'000 == 0) {
+            usleep(1000);
+        }
+        return (lhs | 1) * (rhs | 1);
+    };
+    {
+        ProcessPool<decltype(op)> pool{op};
+        pool.SetCosts(kFreeWorkers);
+        for (int i = 0; i < 2; ++i) {
+            CHECK(pool.Reduce(0, 3'000'000, 1, 4) ==
+                  CorrectReduce(0, 3'000'000, 1, op));
+        }
+    }
+    {
+        FreeWorkersForReduce free_workers;
+        CHECK(Reduce(0, 3'000'000, 1, op, 4) ==
+              CorrectReduce(0, 3'000'000, 1, op));
+    }
+    CHECK(waitpid(-1, nullptr, WNOHANG) == -1);
+
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("Skewed") {
+    FileDescriptorsGuard guard;
+
+    // Elements differ in cost, and the last tenth of every million is much
+    // more expensive than the rest.
+    auto op = [](uint64_t lhs, uint64_t rhs) {
+        auto rounds = rhs % 1'000'000 < 900'000 ? rhs % 8 : 64;
+        auto busy = rhs;
+        for (uint64_t i = 0; i < rounds; ++i) {
+            busy = (busy | 1) * 0x9e3779b97f4a7c15;
+        }
+        DoNotOptimize(busy);
+        return (lhs | 1) * (rhs | 1);
+    };
+
+    ProcessPool<decltype(op)> pool{op};
+    pool.SetCosts(kFreeWorkers);
+    CHECK(pool.Reduce(0, 2'000'000, 5, 4) ==
+          CorrectReduce(0, 2'000'000, 5, op));
+
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("SmallRanges") {
+    if constexpr (kBuildType != BuildType::Release) {
+        return;
+    }
+
+    // Calls too short to share must cost about as much as the plain loop.
+    auto op = Conjugate(OrMul, Catch::getSeed());
+    auto run = [op](auto reduce) {
+        uint64_t acc = 1;
+        for (uint64_t from = 0; from < 2'000'000; from += 1000) {
+            acc = reduce(from, from + 1000, acc);
+        }
+        return acc;
+    };
+    auto par_reduce = RunWithWarmup(
+        [&] {
+            return run([op](uint64_t from, uint64_t to, uint64_t init) {
+                return Reduce(from, to, init, op, 4);
+            });
+        },
+        1, 5);
+    auto seq_reduce = RunWithWarmup(
+        [&] {
+            return run([op](uint64_t from, uint64_t to, uint64_t init) {
+                return CorrectReduce(from, to, init, op);
+            });
+        },
+        1, 5);
+
+    auto ratio = double(par_reduce.wall_time.count()) /
+                 double(seq_reduce.wall_time.count());
+    CHECK(ratio < 1.5);
+}
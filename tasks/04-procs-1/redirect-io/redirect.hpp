@@ -0,0 +1,208 @@
+#pragma once
+
+#include <defer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// `argv < input > output`. The first argument is looked up in PATH like
+// execlp does.
+struct Redirection {
+    std::vector<std::string> argv;
+    std::string input;
+    std::string output;
+};
+
+struct RedirectionResult {
+    // The error of posix_spawnp, which includes failing to open `input` or
+    // `output`. `status` is only meaningful when it is zero.
+    int spawn_error = 0;
+    int status = 0;
+};
+
+namespace redirect_detail {
+
+// The output is created with mode 0666, reduced by the umask as open
+// does, and an existing file keeps its mode.
+inline constexpr int kOutputFlags = O_WRONLY | O_CREAT | O_TRUNC;
+inline constexpr mode_t kOutputMode = 0666;
+
+// Both files are opened by the child right before exec, straight into
+// descriptors 0 and 1, so the parent opens nothing and nothing leaks. The
+// child shares the parent's memory until exec (glibc spawns it with
+// CLONE_VM | CLONE_VFORK), so no page tables are copied.
+inline int Spawn(const Redirection& job, pid_t* pid) {
+    if (job.argv.empty()) {
+        return EINVAL;
+    }
+    std::vector<char*> argv;
+    argv.reserve(job.argv.size() + 1);
+    for (const auto& arg : job.argv) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    if (int err = posix_spawn_file_actions_init(&actions); err != 0) {
+        return err;
+    }
+    DEFER {
+        posix_spawn_file_actions_destroy(&actions);
+    };
+    int err = posix_spawn_file_actions_addopen(
+        &actions, STDIN_FILENO, job.input.c_str(), O_RDONLY, 0);
+    if (err == 0) {
+        err = posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO,
+                                               job.output.c_str(),
+                                               kOutputFlags, kOutputMode);
+    }
+    pid_t child;
+    if (err == 0) {
+        err = posix_spawnp(&child, argv[0], &actions, nullptr, argv.data(),
+                           environ);
+    }
+    if (err == 0) {
+        *pid = child;
+    }
+    return err;
+}
+
+// The wrapper from <sys/pidfd.h> lacks C linkage in some glibc versions.
+inline int PidfdOpen(pid_t pid) {
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+inline int Wait(pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    return status;
+}
+
+// Reaps the child behind `pidfd`, which must have exited, and returns its
+// status in the format of waitpid.
+inline int Reap(int pidfd) {
+    siginfo_t info = {};
+    while (waitid(P_PIDFD, pidfd, &info, WEXITED) == -1 && errno == EINTR) {
+    }
+    close(pidfd);
+    if (info.si_code == CLD_EXITED) {
+        return W_EXITCODE(info.si_status, 0);
+    }
+    return W_EXITCODE(0, info.si_status) |
+           (info.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+}
+
+}  // namespace redirect_detail
+
+// Runs every job with at most `concurrency` of them at a time, starting
+// the next one as soon as any running one exits. Children are watched
+// through pidfds, so children of the caller started elsewhere are never
+// reaped here. Without pidfd support jobs run one by one.
+inline std::vector<RedirectionResult> RunRedirections(
+    std::span<const Redirection> jobs, size_t concurrency) {
+    using namespace redirect_detail;
+    concurrency = std::max<size_t>(concurrency, 1);
+    std::vector<RedirectionResult> results(jobs.size());
+    std::vector<pollfd> running;
+    std::vector<size_t> running_jobs;
+    running.reserve(concurrency);
+    running_jobs.reserve(concurrency);
+
+    size_t next = 0;
+    while (next < jobs.size() || !running.empty()) {
+        while (next < jobs.size() && running.size() < concurrency) {
+            size_t index = next++;
+            pid_t pid;
+            results[index].spawn_error = Spawn(jobs[index], &pid);
+            if (results[index].spawn_error != 0) {
+                continue;
+            }
+            int pidfd = PidfdOpen(pid);
+            if (pidfd == -1) {
+                results[index].status = Wait(pid);
+                continue;
+            }
+            running.push_back({.fd = pidfd, .events = POLLIN, .revents = 0});
+            running_jobs.push_back(index);
+        }
+        if (running.empty()) {
+            continue;
+        }
+
+        if (poll(running.data(), running.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Waiting for one job still works, Reap blocks until it exits.
+            running[0].revents = POLLIN;
+        }
+        // Removes the finished jobs by swapping in the last running ones.
+        for (size_t i = running.size(); i-- > 0;) {
+            if (running[i].revents == 0) {
+                continue;
+            }
+            results[running_jobs[i]].status = Reap(running[i].fd);
+            running[i] = running.back();
+            running.pop_back();
+            running_jobs[i] = running_jobs.back();
+            running_jobs.pop_back();
+        }
+    }
+    return results;
+}
+
+// Reads jobs from a manifest with one job per line: the command with its
+// arguments, then the input and the output file, separated by blanks.
+// Empty lines and lines starting with '#' are skipped. Returns the jobs,
+// or an errno if the file cannot be read; a line with fewer than three
+// words is EINVAL.
+inline std::variant<std::vector<Redirection>, int> ReadManifest(
+    const std::string& path) {
+    errno = 0;
+    std::ifstream manifest{path};
+    if (!manifest) {
+        return errno != 0 ? errno : ENOENT;
+    }
+    std::vector<Redirection> jobs;
+    std::string line;
+    while (std::getline(manifest, line)) {
+        std::istringstream words{line};
+        std::vector<std::string> argv;
+        std::string word;
+        while (words >> word) {
+            argv.push_back(std::move(word));
+        }
+        if (argv.empty() || argv[0].starts_with('#')) {
+            continue;
+        }
+        if (argv.size() < 3) {
+            return EINVAL;
+        }
+        Redirection job;
+        job.output = std::move(argv.back());
+        argv.pop_back();
+        job.input = std::move(argv.back());
+        argv.pop_back();
+        job.argv = std::move(argv);
+        jobs.push_back(std::move(job));
+    }
+    if (manifest.bad()) {
+        return EIO;
+    }
+    return jobs;
+}
@@ -1,5 +1,61 @@
-#include <unused.hpp>  // TODO: remove before flight.
+#include "redirect.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+
+void Report(const Redirection& job, const RedirectionResult& result) {
+    if (result.spawn_error != 0) {
+        std::fprintf(stderr, "%s: %s\n", job.argv[0].c_str(),
+                     std::strerror(result.spawn_error));
+    }
+}
+
+// --batch MANIFEST [JOBS]: runs every job of the manifest, JOBS at a time
+// (the number of CPUs by default). Fails if any job did not start or did
+// not exit with 0.
+int RunBatch(const char* path, const char* concurrency) {
+    auto manifest = ReadManifest(path);
+    if (auto* err = std::get_if<int>(&manifest)) {
+        std::fprintf(stderr, "%s: %s\n", path, std::strerror(*err));
+        return 1;
+    }
+    const auto& jobs = std::get<0>(manifest);
+    long jobs_at_once = concurrency != nullptr
+                            ? std::atol(concurrency)
+                            : sysconf(_SC_NPROCESSORS_ONLN);
+    auto results = RunRedirections(jobs, std::max(jobs_at_once, 1L));
+
+    int failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Report(jobs[i], results[i]);
+        if (results[i].spawn_error != 0 || results[i].status != 0) {
+            ++failed;
+        }
+    }
+    if (failed != 0) {
+        std::fprintf(stderr, "%d of %zu jobs failed\n", failed, jobs.size());
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+}  // namespace
 
 int main(int argc, char** argv) {
-    UNUSED(argc, argv);  // TODO: remove before flight.
+    if (argc >= 3 && argc <= 4 && std::strcmp(argv[1], "--batch") == 0) {
+        return RunBatch(argv[2], argc == 4 ? argv[3] : nullptr);
+    }
+    if (argc != 4) {
+        std::fprintf(stderr,
+                     "Usage: %s CMD FILE1 FILE2\n"
+                     "       %s --batch MANIFEST [JOBS]\n",
+                     argv[0], argv[0]);
+        return 0;
+    }
+    Redirection job = {.argv = {argv[1]}, .input = argv[2], .output = argv[3]};
+    Report(job, RunRedirections({&job, 1}, 1)[0]);
 }
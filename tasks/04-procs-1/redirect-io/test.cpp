@@ -0,0 +1,186 @@
+#include "redirect.hpp"
+
+#include <fd-guard.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <sys/stat.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// A fresh directory, removed with everything in it at the end.
+struct TempDir {
+    TempDir() {
+        std::string pattern =
+            (fs::temp_directory_path() / "redirect-io-XXXXXX").string();
+        REQUIRE(mkdtemp(pattern.data()) != nullptr);
+        path = pattern;
+    }
+
+    ~TempDir() {
+        fs::remove_all(path);
+    }
+
+    std::string operator/(const std::string& name) const {
+        return (path / name).string();
+    }
+
+    fs::path path;
+};
+
+void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream{path} << contents;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file{path};
+    return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+mode_t ModeOf(const std::string& path) {
+    struct stat st;
+    REQUIRE(stat(path.c_str(), &st) == 0);
+    return st.st_mode & 0777;
+}
+
+mode_t CurrentUmask() {
+    mode_t mask = umask(0);
+    umask(mask);
+    return mask;
+}
+
+}  // namespace
+
+TEST_CASE("JustWorks") {
+    TempDir dir;
+    WriteFile(dir / "in", "b\na\nc\n");
+    FileDescriptorsGuard guard;
+
+    std::vector<Redirection> jobs = {{{"sort"}, dir / "in", dir / "out"}};
+    auto results = RunRedirections(jobs, 1);
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].spawn_error == 0);
+    CHECK(results[0].status == 0);
+    CHECK(ReadFile(dir / "out") == "a\nb\nc\n");
+    CHECK(ModeOf(dir / "out") == (0666 & ~CurrentUmask()));
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("ExistingOutput") {
+    TempDir dir;
+    WriteFile(dir / "in", "new\n");
+    WriteFile(dir / "out", "old contents, longer than the new ones\n");
+    REQUIRE(chmod((dir / "out").c_str(), 0640) == 0);
+
+    std::vector<Redirection> jobs = {{{"cat"}, dir / "in", dir / "out"}};
+    auto results = RunRedirections(jobs, 1);
+    CHECK(results[0].status == 0);
+    CHECK(ReadFile(dir / "out") == "new\n");
+    CHECK(ModeOf(dir / "out") == 0640);
+}
+
+TEST_CASE("Failures") {
+    TempDir dir;
+    WriteFile(dir / "in", "");
+    FileDescriptorsGuard guard;
+
+    std::vector<Redirection> jobs = {
+        {{"cat"}, dir / "missing", dir / "out1"},
+        {{"no-such-command-in-path"}, dir / "in", dir / "out2"},
+        {{"sh", "-c", "exit 7"}, dir / "in", dir / "out3"},
+        {{"sh", "-c", "kill -KILL $$"}, dir / "in", dir / "out4"},
+        {{}, dir / "in", dir / "out5"},
+    };
+    auto results = RunRedirections(jobs, 2);
+    CHECK(results[0].spawn_error == ENOENT);
+    // Like in a shell, the output is not created if the input is missing.
+    CHECK(!fs::exists(dir / "out1"));
+    CHECK(results[1].spawn_error == ENOENT);
+    CHECK(results[2].spawn_error == 0);
+    REQUIRE(WIFEXITED(results[2].status));
+    CHECK(WEXITSTATUS(results[2].status) == 7);
+    REQUIRE(WIFSIGNALED(results[3].status));
+    CHECK(WTERMSIG(results[3].status) == SIGKILL);
+    CHECK(results[4].spawn_error == EINVAL);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("BoundedConcurrency") {
+    TempDir dir;
+    WriteFile(dir / "in", "");
+
+    // Each job records how many jobs are running when it starts.
+    std::string script =
+        "ls " + (dir / "") + " | grep -c '^running' ; "
+        "touch " + (dir / "running-$$") + " ; sleep 0.1 ; "
+        "rm " + (dir / "running-$$");
+    std::vector<Redirection> jobs;
+    for (int i = 0; i < 12; ++i) {
+        jobs.push_back({{"sh", "-c", script}, dir / "in",
+                        dir / ("out" + std::to_string(i))});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = RunRedirections(jobs, 3);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    for (int i = 0; i < 12; ++i) {
+        INFO("Job " << i);
+        CHECK(results[i].status == 0);
+        CHECK(std::stoi(ReadFile(dir / ("out" + std::to_string(i)))) < 3);
+    }
+    // Four rounds of three jobs.
+    CHECK(elapsed.count() >= 0.4);
+    CHECK(elapsed.count() < 1.2);
+}
+
+TEST_CASE("Manifest") {
+    TempDir dir;
+    WriteFile(dir / "manifest",
+              "# command input output\n"
+              "cat a b\n"
+              "\n"
+              "   sort -r  -u in out  \n");
+    auto manifest = ReadManifest(dir / "manifest");
+    REQUIRE(manifest.index() == 0);
+    const auto& jobs = std::get<0>(manifest);
+    REQUIRE(jobs.size() == 2);
+    CHECK(jobs[0].argv == std::vector<std::string>{"cat"});
+    CHECK(jobs[0].input == "a");
+    CHECK(jobs[0].output == "b");
+    CHECK(jobs[1].argv == std::vector<std::string>{"sort", "-r", "-u"});
+    CHECK(jobs[1].input == "in");
+    CHECK(jobs[1].output == "out");
+
+    WriteFile(dir / "bad", "cat a b\ncat a\n");
+    CHECK(std::get<int>(ReadManifest(dir / "bad")) == EINVAL);
+    CHECK(std::get<int>(ReadManifest(dir / "missing")) == ENOENT);
+}
+
+TEST_CASE("ManyJobs") {
+    TempDir dir;
+    WriteFile(dir / "in", "data\n");
+    FileDescriptorsGuard guard;
+
+    std::vector<Redirection> jobs;
+    for (int i = 0; i < 500; ++i) {
+        jobs.push_back({{"cat"}, dir / "in", dir / std::to_string(i)});
+    }
+    auto results = RunRedirections(jobs, 8);
+    for (int i = 0; i < 500; ++i) {
+        REQUIRE(results[i].spawn_error == 0);
+        REQUIRE(results[i].status == 0);
+        REQUIRE(ReadFile(dir / std::to_string(i)) == "data\n");
+    }
+    CHECK(guard.TestDescriptorsState());
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <defer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+// One consumer of a fan-out: a pipeline reading its own copy of the stream.
+struct FanOutBranch {
+    std::vector<PipelineStage> stages;
+    int output = STDOUT_FILENO;
+};
+
+struct BranchResult {
+    std::vector<StageResult> stages;
+    // Bytes handed to the branch, and the time from the start of the
+    // fan-out until the last of them was, so bytes / seconds is the rate
+    // the branch consumed at.
+    uint64_t bytes = 0;
+    double seconds = 0;
+    // The error that stopped the copying early, EPIPE if the branch exited
+    // before reading everything.
+    int error = 0;
+};
+
+struct FanOutResult {
+    std::vector<StageResult> source;
+    std::vector<BranchResult> branches;
+};
+
+namespace pipeline_detail {
+
+inline constexpr size_t kLinkChunk = 1 << 20;
+
+// Copies of the stream are made by a chain of links. Link i duplicates its
+// input pipe into `branch` with tee, which only references the pipe's
+// pages, and then moves the same bytes on to `next` with splice: to the
+// input of the following link, or to the last branch. Each link runs on
+// its own thread, so a slow branch only stalls the chain once the pipes
+// between them are full.
+//
+// A descriptor equal to the sink (/dev/null) stands for a closed one.
+struct Link {
+    int from;
+    int branch;
+    int next;
+    BranchResult* branch_result;
+    BranchResult* next_result;  // Null if `next` is not a branch.
+};
+
+using Clock = std::chrono::steady_clock;
+
+inline void RunLink(Link link, int sink, Clock::time_point start) {
+    // Writing to a pipe whose reader exited raises SIGPIPE in this thread.
+    // Blocked, it stays pending and is dropped with the thread, and the
+    // call returns EPIPE instead.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto finish = [&](int& fd, BranchResult* result, int err) {
+        if (fd == sink) {
+            return;
+        }
+        close(std::exchange(fd, sink));
+        if (result != nullptr) {
+            result->seconds =
+                std::chrono::duration<double>(Clock::now() - start).count();
+            result->error = err;
+        }
+    };
+    // Moves up to `size` bytes to `next`, or to the sink once it is gone.
+    // Returns the number of bytes moved, 0 at the end of the stream.
+    auto move = [&](size_t size) -> ssize_t {
+        while (true) {
+            ssize_t moved = splice(link.from, nullptr, link.next, nullptr,
+                                   size, SPLICE_F_MOVE);
+            if (moved == -1 && errno == EPIPE) {
+                finish(link.next, link.next_result, EPIPE);
+            } else if (moved != -1 || errno != EINTR) {
+                if (moved > 0 && link.next != sink &&
+                    link.next_result != nullptr) {
+                    link.next_result->bytes += moved;
+                }
+                return moved;
+            }
+        }
+    };
+
+    int err = 0;
+    while (err == 0 && (link.branch != sink || link.next != sink)) {
+        if (link.branch == sink) {
+            ssize_t moved = move(kLinkChunk);
+            if (moved == 0) {
+                break;
+            }
+            err = moved == -1 ? errno : 0;
+            continue;
+        }
+
+        ssize_t copied = tee(link.from, link.branch, kLinkChunk, 0);
+        if (copied == 0) {
+            break;
+        }
+        if (copied == -1 && errno == EPIPE) {
+            finish(link.branch, link.branch_result, EPIPE);
+        } else if (copied == -1 && errno != EINTR) {
+            err = errno;
+        }
+        link.branch_result->bytes += std::max<ssize_t>(copied, 0);
+        // The bytes given to the branch must leave `from` before the next
+        // tee, which starts at the head of the pipe again.
+        while (err == 0 && copied > 0) {
+            ssize_t moved = move(copied);
+            err = moved == -1 ? errno : (moved == 0 ? EIO : 0);
+            copied -= moved;
+        }
+    }
+
+    close(link.from);
+    finish(link.branch, link.branch_result, err);
+    finish(link.next, link.next_result, err);
+}
+
+}  // namespace pipeline_detail
+
+// Runs `source` and copies its output to every branch, like
+// `source | tee >(branch1) >(branch2) ...` without the tee process: the
+// copies share the pages of the pipe and are never read into memory.
+// options.input is the input of the source, options.output is not used,
+// and options.pipe_size applies to every pipe, bounding how far the
+// fastest branch can run ahead of the slowest one.
+//
+// A branch that exits early stops getting data and reports EPIPE; the
+// others go on. Once every branch is gone, the source gets SIGPIPE.
+// Returns an error only if the pipes could not be set up; everything
+// started by then is waited for.
+inline std::variant<FanOutResult, int> RunFanOut(
+    std::span<const PipelineStage> source,
+    std::span<const FanOutBranch> branches,
+    const PipelineOptions& options = {}) {
+    using namespace pipeline_detail;
+    auto no_stages = [](const FanOutBranch& branch) {
+        return branch.stages.empty();
+    };
+    if (source.empty() || branches.empty() ||
+        std::ranges::any_of(branches, no_stages)) {
+        return EINVAL;
+    }
+
+    FanOutResult result;
+    result.branches.resize(branches.size());
+    // Every descriptor opened here until the links take them over.
+    std::vector<int> fds;
+    auto close_fd = [&fds](int fd) {
+        close(fd);
+        std::erase(fds, fd);
+    };
+    auto fail = [&](int err) -> std::variant<FanOutResult, int> {
+        std::ranges::for_each(fds, close);
+        WaitPipeline(result.source);
+        for (auto& branch : result.branches) {
+            WaitPipeline(branch.stages);
+        }
+        return err;
+    };
+    auto make_pipe = [&](int (&ends)[2]) {
+        if (pipe2(ends, O_CLOEXEC) == -1) {
+            return false;
+        }
+        if (options.pipe_size != 0) {
+            GrowPipe(ends[1], options.pipe_size);
+        }
+        fds.insert(fds.end(), ends, ends + 2);
+        return true;
+    };
+    auto spawn = [&](std::span<const PipelineStage> stages, int input,
+                     int output, std::vector<StageResult>* results) {
+        PipelineOptions stage_options = options;
+        stage_options.input = input;
+        stage_options.output = output;
+        auto spawned = SpawnPipeline(stages, stage_options);
+        if (auto* err = std::get_if<int>(&spawned)) {
+            return *err;
+        }
+        *results = std::get<0>(std::move(spawned));
+        return 0;
+    };
+
+    int sink = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (sink == -1) {
+        return errno;
+    }
+    DEFER {
+        close(sink);
+    };
+
+    int source_pipe[2];
+    if (!make_pipe(source_pipe)) {
+        return fail(errno);
+    }
+    int err = spawn(source, options.input, source_pipe[1], &result.source);
+    close_fd(source_pipe[1]);
+    if (err != 0) {
+        return fail(err);
+    }
+
+    std::vector<int> inputs(branches.size());
+    for (size_t i = 0; i < branches.size(); ++i) {
+        int branch_pipe[2];
+        if (!make_pipe(branch_pipe)) {
+            return fail(errno);
+        }
+        inputs[i] = branch_pipe[1];
+        err = spawn(branches[i].stages, branch_pipe[0], branches[i].output,
+                    &result.branches[i].stages);
+        close_fd(branch_pipe[0]);
+        if (err != 0) {
+            return fail(err);
+        }
+    }
+
+    std::vector<Link> links;
+    if (branches.size() == 1) {
+        links.push_back({
+            .from = source_pipe[0],
+            .branch = sink,
+            .next = inputs[0],
+            .branch_result = nullptr,
+            .next_result = &result.branches[0],
+        });
+    }
+    int from = source_pipe[0];
+    for (size_t i = 0; i + 1 < branches.size(); ++i) {
+        int next_pipe[2] = {-1, inputs[i + 1]};
+        bool last = i + 2 == branches.size();
+        if (!last && !make_pipe(next_pipe)) {
+            return fail(errno);
+        }
+        links.push_back({
+            .from = from,
+            .branch = inputs[i],
+            .next = next_pipe[1],
+            .branch_result = &result.branches[i],
+            .next_result = last ? &result.branches[i + 1] : nullptr,
+        });
+        from = next_pipe[0];
+    }
+    fds.clear();
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(links.size());
+    for (const auto& link : links) {
+        threads.emplace_back(RunLink, link, sink, start);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    err = WaitPipeline(result.source);
+    for (auto& branch : result.branches) {
+        if (int branch_err = WaitPipeline(branch.stages); err == 0) {
+            err = branch_err;
+        }
+    }
+    if (err != 0) {
+        return err;
+    }
+    return result;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <defer.hpp>
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Arguments of one stage, the first one is looked up in PATH like execlp
+// does.
+using PipelineStage = std::vector<std::string>;
+
+struct PipelineOptions {
+    // Standard input of the first stage and standard output of the last.
+    int input = STDIN_FILENO;
+    int output = STDOUT_FILENO;
+    // Capacity of the pipes between stages in bytes, 0 keeps the default.
+    // Sizes above /proc/sys/fs/pipe-max-size are ignored.
+    size_t pipe_size = 0;
+};
+
+struct StageResult {
+    pid_t pid = -1;
+    // The error of posix_spawnp if the stage did not start. `status` and
+    // `usage` are only meaningful when it is zero.
+    int spawn_error = 0;
+    int status = 0;
+    struct rusage usage = {};
+};
+
+namespace pipeline_detail {
+
+inline void GrowPipe(int fd, size_t size) {
+    if (size <= INT_MAX) {
+        fcntl(fd, F_SETPIPE_SZ, static_cast<int>(size));
+    }
+}
+
+// Starts `stage` with `input` and `output` as its standard descriptors.
+// posix_spawn starts the child in the parent's address space (with
+// CLONE_VM | CLONE_VFORK), so it costs the same however large the parent
+// is, unlike fork, which copies its page tables.
+inline int SpawnStage(const PipelineStage& stage, int input, int output,
+                      pid_t* pid) {
+    if (stage.empty()) {
+        return EINVAL;
+    }
+    std::vector<char*> argv;
+    argv.reserve(stage.size() + 1);
+    for (const auto& arg : stage) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    if (int err = posix_spawn_file_actions_init(&actions); err != 0) {
+        return err;
+    }
+    DEFER {
+        posix_spawn_file_actions_destroy(&actions);
+    };
+    posix_spawnattr_t attr;
+    if (int err = posix_spawnattr_init(&attr); err != 0) {
+        return err;
+    }
+    DEFER {
+        posix_spawnattr_destroy(&attr);
+    };
+
+    // Pipe ends are O_CLOEXEC, so only the two installed here survive exec.
+    // Standard descriptors are moved above them first: then both dup2 run
+    // and clear FD_CLOEXEC even if an end is already in place, and the
+    // first one can not overwrite the source of the second, as it would
+    // with `output` 0.
+    int ends[2] = {input, output};
+    int moved[2] = {-1, -1};
+    DEFER {
+        for (int fd : moved) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    };
+    for (size_t i = 0; i < 2; ++i) {
+        if (ends[i] >= 0 && ends[i] <= STDERR_FILENO) {
+            moved[i] = fcntl(ends[i], F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+            if (moved[i] == -1) {
+                return errno;
+            }
+            ends[i] = moved[i];
+        }
+    }
+    int err = posix_spawn_file_actions_adddup2(&actions, ends[0],
+                                               STDIN_FILENO);
+    if (err == 0) {
+        err = posix_spawn_file_actions_adddup2(&actions, ends[1],
+                                               STDOUT_FILENO);
+    }
+
+    // A stage must die of SIGPIPE when the next one exits early, even if
+    // the parent ignores it.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    if (err == 0) {
+        err = posix_spawnattr_setsigdefault(&attr, &signals);
+    }
+    sigemptyset(&signals);
+    if (err == 0) {
+        err = posix_spawnattr_setsigmask(&attr, &signals);
+    }
+    if (err == 0) {
+        err = posix_spawnattr_setflags(
+            &attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+    }
+    pid_t child;
+    if (err == 0) {
+        err = posix_spawnp(&child, argv[0], &actions, &attr, argv.data(),
+                           environ);
+    }
+    if (err == 0) {
+        *pid = child;
+    }
+    return err;
+}
+
+}  // namespace pipeline_detail
+
+// Waits for every started stage and fills its status and resource usage.
+// Returns 0 or the first error of wait4.
+inline int WaitPipeline(std::span<StageResult> stages) {
+    int result = 0;
+    for (auto& stage : stages) {
+        if (stage.pid == -1) {
+            continue;
+        }
+        pid_t pid;
+        do {
+            pid = wait4(stage.pid, &stage.status, 0, &stage.usage);
+        } while (pid == -1 && errno == EINTR);
+        if (pid == -1 && result == 0) {
+            result = errno;
+        }
+    }
+    return result;
+}
+
+// Starts `stages` connected like `stage1 | stage2 | ...` and returns them
+// without waiting. A stage that fails to start does not stop the others:
+// its neighbours see end of file and a broken pipe, like in a shell.
+//
+// At most one pipe is open in the parent at a time, and each end is closed
+// right after the stage that uses it has started. Returns an error only if
+// a pipe could not be created; the stages started by then are waited for.
+inline std::variant<std::vector<StageResult>, int> SpawnPipeline(
+    std::span<const PipelineStage> stages,
+    const PipelineOptions& options = {}) {
+    std::vector<StageResult> results(stages.size());
+    int input = options.input;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        int fds[2] = {-1, options.output};
+        bool last = i + 1 == stages.size();
+        if (!last && pipe2(fds, O_CLOEXEC) == -1) {
+            int err = errno;
+            if (input != options.input) {
+                close(input);
+            }
+            WaitPipeline(std::span{results}.first(i));
+            return err;
+        }
+        if (!last && options.pipe_size != 0) {
+            pipeline_detail::GrowPipe(fds[1], options.pipe_size);
+        }
+        results[i].spawn_error = pipeline_detail::SpawnStage(
+            stages[i], input, fds[1], &results[i].pid);
+        if (input != options.input) {
+            close(input);
+        }
+        if (!last) {
+            close(fds[1]);
+        }
+        input = fds[0];
+    }
+    return results;
+}
+
+// Runs `stages` as a pipeline to completion, see SpawnPipeline.
+inline std::variant<std::vector<StageResult>, int> RunPipeline(
+    std::span<const PipelineStage> stages,
+    const PipelineOptions& options = {}) {
+    auto result = SpawnPipeline(stages, options);
+    if (auto* spawned = std::get_if<0>(&result)) {
+        if (int err = WaitPipeline(*spawned); err != 0) {
+            return err;
+        }
+    }
+    return result;
+}
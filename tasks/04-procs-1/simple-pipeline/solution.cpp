@@ -1,5 +1,24 @@
-#include <unused.hpp>  // TODO: remove before flight.
+#include "pipeline.hpp"
+
+#include <cstdio>
+#include <cstring>
 
 int main(int argc, char* argv[]) {
-    UNUSED(argc, argv);  // TODO: remove before flight.
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: %s CMD1 CMD2\n", argv[0]);
+        return 1;
+    }
+    std::vector<PipelineStage> stages = {{argv[1]}, {argv[2]}};
+    auto result = RunPipeline(stages);
+    if (auto* err = std::get_if<int>(&result)) {
+        std::fprintf(stderr, "pipeline: %s\n", std::strerror(*err));
+        return 1;
+    }
+    const auto& results = std::get<0>(result);
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].spawn_error != 0) {
+            std::fprintf(stderr, "%s: %s\n", stages[i][0].c_str(),
+                         std::strerror(results[i].spawn_error));
+        }
+    }
 }
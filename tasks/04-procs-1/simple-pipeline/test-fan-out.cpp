@@ -0,0 +1,162 @@
+#include "fan-out.hpp"
+
+#include <fd-guard.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+struct OutputFile {
+    OutputFile() : fd{memfd_create("fan-out-output", MFD_CLOEXEC)} {
+        REQUIRE(fd != -1);
+    }
+
+    ~OutputFile() {
+        close(fd);
+    }
+
+    std::string Contents() const {
+        std::string contents(lseek(fd, 0, SEEK_END), '\0');
+        REQUIRE(pread(fd, contents.data(), contents.size(), 0) ==
+                static_cast<ssize_t>(contents.size()));
+        return contents;
+    }
+
+    int fd;
+};
+
+FanOutResult Run(const std::vector<PipelineStage>& source,
+                 const std::vector<FanOutBranch>& branches,
+                 const PipelineOptions& options = {}) {
+    auto result = RunFanOut(source, branches, options);
+    REQUIRE(result.index() == 0);
+    auto fan_out = std::get<0>(std::move(result));
+    REQUIRE(fan_out.branches.size() == branches.size());
+    return fan_out;
+}
+
+std::string Seq(int n) {
+    std::string result;
+    for (int i = 1; i <= n; ++i) {
+        result += std::to_string(i) + '\n';
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE("EveryBranchGetsEverything") {
+    std::vector<OutputFile> outputs(4);
+    FileDescriptorsGuard guard;
+
+    std::vector<FanOutBranch> branches = {
+        {{{"wc", "-l"}}, outputs[0].fd},
+        {{{"tail", "-n", "1"}}, outputs[1].fd},
+        {{{"cat"}}, outputs[2].fd},
+        {{{"grep", "^99"}, {"wc", "-l"}}, outputs[3].fd},
+    };
+    auto result = Run({{"seq", "1", "200000"}}, branches);
+
+    auto expected = Seq(200'000);
+    CHECK(outputs[0].Contents() == "200000\n");
+    CHECK(outputs[1].Contents() == "200000\n");
+    CHECK(outputs[2].Contents() == expected);
+    CHECK(outputs[3].Contents() == "1111\n");
+    CHECK(result.source[0].status == 0);
+    for (const auto& branch : result.branches) {
+        CHECK(branch.error == 0);
+        CHECK(branch.bytes == expected.size());
+        CHECK(branch.seconds > 0);
+        for (const auto& stage : branch.stages) {
+            CHECK(stage.status == 0);
+        }
+    }
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("SingleBranch") {
+    OutputFile output;
+    FileDescriptorsGuard guard;
+
+    auto result = Run({{"seq", "1", "1000"}, {"rev"}},
+                      {{{{"rev"}}, output.fd}});
+    CHECK(output.Contents() == Seq(1000));
+    CHECK(result.branches[0].bytes == Seq(1000).size());
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("BranchExitsEarly") {
+    std::vector<OutputFile> outputs(2);
+    FileDescriptorsGuard guard;
+
+    std::vector<FanOutBranch> branches = {
+        {{{"head", "-n", "1"}}, outputs[0].fd},
+        {{{"wc", "-l"}}, outputs[1].fd},
+    };
+    auto result = Run({{"seq", "1", "1000000"}}, branches);
+
+    CHECK(outputs[0].Contents() == "1\n");
+    CHECK(outputs[1].Contents() == "1000000\n");
+    CHECK(result.branches[0].error == EPIPE);
+    CHECK(result.branches[0].bytes < Seq(1'000'000).size());
+    CHECK(result.branches[1].error == 0);
+    CHECK(result.branches[1].bytes == Seq(1'000'000).size());
+    CHECK(result.source[0].status == 0);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("EveryBranchExits") {
+    std::vector<OutputFile> outputs(3);
+    FileDescriptorsGuard guard;
+
+    std::vector<FanOutBranch> branches = {
+        {{{"head", "-n", "1"}}, outputs[0].fd},
+        {{{"head", "-n", "2"}}, outputs[1].fd},
+        {{{"head", "-n", "3"}}, outputs[2].fd},
+    };
+    // Only stops once nobody reads its output.
+    auto result = Run({{"yes"}}, branches);
+
+    CHECK(outputs[0].Contents() == "y\n");
+    CHECK(outputs[1].Contents() == "y\ny\n");
+    CHECK(outputs[2].Contents() == "y\ny\ny\n");
+    REQUIRE(WIFSIGNALED(result.source[0].status));
+    CHECK(WTERMSIG(result.source[0].status) == SIGPIPE);
+    for (const auto& branch : result.branches) {
+        CHECK(branch.error == EPIPE);
+    }
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("SlowestBranchBoundsTheRest") {
+    std::vector<OutputFile> outputs(2);
+
+    std::vector<FanOutBranch> branches = {
+        {{{"wc", "-c"}}, outputs[0].fd},
+        {{{"sh", "-c", "sleep 0.3; wc -c"}}, outputs[1].fd},
+    };
+    // Far more than the pipes hold, so the fast branch cannot get all of
+    // it before the slow one starts reading.
+    auto result = Run({{"head", "-c", "50000000", "/dev/zero"}}, branches,
+                      {.pipe_size = 1 << 16});
+
+    CHECK(outputs[0].Contents() == "50000000\n");
+    CHECK(outputs[1].Contents() == "50000000\n");
+    CHECK(result.branches[0].seconds >= 0.25);
+    CHECK(result.branches[1].seconds >= 0.25);
+}
+
+TEST_CASE("FanOutInvalid") {
+    FileDescriptorsGuard guard;
+    std::vector<PipelineStage> source = {{"true"}};
+    CHECK(std::get<int>(RunFanOut(source, {})) == EINVAL);
+    std::vector<FanOutBranch> branches = {{{{"cat"}}}, {}};
+    CHECK(std::get<int>(RunFanOut(source, branches)) == EINVAL);
+    CHECK(std::get<int>(RunFanOut({}, branches)) == EINVAL);
+    CHECK(guard.TestDescriptorsState());
+}
@@ -0,0 +1,204 @@
+#include "pipeline.hpp"
+
+#include <fd-guard.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <csignal>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// A file to capture the output of a pipeline, read back with Contents().
+struct OutputFile {
+    OutputFile() : fd{memfd_create("pipeline-output", MFD_CLOEXEC)} {
+        REQUIRE(fd != -1);
+    }
+
+    ~OutputFile() {
+        close(fd);
+    }
+
+    std::string Contents() const {
+        std::string contents(lseek(fd, 0, SEEK_END), '\0');
+        REQUIRE(pread(fd, contents.data(), contents.size(), 0) ==
+                static_cast<ssize_t>(contents.size()));
+        return contents;
+    }
+
+    int fd;
+};
+
+std::vector<StageResult> Run(const std::vector<PipelineStage>& stages,
+                             const PipelineOptions& options) {
+    auto result = RunPipeline(stages, options);
+    REQUIRE(result.index() == 0);
+    auto results = std::get<0>(std::move(result));
+    REQUIRE(results.size() == stages.size());
+    return results;
+}
+
+// Runs `cat` from `text` to the returned file in a child that installs
+// their descriptors as `input` and `output` first, with `flags` for dup3.
+std::string CatWithDescriptors(int input, int output, int flags) {
+    OutputFile source;
+    OutputFile sink;
+    std::string text = "standard descriptors\n";
+    REQUIRE(pwrite(source.fd, text.data(), text.size(), 0) ==
+            static_cast<ssize_t>(text.size()));
+
+    pid_t pid = fork();
+    REQUIRE(pid != -1);
+    if (pid == 0) {
+        // Through a spare descriptor, in case the sink is `input`.
+        int spare = fcntl(sink.fd, F_DUPFD_CLOEXEC, 10);
+        if (dup3(source.fd, input, flags) == -1 ||
+            dup3(spare, output, flags) == -1) {
+            _exit(2);
+        }
+        std::vector<PipelineStage> stages = {{"cat"}};
+        auto result = RunPipeline(stages, {.input = input, .output = output});
+        auto* results = std::get_if<0>(&result);
+        _exit(results && (*results)[0].status == 0 ? 0 : 1);
+    }
+    int status;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    CHECK(status == 0);
+    return sink.Contents();
+}
+
+}  // namespace
+
+TEST_CASE("ManyStages") {
+    OutputFile output;
+    FileDescriptorsGuard guard;
+
+    std::vector<PipelineStage> stages = {
+        {"echo", "hello, pipeline"},
+        {"tr", "a-z", "A-Z"},
+        {"rev"},
+        {"cat"},
+        {"sed", "s/,/;/"},
+    };
+    auto results = Run(stages, {.output = output.fd});
+
+    CHECK(output.Contents() == "ENILEPIP ;OLLEH\n");
+    for (const auto& stage : results) {
+        CHECK(stage.spawn_error == 0);
+        CHECK(stage.pid > 0);
+        CHECK(WIFEXITED(stage.status));
+        CHECK(WEXITSTATUS(stage.status) == 0);
+        CHECK(stage.usage.ru_maxrss > 0);
+    }
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("SingleStage") {
+    OutputFile output;
+    auto results = Run({{"echo", "alone"}}, {.output = output.fd});
+    CHECK(output.Contents() == "alone\n");
+    CHECK(results[0].status == 0);
+}
+
+TEST_CASE("ExitStatuses") {
+    OutputFile output;
+    FileDescriptorsGuard guard;
+
+    std::vector<PipelineStage> stages = {
+        {"sh", "-c", "echo data; exit 3"},
+        {"sh", "-c", "cat; kill -TERM $$"},
+        {"sh", "-c", "cat; exit 5"},
+    };
+    auto results = Run(stages, {.output = output.fd});
+
+    CHECK(output.Contents() == "data\n");
+    REQUIRE(WIFEXITED(results[0].status));
+    CHECK(WEXITSTATUS(results[0].status) == 3);
+    REQUIRE(WIFSIGNALED(results[1].status));
+    CHECK(WTERMSIG(results[1].status) == SIGTERM);
+    REQUIRE(WIFEXITED(results[2].status));
+    CHECK(WEXITSTATUS(results[2].status) == 5);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("BrokenPipe") {
+    // The first stage would never stop if SIGPIPE did not kill it, even
+    // though the parent ignores it.
+    auto old = signal(SIGPIPE, SIG_IGN);
+    OutputFile output;
+    auto results = Run({{"yes"}, {"head", "-n", "2"}}, {.output = output.fd});
+    signal(SIGPIPE, old);
+
+    CHECK(output.Contents() == "y\ny\n");
+    REQUIRE(WIFSIGNALED(results[0].status));
+    CHECK(WTERMSIG(results[0].status) == SIGPIPE);
+}
+
+TEST_CASE("MissingCommand") {
+    OutputFile output;
+    FileDescriptorsGuard guard;
+
+    std::vector<PipelineStage> stages = {
+        {"echo", "lost"},
+        {"no-such-command-in-path"},
+        {"cat"},
+    };
+    auto results = Run(stages, {.output = output.fd});
+
+    CHECK(output.Contents().empty());
+    CHECK(results[0].spawn_error == 0);
+    CHECK(results[1].spawn_error == ENOENT);
+    CHECK(results[1].pid == -1);
+    CHECK(results[2].spawn_error == 0);
+    CHECK(results[2].status == 0);
+
+    stages[1].clear();
+    results = Run(stages, {.output = output.fd});
+    CHECK(results[1].spawn_error == EINVAL);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("StandardDescriptors") {
+    SECTION("CloseOnExec") {
+        CHECK(CatWithDescriptors(STDIN_FILENO, STDOUT_FILENO, O_CLOEXEC) ==
+              "standard descriptors\n");
+    }
+    SECTION("Swapped") {
+        CHECK(CatWithDescriptors(STDOUT_FILENO, STDIN_FILENO, 0) ==
+              "standard descriptors\n");
+    }
+}
+
+TEST_CASE("PipeSize") {
+    OutputFile output;
+    std::vector<PipelineStage> stages = {
+        {"head", "-c", "200000", "/dev/zero"},
+        {"sh", "-c", "sleep 0.1; wc -c"},
+    };
+    auto results = Run(stages, {.output = output.fd, .pipe_size = 1 << 18});
+    CHECK(output.Contents() == "200000\n");
+    CHECK(results[0].status == 0);
+    CHECK(results[1].status == 0);
+}
+
+TEST_CASE("ManyPipelines") {
+    OutputFile output;
+    FileDescriptorsGuard guard;
+
+    std::vector<PipelineStage> stages = {{"true"}, {"true"}, {"true"}};
+    for (int i = 0; i < 200; ++i) {
+        auto spawned = SpawnPipeline(stages, {.output = output.fd});
+        REQUIRE(spawned.index() == 0);
+        auto& results = std::get<0>(spawned);
+        REQUIRE(WaitPipeline(results) == 0);
+        for (const auto& stage : results) {
+            REQUIRE(stage.status == 0);
+        }
+    }
+    CHECK(guard.TestDescriptorsState());
+}
@@ -0,0 +1,571 @@
+#pragma once
+
+#include <defer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct CheckOptions {
+    // Looked up in PATH. Must accept gcc's options; clang does.
+    std::string compiler = "cc";
+    // The most snippets given to one compiler run.
+    size_t batch_size = 512;
+};
+
+namespace check_detail {
+
+// Undeclared functions are only a warning in older C dialects, but a
+// snippet calling one depends on a symbol it does not declare.
+inline const std::vector<std::string> kFlags = {
+    "-x",
+    "c",
+    "-fsyntax-only",
+    "-fdiagnostics-color=never",
+    "-fno-diagnostics-show-caret",
+    "-Werror=implicit-function-declaration",
+    "-Werror=implicit-int",
+    "-Werror=return-type",
+    "-",
+};
+
+// Every snippet becomes the body of its own function, on the line of the
+// opening brace, so a '#' in it is never a directive. `#line` names the
+// lines after the index of the snippet, so every diagnostic starts with
+// the index of the snippet it is about.
+//
+// The compiler declares an unknown function at its first call and reports
+// only that one; calls in the functions after it pass. So every name in
+// `implicit` is renamed apart in each function with a macro.
+inline std::string WrapSnippets(std::span<const std::string_view> snippets,
+                                std::span<const std::string> implicit) {
+    std::string source;
+    for (size_t i = 0; i < snippets.size(); ++i) {
+        auto index = std::to_string(i);
+        // Diagnostics about a renamed call point into the macro, so it
+        // must be defined in the lines of the snippet too.
+        source += "#line 1 \"" + index + "\"\n";
+        for (const auto& name : implicit) {
+            source += "#define " + name + " __check_c_" + index + '_' +
+                      name + '\n';
+        }
+        source += "static void __check_c_snippet_" + index + "(void) {";
+        source += snippets[i];
+        source += "\n}\n";
+        for (const auto& name : implicit) {
+            source += "#undef " + name + '\n';
+        }
+    }
+    return source;
+}
+
+// Whether errors in the snippet stay in its own function: every comment
+// and literal ends, parentheses and brackets are balanced, and there are
+// no braces, '#' or line splices. Otherwise the compiler may read the
+// functions after it as part of a comment, a string or an expression.
+// Neither may it use _Pragma or __pragma, which could turn off the errors
+// for the rest of the source.
+inline bool IsContained(std::string_view snippet) {
+    auto is_word = [](char c) {
+        return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9');
+    };
+    enum class State { kCode, kLineComment, kBlockComment, kString, kChar };
+    State state = State::kCode;
+    int depth = 0;
+    for (size_t i = 0; i < snippet.size(); ++i) {
+        char c = snippet[i];
+        char next = i + 1 < snippet.size() ? snippet[i + 1] : '\0';
+        if (c == '\\' && (next == '\n' || next == '\0')) {
+            return false;
+        }
+        switch (state) {
+            case State::kCode:
+                if (c == '/' && next == '/') {
+                    state = State::kLineComment;
+                } else if (c == '/' && next == '*') {
+                    state = State::kBlockComment;
+                    ++i;
+                } else if (c == '"') {
+                    state = State::kString;
+                } else if (c == '\'') {
+                    state = State::kChar;
+                } else if (c == '(' || c == '[') {
+                    ++depth;
+                } else if (c == ')' || c == ']') {
+                    if (--depth < 0) {
+                        return false;
+                    }
+                } else if (c == '{' || c == '}' || c == '#') {
+                    return false;
+                } else if (is_word(c)) {
+                    size_t end = i;
+                    while (end < snippet.size() && is_word(snippet[end])) {
+                        ++end;
+                    }
+                    auto word = snippet.substr(i, end - i);
+                    if (word == "_Pragma" || word == "__pragma") {
+                        return false;
+                    }
+                    i = end - 1;
+                }
+                break;
+            case State::kLineComment:
+                if (c == '\n') {
+                    state = State::kCode;
+                }
+                break;
+            case State::kBlockComment:
+                if (c == '*' && next == '/') {
+                    state = State::kCode;
+                    ++i;
+                }
+                break;
+            case State::kString:
+            case State::kChar:
+                if (c == '\\') {
+                    ++i;
+                } else if (c == '\n') {
+                    return false;
+                } else if (c == (state == State::kString ? '"' : '\'')) {
+                    state = State::kCode;
+                }
+                break;
+        }
+    }
+    return depth == 0 &&
+           (state == State::kCode || state == State::kLineComment);
+}
+
+// Marks the snippets named by "INDEX:LINE:COLUMN: error: ..." lines and
+// collects the functions reported as implicitly declared. Returns false if
+// some error is not about a snippet.
+inline bool ParseErrors(std::string_view diagnostics,
+                        std::vector<bool>* failed,
+                        std::vector<std::string>* implicit) {
+    constexpr std::string_view kImplicit = "implicit declaration of function '";
+    bool attributed = true;
+    while (!diagnostics.empty()) {
+        size_t end = diagnostics.find('\n');
+        auto line = diagnostics.substr(0, end);
+        diagnostics.remove_prefix(
+            end == std::string_view::npos ? diagnostics.size() : end + 1);
+        if (line.find(" error: ") == std::string_view::npos) {
+            continue;
+        }
+        if (size_t pos = line.find(kImplicit); pos != std::string_view::npos) {
+            auto name = line.substr(pos + kImplicit.size());
+            implicit->emplace_back(name.substr(0, name.find('\'')));
+        }
+        size_t index = 0;
+        size_t digits = 0;
+        while (digits < line.size() && line[digits] >= '0' &&
+               line[digits] <= '9') {
+            index = index * 10 + (line[digits++] - '0');
+        }
+        if (digits == 0 || digits == line.size() || line[digits] != ':' ||
+            index >= failed->size()) {
+            attributed = false;
+            continue;
+        }
+        (*failed)[index] = true;
+    }
+    return attributed;
+}
+
+// Writes all of `data` to a pipe. The compiler may exit before reading
+// everything, which is not an error here: SIGPIPE is blocked and then
+// discarded, so only this thread sees EPIPE and the process survives.
+inline int WriteAll(int fd, std::string_view data) {
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    sigset_t old_mask;
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, &old_mask);
+    DEFER {
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE) &&
+            !sigismember(&old_mask, SIGPIPE)) {
+            timespec zero = {};
+            sigtimedwait(&pipe_signal, nullptr, &zero);
+        }
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+    };
+
+    while (!data.empty()) {
+        ssize_t written = write(fd, data.data(), data.size());
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EPIPE ? 0 : errno;
+        }
+        data.remove_prefix(written);
+    }
+    return 0;
+}
+
+inline std::string ReadAll(int fd) {
+    std::string contents(lseek(fd, 0, SEEK_END), '\0');
+    size_t done = 0;
+    while (done < contents.size()) {
+        ssize_t got = pread(fd, contents.data() + done,
+                            contents.size() - done, done);
+        if (got <= 0) {
+            break;
+        }
+        done += got;
+    }
+    contents.resize(done);
+    return contents;
+}
+
+// Runs the compiler once over `snippets`, the source piped to its standard
+// input and the diagnostics caught in a memfd, so nothing touches the
+// disk. Sets `failed` for the snippets with errors and returns 0, or
+// returns an errno if the compiler could not run; a compiler killed by a
+// signal is EIO. `pinned` is false if the compiler failed with an error
+// that is not about any snippet. The names in `implicit` are renamed apart
+// in every snippet (see WrapSnippets), and the functions that were
+// implicitly declared are added to it.
+inline int Compile(std::span<const std::string_view> snippets,
+                   const CheckOptions& options, std::vector<bool>* failed,
+                   bool* pinned, std::vector<std::string>* implicit) {
+    failed->assign(snippets.size(), false);
+    *pinned = true;
+    std::vector<char*> argv = {const_cast<char*>(options.compiler.c_str())};
+    for (const auto& flag : kFlags) {
+        argv.push_back(const_cast<char*>(flag.c_str()));
+    }
+    argv.push_back(nullptr);
+    // Diagnostics are parsed, so they must not be translated.
+    std::vector<char*> envp = {const_cast<char*>("LC_ALL=C")};
+    for (char** env = environ; *env != nullptr; ++env) {
+        envp.push_back(*env);
+    }
+    envp.push_back(nullptr);
+
+    int diagnostics = memfd_create("check-c-diagnostics", MFD_CLOEXEC);
+    if (diagnostics == -1) {
+        return errno;
+    }
+    DEFER {
+        close(diagnostics);
+    };
+    int input[2];
+    if (pipe2(input, O_CLOEXEC) == -1) {
+        return errno;
+    }
+    DEFER {
+        if (input[1] != -1) {
+            close(input[1]);
+        }
+    };
+
+    posix_spawn_file_actions_t actions;
+    if (int err = posix_spawn_file_actions_init(&actions); err != 0) {
+        close(input[0]);
+        return err;
+    }
+    int err = posix_spawn_file_actions_adddup2(&actions, input[0],
+                                               STDIN_FILENO);
+    if (err == 0) {
+        err = posix_spawn_file_actions_adddup2(&actions, diagnostics,
+                                               STDOUT_FILENO);
+    }
+    if (err == 0) {
+        err = posix_spawn_file_actions_adddup2(&actions, diagnostics,
+                                               STDERR_FILENO);
+    }
+    pid_t pid;
+    if (err == 0) {
+        err = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(),
+                           envp.data());
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    close(input[0]);
+    if (err != 0) {
+        return err;
+    }
+
+    err = WriteAll(input[1], WrapSnippets(snippets, *implicit));
+    close(std::exchange(input[1], -1));
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return errno;
+        }
+    }
+    if (err != 0) {
+        return err;
+    }
+    if (!WIFEXITED(status)) {
+        return EIO;
+    }
+    if (WEXITSTATUS(status) != 0) {
+        *pinned = ParseErrors(ReadAll(diagnostics), failed, implicit) &&
+                  std::ranges::find(*failed, true) != failed->end();
+    }
+    return 0;
+}
+
+// Decides every snippet of `batch` (indexes into `snippets`), which must
+// all be contained except for the last one. If the first run finds calls
+// to undeclared functions, the batch runs again with them renamed apart,
+// as later calls were not reported. Errors the compiler cannot pin on a
+// snippet should not happen, but if they do the batch is halved until
+// they can be, down to single snippets, for which they are simply a
+// failure.
+inline int CheckBatch(std::span<const std::string_view> snippets,
+                      std::span<const size_t> batch,
+                      const CheckOptions& options, std::vector<bool>* valid) {
+    std::vector<std::string_view> sources;
+    sources.reserve(batch.size());
+    for (size_t index : batch) {
+        sources.push_back(snippets[index]);
+    }
+    std::vector<bool> failed;
+    bool pinned;
+    std::vector<std::string> implicit;
+    if (int err = Compile(sources, options, &failed, &pinned, &implicit);
+        err != 0) {
+        return err;
+    }
+    if (pinned && !implicit.empty() && batch.size() > 1) {
+        std::ranges::sort(implicit);
+        implicit.erase(std::ranges::unique(implicit).begin(), implicit.end());
+        if (int err = Compile(sources, options, &failed, &pinned, &implicit);
+            err != 0) {
+            return err;
+        }
+    }
+    if (pinned || batch.size() == 1) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            (*valid)[batch[i]] = pinned && !failed[i];
+        }
+        return 0;
+    }
+    size_t half = batch.size() / 2;
+    if (int err = CheckBatch(snippets, batch.first(half), options, valid);
+        err != 0) {
+        return err;
+    }
+    return CheckBatch(snippets, batch.subspan(half), options, valid);
+}
+
+// Keeps -Wpedantic quiet about the GCC extension.
+__extension__ typedef unsigned __int128 Uint128;
+
+// 128-bit FNV-1a.
+inline Uint128 Hash(std::string_view data) {
+    constexpr Uint128 kPrime = (static_cast<Uint128>(1) << 88) + 0x13b;
+    Uint128 hash = (static_cast<Uint128>(0x6c62272e07bb0142) << 64) |
+                   0x62b821756295c58d;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * kPrime;
+    }
+    return hash;
+}
+
+}  // namespace check_detail
+
+// Checks whether every snippet compiles as the body of a function taking
+// and returning nothing, with no symbols declared outside of it. Snippets
+// go to the compiler `options.batch_size` at a time, one function each, so
+// a corpus costs one compiler start per batch rather than per snippet.
+// Repeated snippets are checked once, and a snippet whose errors could
+// spill into the next function (see IsContained) always goes last in its
+// batch. Returns the verdicts, or an errno if the compiler could not be
+// run.
+inline std::variant<std::vector<bool>, int> CheckSnippets(
+    std::span<const std::string_view> snippets,
+    const CheckOptions& options = {}) {
+    using namespace check_detail;
+    std::vector<bool> valid(snippets.size());
+    std::unordered_map<std::string_view, size_t> first;
+    std::vector<size_t> contained;
+    std::vector<size_t> alone;
+    for (size_t i = 0; i < snippets.size(); ++i) {
+        if (first.emplace(snippets[i], i).second) {
+            (IsContained(snippets[i]) ? contained : alone).push_back(i);
+        }
+    }
+
+    // A snippet that is not contained can only break the functions after
+    // it, so every batch may end with one.
+    size_t batch_size = std::max<size_t>(options.batch_size, 1);
+    size_t next_contained = 0;
+    size_t next_alone = 0;
+    std::vector<size_t> batch;
+    while (next_contained < contained.size() || next_alone < alone.size()) {
+        batch.clear();
+        while (batch.size() + 1 < batch_size &&
+               next_contained < contained.size()) {
+            batch.push_back(contained[next_contained++]);
+        }
+        if (next_alone < alone.size()) {
+            batch.push_back(alone[next_alone++]);
+        } else if (next_contained < contained.size()) {
+            batch.push_back(contained[next_contained++]);
+        }
+        if (int err = CheckBatch(snippets, batch, options, &valid);
+            err != 0) {
+            return err;
+        }
+    }
+    for (size_t i = 0; i < snippets.size(); ++i) {
+        valid[i] = valid[first[snippets[i]]];
+    }
+    return valid;
+}
+
+// Verdicts kept on disk by the hash of the snippet, the compiler and its
+// flags, in a file of "HASH V" or "HASH I" lines. New verdicts are
+// appended by Save with a single write each, so processes sharing the file
+// do not corrupt it; a line that does not parse is ignored.
+class VerdictCache {
+    using Uint128 = check_detail::Uint128;
+
+  public:
+    // Reads the cache at `path`; a missing file is an empty cache.
+    explicit VerdictCache(std::string path, const CheckOptions& options = {})
+        : path_{std::move(path)} {
+        salt_ = options.compiler + '\0';
+        for (const auto& flag : check_detail::kFlags) {
+            salt_ += flag + '\0';
+        }
+        std::ifstream file{path_};
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.size() != kHashDigits + 2 || line[kHashDigits] != ' ' ||
+                (line.back() != 'V' && line.back() != 'I')) {
+                continue;
+            }
+            Uint128 hash = 0;
+            if (ParseHash(std::string_view{line}.substr(0, kHashDigits),
+                          &hash)) {
+                verdicts_[hash] = line.back() == 'V';
+            }
+        }
+    }
+
+    // The default location: $CHECK_C_CACHE, or check-c in
+    // $XDG_CACHE_HOME or ~/.cache. Empty if none of them is set.
+    static std::string DefaultPath() {
+        if (const char* path = std::getenv("CHECK_C_CACHE")) {
+            return path;
+        }
+        if (const char* dir = std::getenv("XDG_CACHE_HOME"); dir && *dir) {
+            return std::string{dir} + "/check-c";
+        }
+        if (const char* home = std::getenv("HOME"); home && *home) {
+            return std::string{home} + "/.cache/check-c";
+        }
+        return {};
+    }
+
+    // The cached verdict: 1 for valid, 0 for invalid, -1 if unknown.
+    int Find(std::string_view snippet) const {
+        auto it = verdicts_.find(Key(snippet));
+        return it == verdicts_.end() ? -1 : it->second;
+    }
+
+    void Add(std::string_view snippet, bool valid) {
+        auto key = Key(snippet);
+        if (verdicts_.emplace(key, valid).second) {
+            pending_ += FormatHash(key) + ' ' + (valid ? 'V' : 'I') + '\n';
+        }
+    }
+
+    // Appends the verdicts added since the last call, creating the file
+    // and its directory if needed. Returns 0 or errno.
+    int Save() {
+        if (pending_.empty()) {
+            return 0;
+        }
+        if (size_t slash = path_.rfind('/');
+            slash != std::string::npos && slash != 0) {
+            mkdir(path_.substr(0, slash).c_str(), 0755);
+        }
+        int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                      0644);
+        if (fd == -1) {
+            return errno;
+        }
+        std::string_view data = pending_;
+        int err = 0;
+        while (!data.empty() && err == 0) {
+            ssize_t written = write(fd, data.data(), data.size());
+            if (written == -1 && errno != EINTR) {
+                err = errno;
+            } else if (written > 0) {
+                data.remove_prefix(written);
+            }
+        }
+        close(fd);
+        pending_.clear();
+        return err;
+    }
+
+  private:
+    static constexpr size_t kHashDigits = 32;
+
+    struct HashOfHash {
+        size_t operator()(Uint128 hash) const {
+            return static_cast<size_t>(hash ^ (hash >> 64));
+        }
+    };
+
+    Uint128 Key(std::string_view snippet) const {
+        std::string data = salt_;
+        data += snippet;
+        return check_detail::Hash(data);
+    }
+
+    static std::string FormatHash(Uint128 hash) {
+        std::string digits(kHashDigits, '0');
+        for (size_t i = kHashDigits; i-- > 0; hash >>= 4) {
+            digits[i] = "0123456789abcdef"[static_cast<int>(hash & 0xf)];
+        }
+        return digits;
+    }
+
+    static bool ParseHash(std::string_view digits, Uint128* hash) {
+        for (char c : digits) {
+            int value;
+            if (c >= '0' && c <= '9') {
+                value = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value = c - 'a' + 10;
+            } else {
+                return false;
+            }
+            *hash = (*hash << 4) | value;
+        }
+        return true;
+    }
+
+    std::string path_;
+    std::string salt_;
+    std::unordered_map<Uint128, bool, HashOfHash> verdicts_;
+    std::string pending_;
+};
@@ -1,7 +1,104 @@
-#include <unused.hpp>  // TODO: remove before flight.
+#include "check.hpp"
 
-int main(int argc, char** argv) {
-    UNUSED(argc, argv);  // TODO: remove before flight.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Answers from the cache at `path`, if it is not empty, and checks only
+// the snippets it does not know.
+std::variant<std::vector<bool>, int> Check(
+    const std::vector<std::string_view>& snippets, const std::string& path) {
+    VerdictCache cache{path};
+    std::vector<bool> valid(snippets.size());
+    std::vector<std::string_view> unknown;
+    std::vector<size_t> unknown_index;
+    for (size_t i = 0; i < snippets.size(); ++i) {
+        if (int cached = path.empty() ? -1 : cache.Find(snippets[i]);
+            cached != -1) {
+            valid[i] = cached == 1;
+        } else {
+            unknown.push_back(snippets[i]);
+            unknown_index.push_back(i);
+        }
+    }
+    if (unknown.empty()) {
+        return valid;
+    }
+
+    auto checked = CheckSnippets(unknown);
+    if (auto* err = std::get_if<int>(&checked)) {
+        return *err;
+    }
+    const auto& verdicts = std::get<0>(checked);
+    for (size_t i = 0; i < unknown.size(); ++i) {
+        valid[unknown_index[i]] = verdicts[i];
+        cache.Add(unknown[i], verdicts[i]);
+    }
+    // The cache only saves time, so failing to write it is fine.
+    if (!path.empty()) {
+        cache.Save();
+    }
+    return valid;
+}
 
-    // TODO: your code here.
+// --batch [FILE]: checks every line of FILE, or of the standard input,
+// and prints a verdict for each.
+int RunBatch(const char* path) {
+    std::ifstream file;
+    if (path != nullptr) {
+        file.open(path);
+        if (!file) {
+            std::perror(path);
+            return 0;
+        }
+    }
+    std::istream& input = path != nullptr ? file : std::cin;
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(input, line);) {
+        lines.push_back(std::move(line));
+    }
+
+    std::vector<std::string_view> snippets(lines.begin(), lines.end());
+    auto checked = Check(snippets, VerdictCache::DefaultPath());
+    if (auto* err = std::get_if<int>(&checked)) {
+        std::fprintf(stderr, "check-c: %s\n", std::strerror(*err));
+        return 0;
+    }
+    std::string output;
+    for (bool valid : std::get<0>(checked)) {
+        output += valid ? "Valid\n" : "Invalid\n";
+    }
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    return 0;
+}
+
+}  // namespace
+
+// Errors are reported on stderr only: the exit code is always 0.
+int main(int argc, char** argv) {
+    if (argc >= 2 && argc <= 3 && std::strcmp(argv[1], "--batch") == 0) {
+        return RunBatch(argc == 3 ? argv[2] : nullptr);
+    }
+    if (argc != 2) {
+        std::fprintf(stderr,
+                     "Usage: %s SNIPPET\n"
+                     "       %s --batch [FILE]\n",
+                     argv[0], argv[0]);
+        return 0;
+    }
+    // A single snippet uses the cache only when asked to.
+    const char* cache = std::getenv("CHECK_C_CACHE");
+    auto checked = Check({argv[1]}, cache != nullptr ? cache : "");
+    if (auto* err = std::get_if<int>(&checked)) {
+        std::fprintf(stderr, "check-c: %s\n", std::strerror(*err));
+        return 0;
+    }
+    std::puts(std::get<0>(checked)[0] ? "Valid" : "Invalid");
 }
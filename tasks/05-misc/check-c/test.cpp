@@ -0,0 +1,244 @@
+#include "check.hpp"
+
+#include <fd-guard.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// A fresh directory, removed with everything in it at the end.
+struct TempDir {
+    TempDir() {
+        std::string pattern =
+            (fs::temp_directory_path() / "check-c-XXXXXX").string();
+        REQUIRE(mkdtemp(pattern.data()) != nullptr);
+        path = pattern;
+    }
+
+    ~TempDir() {
+        fs::remove_all(path);
+    }
+
+    std::string operator/(const std::string& name) const {
+        return (path / name).string();
+    }
+
+    fs::path path;
+};
+
+std::vector<bool> Check(const std::vector<std::string_view>& snippets,
+                        const CheckOptions& options = {}) {
+    auto checked = CheckSnippets(snippets, options);
+    REQUIRE(checked.index() == 0);
+    auto valid = std::get<0>(std::move(checked));
+    REQUIRE(valid.size() == snippets.size());
+    return valid;
+}
+
+// Every snippet checked on its own.
+std::vector<bool> CheckOneByOne(
+    const std::vector<std::string_view>& snippets) {
+    std::vector<bool> valid;
+    for (auto snippet : snippets) {
+        valid.push_back(Check({snippet})[0]);
+    }
+    return valid;
+}
+
+const std::vector<std::string_view> kExamples = {
+    "1 + 2 + 3;", "1 + 2 +;",  "int x = 0; x + 3;", "int x; x + 3;",
+    "y + 4;",     "x / 2;",    "int x; 10;",        "stdin;",
+    "exit;",      "main;",     "return;",
+};
+
+const std::vector<bool> kExpected = {
+    true, false, true, true, false, false, true, false, false, false, true,
+};
+
+}  // namespace
+
+TEST_CASE("Examples") {
+    FileDescriptorsGuard guard;
+    CHECK(Check(kExamples) == kExpected);
+    CHECK(CheckOneByOne(kExamples) == kExpected);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("SmallBatches") {
+    for (size_t batch_size : {1, 2, 3, 5}) {
+        CHECK(Check(kExamples, {.batch_size = batch_size}) == kExpected);
+    }
+}
+
+TEST_CASE("SnippetsStayApart") {
+    // Each of these could make the snippets after it look valid or not if
+    // it shared a function or a scope with them.
+    std::vector<std::string_view> snippets = {
+        "exit(1);",
+        "exit(2);",
+        "int z; z = 1;",
+        "z;",
+        "foo(1);",
+        "int foo(int); foo(1);",
+        "foo(2);",
+        "int a = (1;",
+        "a;",
+        "/* open",
+        "int b; b;",
+        "\"open",
+        "int c; c;",
+        "char d = 'x",
+        "int e; // comment",
+        "e;",
+        "int f = 1); f;",
+        "#define g 1",
+        "g;",
+        "return 1;",
+        "int h; h; \\",
+        "int i; i;",
+    };
+    auto expected = CheckOneByOne(snippets);
+    CHECK(expected == std::vector<bool>{
+                          false, false, true,  false, false, true,
+                          false, false, false, false, true,  false,
+                          true,  false, true,  false, false, false,
+                          false, false, true,  true,
+                      });
+    CHECK(Check(snippets) == expected);
+    CHECK(Check(snippets, {.batch_size = 4}) == expected);
+}
+
+TEST_CASE("Pragmas") {
+    CHECK_FALSE(check_detail::IsContained("_Pragma(\"GCC diagnostic push\")"));
+    CHECK_FALSE(check_detail::IsContained("int x; __pragma(x);"));
+    CHECK(check_detail::IsContained("int my_Pragma; my_Pragma;"));
+    CHECK(check_detail::IsContained("\"_Pragma\"; // _Pragma"));
+
+    // Would hide the undeclared functions of the snippets after it.
+    std::vector<std::string_view> snippets = {
+        "_Pragma(\"GCC diagnostic ignored "
+        "\\\"-Wimplicit-function-declaration\\\"\")",
+        "foo(3);",
+        "int my_Pragma; my_Pragma;",
+    };
+    auto expected = CheckOneByOne(snippets);
+    CHECK(expected == std::vector<bool>{true, false, true});
+    CHECK(Check(snippets) == expected);
+}
+
+TEST_CASE("Duplicates") {
+    std::vector<std::string_view> snippets;
+    for (int i = 0; i < 100; ++i) {
+        snippets.push_back(i % 2 == 0 ? "int x; x;" : "x;");
+    }
+    auto valid = Check(snippets);
+    for (size_t i = 0; i < valid.size(); ++i) {
+        CHECK(valid[i] == (i % 2 == 0));
+    }
+}
+
+TEST_CASE("LargeCorpus") {
+    std::vector<std::string> sources;
+    for (int i = 0; i < 3000; ++i) {
+        auto n = std::to_string(i);
+        switch (i % 4) {
+            case 0:
+                sources.push_back("int v" + n + " = " + n + "; v" + n + ";");
+                break;
+            case 1:
+                sources.push_back("v" + n + " + 1;");
+                break;
+            case 2:
+                sources.push_back("printf(\"" + n + "\");");
+                break;
+            default:
+                sources.push_back("return " + n + ";");
+        }
+    }
+    std::vector<std::string_view> snippets(sources.begin(), sources.end());
+    auto valid = Check(snippets);
+    for (size_t i = 0; i < valid.size(); ++i) {
+        REQUIRE(valid[i] == (i % 4 == 0));
+    }
+}
+
+TEST_CASE("MissingCompiler") {
+    FileDescriptorsGuard guard;
+    auto checked =
+        CheckSnippets(kExamples, {.compiler = "no-such-compiler-in-path"});
+    CHECK(std::get<int>(checked) == ENOENT);
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("VerdictCache") {
+    TempDir dir;
+    auto path = dir / "cache/verdicts";
+    {
+        VerdictCache cache{path};
+        CHECK(cache.Find("int x; x;") == -1);
+        cache.Add("int x; x;", true);
+        cache.Add("x;", false);
+        CHECK(cache.Find("int x; x;") == 1);
+        CHECK(cache.Find("x;") == 0);
+        CHECK(cache.Save() == 0);
+    }
+    {
+        std::ofstream{path, std::ios::app} << "garbage\n";
+        VerdictCache cache{path};
+        CHECK(cache.Find("int x; x;") == 1);
+        CHECK(cache.Find("x;") == 0);
+        CHECK(cache.Find("y;") == -1);
+        cache.Add("y;", false);
+        cache.Add("x;", false);
+        CHECK(cache.Save() == 0);
+    }
+    std::ifstream file{path};
+    std::string contents{std::istreambuf_iterator<char>{file}, {}};
+    CHECK(std::ranges::count(contents, '\n') == 4);
+
+    // Another compiler may judge differently.
+    VerdictCache other{path, {.compiler = "clang"}};
+    CHECK(other.Find("int x; x;") == -1);
+}
+
+TEST_CASE("DefaultCachePath") {
+    // Puts the variables back as they were at the end.
+    struct SavedEnv {
+        explicit SavedEnv(const char* name) : name{name} {
+            if (const char* value = std::getenv(name)) {
+                old = value;
+            }
+        }
+
+        ~SavedEnv() {
+            if (old) {
+                setenv(name, old->c_str(), 1);
+            } else {
+                unsetenv(name);
+            }
+        }
+
+        const char* name;
+        std::optional<std::string> old;
+    };
+    SavedEnv saved_cache{"CHECK_C_CACHE"};
+    SavedEnv saved_xdg{"XDG_CACHE_HOME"};
+
+    setenv("CHECK_C_CACHE", "/some/file", 1);
+    CHECK(VerdictCache::DefaultPath() == "/some/file");
+    unsetenv("CHECK_C_CACHE");
+    setenv("XDG_CACHE_HOME", "/cache", 1);
+    CHECK(VerdictCache::DefaultPath() == "/cache/check-c");
+}
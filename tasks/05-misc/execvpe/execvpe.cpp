@@ -5,11 +5,441 @@
 #include <c-strings.hpp>
 
 #include <cerrno>          // ENOENT ENOTDIR EACCES
+#include <cstdint>         // uint64_t
+#include <fcntl.h>         // AT_FDCWD
 #include <linux/limits.h>  // PATH_MAX
+#include <linux/stat.h>    // statx
+#include <sys/syscall.h>   // SYS_*
+#include <time.h>          // CLOCK_REALTIME
+#include <unistd.h>        // X_OK
 
-#include <unused.hpp>  // TODO: remove before flight.
+// Finds the file ExecVPE would run for `file` and writes its path to
+// `resolved`. Returns 0, or -1 with Errno set to ENOENT, EACCES or
+// ENAMETOOLONG. Results are cached, see path_cache below.
+int ResolveExecutable(const char* file, char* resolved, size_t size);
+
+// The entry point of the wrappers in syscalls.hpp, for the calls they do
+// not cover.
+extern "C" int64_t InternalSyscallImpl(int64_t sysnum, ...);
+
+namespace {
+
+int SyscallResult(int64_t value) {
+    if (value > -4096 && value < 0) {
+        Errno = static_cast<int>(-value);
+        return -1;
+    }
+    return static_cast<int>(value);
+}
+
+int StatX(const char* path, unsigned int mask, struct statx* buf) {
+    return SyscallResult(InternalSyscallImpl(
+        SYS_statx, int64_t{AT_FDCWD}, reinterpret_cast<int64_t>(path),
+        int64_t{0}, static_cast<int64_t>(mask),
+        reinterpret_cast<int64_t>(buf)));
+}
+
+int FAccessAt(const char* path, int mode) {
+    return SyscallResult(InternalSyscallImpl(
+        SYS_faccessat, int64_t{AT_FDCWD}, reinterpret_cast<int64_t>(path),
+        static_cast<int64_t>(mode)));
+}
+
+int64_t NowSeconds() {
+    struct timespec now = {};
+    InternalSyscallImpl(SYS_clock_gettime, int64_t{CLOCK_REALTIME},
+                        reinterpret_cast<int64_t>(&now));
+    return now.tv_sec;
+}
+
+constexpr const char kDefaultPath[] = "/usr/local/bin:/bin:/usr/bin";
+
+size_t Length(const char* str) {
+    size_t length = 0;
+    while (str[length] != '\0') {
+        ++length;
+    }
+    return length;
+}
+
+bool Equal(const char* lhs, const char* rhs, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (lhs[i] != rhs[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Copy(char* to, const char* from, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        to[i] = from[i];
+    }
+}
+
+bool HasSlash(const char* str) {
+    for (; *str != '\0'; ++str) {
+        if (*str == '/') {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* GetPath() {
+    for (char** env = Environ; env != nullptr && *env != nullptr; ++env) {
+        if (Equal(*env, "PATH=", 5)) {
+            return *env + 5;
+        }
+    }
+    return kDefaultPath;
+}
+
+bool IsSkippable(int error) {
+    return error == ENOENT || error == ENOTDIR || error == EACCES;
+}
+
+// Splits PATH and builds "dir/file" for every component in turn. An empty
+// component is the current directory, as in glibc.
+class Candidates {
+  public:
+    Candidates(const char* path, const char* file)
+        : next_{path}, file_{file}, file_length_{Length(file)} {
+    }
+
+    // Moves to the next component. Returns false when there are none left
+    // or the candidate would not fit PATH_MAX; the latter is skipped.
+    bool Next() {
+        while (next_ != nullptr) {
+            const char* begin = next_;
+            const char* end = begin;
+            while (*end != '\0' && *end != ':') {
+                ++end;
+            }
+            next_ = *end == ':' ? end + 1 : nullptr;
+            ++index_;
+
+            size_t dir_length = end - begin;
+            if (dir_length + 1 + file_length_ + 1 > sizeof(buffer_)) {
+                continue;
+            }
+            Copy(buffer_, begin, dir_length);
+            buffer_[dir_length] = '\0';
+            dir_length_ = dir_length;
+            absolute_ = dir_length != 0 && *begin == '/';
+            return true;
+        }
+        return false;
+    }
+
+    // The directory of the component, "." for an empty one.
+    const char* Dir() {
+        buffer_[dir_length_] = '\0';
+        return dir_length_ == 0 ? "." : buffer_;
+    }
+
+    const char* Candidate() {
+        size_t offset = 0;
+        if (dir_length_ != 0) {
+            buffer_[dir_length_] = '/';
+            offset = dir_length_ + 1;
+        }
+        Copy(buffer_ + offset, file_, file_length_ + 1);
+        return dir_length_ == 0 ? buffer_ + offset : buffer_;
+    }
+
+    // Zero-based index of the current component.
+    size_t Index() const {
+        return index_ - 1;
+    }
+
+    bool Absolute() const {
+        return absolute_;
+    }
+
+  private:
+    const char* next_;
+    const char* file_;
+    size_t file_length_;
+    size_t dir_length_ = 0;
+    size_t index_ = 0;
+    bool absolute_ = false;
+    char buffer_[PATH_MAX + 1];
+};
+
+// Directory mtime, or `exists == false` for a missing one.
+struct Stamp {
+    int64_t sec;
+    uint32_t nsec;
+    uint32_t exists;
+};
+
+Stamp StampOf(const char* dir) {
+    struct statx st;
+    if (StatX(dir, STATX_MTIME, &st) == -1) {
+        return {.sec = 0, .nsec = 0, .exists = 0};
+    }
+    return {.sec = st.stx_mtime.tv_sec,
+            .nsec = st.stx_mtime.tv_nsec,
+            .exists = 1};
+}
+
+bool operator==(const Stamp& lhs, const Stamp& rhs) {
+    return lhs.sec == rhs.sec && lhs.nsec == rhs.nsec &&
+           lhs.exists == rhs.exists;
+}
+
+// Resolved paths keyed by (PATH, file), all kept in a static arena.
+//
+// A file found in the k-th PATH directory stays the answer until one of
+// the first k + 1 directories changes: a new file in an earlier one would
+// shadow it, and removing or renaming it changes its own directory. So an
+// entry keeps the mtimes of those directories, and a hit costs one statx
+// per directory up to the one the file is in, instead of a failed execve
+// per directory. Changing the mode of an existing file does not touch the
+// directory, though. So a result is cached only when the file is missing
+// from every earlier directory, and a hit still checks the file itself:
+// ResolveExecutable with IsExecutable, ExecVPE by falling back to walking
+// PATH when execve fails.
+//
+// Timestamps have limited resolution, so a directory changed right after
+// it was stamped may keep its old mtime. Lookups that find a directory
+// modified less than kRacyMargin seconds before are not cached.
+//
+// Only PATHs whose directories up to the hit are absolute are cached, as
+// relative ones depend on the working directory. When the arena or the
+// table fills up, the whole cache is dropped.
+namespace path_cache {
+
+constexpr int64_t kRacyMargin = 2;
+constexpr size_t kSlots = 256;
+constexpr size_t kMaxLoad = kSlots * 3 / 4;
+constexpr size_t kArenaSize = 1 << 16;
+constexpr size_t kMaxDirs = 64;
+
+struct Entry {
+    uint64_t hash;
+    const char* path;
+    const char* file;
+    const char* resolved;
+    const Stamp* stamps;
+    size_t dirs;
+};
+
+alignas(Stamp) char arena[kArenaSize];
+size_t arena_used = 0;
+Entry slots[kSlots];
+size_t used_slots = 0;
+
+// FNV-1a over PATH, a separator and the file.
+uint64_t Hash(const char* path, const char* file) {
+    uint64_t hash = 0xcbf29ce484222325;
+    auto mix = [&hash](const char* str) {
+        for (; *str != '\0'; ++str) {
+            hash = (hash ^ static_cast<unsigned char>(*str)) * 0x100000001b3;
+        }
+        hash = (hash ^ 0xff) * 0x100000001b3;
+    };
+    mix(path);
+    mix(file);
+    return hash;
+}
+
+void Clear() {
+    for (auto& slot : slots) {
+        slot = {};
+    }
+    arena_used = 0;
+    used_slots = 0;
+}
+
+void* Take(size_t size) {
+    size_t offset = (arena_used + alignof(Stamp) - 1) & ~(alignof(Stamp) - 1);
+    if (offset + size > kArenaSize) {
+        return nullptr;
+    }
+    arena_used = offset + size;
+    return arena + offset;
+}
+
+const char* Save(const char* str) {
+    size_t size = Length(str) + 1;
+    auto* copy = static_cast<char*>(Take(size));
+    if (copy != nullptr) {
+        Copy(copy, str, size);
+    }
+    return copy;
+}
+
+// The slot of the key, or the empty slot where it would go.
+Entry* Find(uint64_t hash, const char* path, const char* file) {
+    for (size_t i = hash % kSlots;; i = (i + 1) % kSlots) {
+        Entry& slot = slots[i];
+        if (slot.path == nullptr) {
+            return &slot;
+        }
+        if (slot.hash == hash && Length(slot.path) == Length(path) &&
+            Equal(slot.path, path, Length(path)) &&
+            Length(slot.file) == Length(file) &&
+            Equal(slot.file, file, Length(file))) {
+            return &slot;
+        }
+    }
+}
+
+bool IsFresh(const Entry& entry) {
+    Candidates dirs{entry.path, entry.file};
+    for (size_t i = 0; i < entry.dirs; ++i) {
+        if (!dirs.Next() || dirs.Index() != i ||
+            !(StampOf(dirs.Dir()) == entry.stamps[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The cached path if it is still valid, nullptr otherwise.
+const char* Lookup(const char* path, const char* file) {
+    const Entry* entry = Find(Hash(path, file), path, file);
+    if (entry->path == nullptr || !IsFresh(*entry)) {
+        return nullptr;
+    }
+    return entry->resolved;
+}
+
+void Insert(const char* path, const char* file, const char* resolved,
+            const Stamp* stamps, size_t dirs) {
+    uint64_t hash = Hash(path, file);
+    Entry* entry = Find(hash, path, file);
+    if (entry->path == nullptr && used_slots == kMaxLoad) {
+        Clear();
+        entry = Find(hash, path, file);
+    }
+
+    // Two attempts: the second one with an empty arena.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        auto* saved_stamps =
+            static_cast<Stamp*>(Take(sizeof(Stamp) * dirs));
+        const char* saved_path = Save(path);
+        const char* saved_file = Save(file);
+        const char* saved_resolved = Save(resolved);
+        if (saved_stamps != nullptr && saved_resolved != nullptr &&
+            saved_path != nullptr && saved_file != nullptr) {
+            for (size_t i = 0; i < dirs; ++i) {
+                saved_stamps[i] = stamps[i];
+            }
+            if (entry->path == nullptr) {
+                ++used_slots;
+            }
+            *entry = {.hash = hash,
+                      .path = saved_path,
+                      .file = saved_file,
+                      .resolved = saved_resolved,
+                      .stamps = saved_stamps,
+                      .dirs = dirs};
+            return;
+        }
+        Clear();
+        entry = Find(hash, path, file);
+    }
+}
+
+}  // namespace path_cache
+
+bool IsExecutable(const char* path) {
+    struct statx st;
+    if (StatX(path, STATX_TYPE | STATX_MODE, &st) == -1) {
+        return false;
+    }
+    if ((st.stx_mode & S_IFMT) != S_IFREG) {
+        Errno = EACCES;
+        return false;
+    }
+    return FAccessAt(path, X_OK) == 0;
+}
+
+int CopyOut(const char* path, char* resolved, size_t size) {
+    size_t length = Length(path);
+    if (length + 1 > size) {
+        Errno = ENAMETOOLONG;
+        return -1;
+    }
+    Copy(resolved, path, length + 1);
+    return 0;
+}
+
+}  // namespace
 
 int ExecVPE(const char* file, const char** argv, const char** envp) {
-    UNUSED(file, argv, envp);  // TODO: remove before flight.
-    return 1;  // TODO: remove before flight.
+    if (*file == '\0') {
+        Errno = ENOENT;
+        return -1;
+    }
+    if (HasSlash(file)) {
+        return ExecVE(file, argv, envp);
+    }
+
+    const char* path = GetPath();
+    if (const char* cached = path_cache::Lookup(path, file)) {
+        ExecVE(cached, argv, envp);
+        if (!IsSkippable(Errno)) {
+            return -1;
+        }
+    }
+
+    bool denied = false;
+    Candidates candidates{path, file};
+    while (candidates.Next()) {
+        ExecVE(candidates.Candidate(), argv, envp);
+        if (!IsSkippable(Errno)) {
+            return -1;
+        }
+        denied = denied || Errno == EACCES;
+    }
+    Errno = denied ? EACCES : ENOENT;
+    return -1;
+}
+
+int ResolveExecutable(const char* file, char* resolved, size_t size) {
+    if (*file == '\0') {
+        Errno = ENOENT;
+        return -1;
+    }
+    if (HasSlash(file)) {
+        return IsExecutable(file) ? CopyOut(file, resolved, size) : -1;
+    }
+
+    const char* path = GetPath();
+    const char* cached = path_cache::Lookup(path, file);
+    if (cached != nullptr && IsExecutable(cached)) {
+        return CopyOut(cached, resolved, size);
+    }
+
+    Stamp stamps[path_cache::kMaxDirs];
+    int64_t racy_since = NowSeconds() - path_cache::kRacyMargin;
+    bool cacheable = true;
+    bool denied = false;
+    Candidates candidates{path, file};
+    while (candidates.Next()) {
+        size_t index = candidates.Index();
+        cacheable = cacheable && candidates.Absolute() &&
+                    index < path_cache::kMaxDirs;
+        if (cacheable) {
+            stamps[index] = StampOf(candidates.Dir());
+            cacheable = stamps[index].sec < racy_since;
+        }
+        const char* candidate = candidates.Candidate();
+        if (IsExecutable(candidate)) {
+            if (cacheable) {
+                path_cache::Insert(path, file, candidate, stamps, index + 1);
+            }
+            return CopyOut(candidate, resolved, size);
+        }
+        // A file that is here but not executable may become executable
+        // without changing the directory.
+        cacheable = cacheable && Errno == ENOENT;
+        denied = denied || Errno == EACCES;
+    }
+    Errno = denied ? EACCES : ENOENT;
+    return -1;
 }
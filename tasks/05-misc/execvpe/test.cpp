@@ -0,0 +1,190 @@
+#include <syscalls.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Defined in execvpe.cpp.
+int ResolveExecutable(const char* file, char* resolved, size_t size);
+
+// Provided by the startup code of the freestanding build.
+char** Environ = nullptr;
+
+extern "C" void Unreachable() {
+    std::abort();
+}
+
+namespace {
+
+// A temporary directory with PATH set to some of its subdirectories.
+class Sandbox {
+  public:
+    Sandbox() {
+        char pattern[] = "/tmp/execvpe-XXXXXX";
+        REQUIRE(mkdtemp(pattern) != nullptr);
+        root_ = pattern;
+    }
+
+    ~Sandbox() {
+        Environ = nullptr;
+        std::filesystem::remove_all(root_);
+    }
+
+    std::string Path(const std::string& name) const {
+        return root_ + "/" + name;
+    }
+
+    void MakeDir(const std::string& name) const {
+        REQUIRE(mkdir(Path(name).c_str(), 0755) == 0);
+    }
+
+    void MakeFile(const std::string& name, mode_t mode = 0755) const {
+        int fd = open(Path(name).c_str(), O_WRONLY | O_CREAT | O_EXCL, mode);
+        REQUIRE(fd != -1);
+        close(fd);
+    }
+
+    // Moves the mtime of a directory out of the racy window, so that what
+    // is found in it can be cached.
+    void Age(const std::string& name) const {
+        timespec times[2] = {{.tv_sec = 1'000'000'000, .tv_nsec = 0},
+                             {.tv_sec = 1'000'000'000, .tv_nsec = 0}};
+        REQUIRE(utimensat(AT_FDCWD, Path(name).c_str(), times, 0) == 0);
+    }
+
+    void SetPath(const std::string& path) {
+        path_ = "PATH=" + path;
+        env_[0] = path_.data();
+        Environ = env_;
+    }
+
+  private:
+    std::string root_;
+    std::string path_;
+    char* env_[2] = {nullptr, nullptr};
+};
+
+// The resolved path, or "" with `*error` set to Errno.
+std::string Resolve(const char* file, int* error = nullptr) {
+    char resolved[PATH_MAX];
+    if (ResolveExecutable(file, resolved, sizeof(resolved)) == -1) {
+        if (error != nullptr) {
+            *error = Errno;
+        }
+        return "";
+    }
+    return resolved;
+}
+
+}  // namespace
+
+TEST_CASE("CacheHit") {
+    Sandbox sandbox;
+    sandbox.MakeDir("a");
+    sandbox.MakeDir("b");
+    sandbox.MakeFile("b/tool");
+    sandbox.Age("a");
+    sandbox.Age("b");
+    sandbox.SetPath(sandbox.Path("a") + ":" + sandbox.Path("b"));
+
+    CHECK(Resolve("tool") == sandbox.Path("b/tool"));
+
+    // A hit still checks the file itself.
+    REQUIRE(chmod(sandbox.Path("b/tool").c_str(), 0644) == 0);
+    int error = 0;
+    CHECK(Resolve("tool", &error).empty());
+    CHECK(error == EACCES);
+}
+
+TEST_CASE("RacyDirectoriesAreNotCached") {
+    Sandbox sandbox;
+    sandbox.MakeDir("a");
+    sandbox.MakeFile("a/tool");
+    sandbox.SetPath(sandbox.Path("a"));
+
+    CHECK(Resolve("tool") == sandbox.Path("a/tool"));
+
+    REQUIRE(chmod(sandbox.Path("a/tool").c_str(), 0644) == 0);
+    int error = 0;
+    CHECK(Resolve("tool", &error).empty());
+    CHECK(error == EACCES);
+}
+
+TEST_CASE("ShadowedByEarlierDirectory") {
+    Sandbox sandbox;
+    sandbox.MakeDir("a");
+    sandbox.MakeDir("b");
+    sandbox.MakeFile("b/tool");
+    sandbox.Age("a");
+    sandbox.Age("b");
+    sandbox.SetPath(sandbox.Path("a") + ":" + sandbox.Path("b"));
+
+    CHECK(Resolve("tool") == sandbox.Path("b/tool"));
+    sandbox.MakeFile("a/tool");
+    CHECK(Resolve("tool") == sandbox.Path("a/tool"));
+}
+
+TEST_CASE("EarlierFileBecomesExecutable") {
+    Sandbox sandbox;
+    sandbox.MakeDir("a");
+    sandbox.MakeDir("b");
+    sandbox.MakeFile("a/tool", 0644);
+    sandbox.MakeFile("b/tool");
+    sandbox.Age("a");
+    sandbox.Age("b");
+    sandbox.SetPath(sandbox.Path("a") + ":" + sandbox.Path("b"));
+
+    CHECK(Resolve("tool") == sandbox.Path("b/tool"));
+    // chmod does not change the mtime of the directory.
+    REQUIRE(chmod(sandbox.Path("a/tool").c_str(), 0755) == 0);
+    CHECK(Resolve("tool") == sandbox.Path("a/tool"));
+}
+
+TEST_CASE("RemovedFile") {
+    Sandbox sandbox;
+    sandbox.MakeDir("a");
+    sandbox.MakeFile("a/tool");
+    sandbox.Age("a");
+    sandbox.SetPath(sandbox.Path("a"));
+
+    CHECK(Resolve("tool") == sandbox.Path("a/tool"));
+    REQUIRE(unlink(sandbox.Path("a/tool").c_str()) == 0);
+    int error = 0;
+    CHECK(Resolve("tool", &error).empty());
+    CHECK(error == ENOENT);
+}
+
+TEST_CASE("RelativePath") {
+    Sandbox sandbox;
+    sandbox.MakeDir("a");
+    sandbox.MakeDir("a/bin");
+    sandbox.MakeFile("a/bin/tool");
+    sandbox.MakeDir("b");
+    sandbox.MakeDir("b/bin");
+    sandbox.Age("a/bin");
+    sandbox.Age("b/bin");
+    sandbox.SetPath("bin");
+
+    char cwd[PATH_MAX];
+    REQUIRE(getcwd(cwd, sizeof(cwd)) != nullptr);
+
+    REQUIRE(chdir(sandbox.Path("a").c_str()) == 0);
+    CHECK(Resolve("tool") == "bin/tool");
+
+    // The same PATH means another directory now.
+    REQUIRE(chdir(sandbox.Path("b").c_str()) == 0);
+    int error = 0;
+    CHECK(Resolve("tool", &error).empty());
+    CHECK(error == ENOENT);
+
+    REQUIRE(chdir(cwd) == 0);
+}
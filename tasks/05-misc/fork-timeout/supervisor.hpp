@@ -0,0 +1,341 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Time limits of one child, in seconds; fractions are fine. The child gets
+// SIGTERM once `timeout` passes and SIGKILL `kill_after` later if it is
+// still running. Infinity disables either step.
+struct TimeLimits {
+    double timeout = std::numeric_limits<double>::infinity();
+    double kill_after = std::numeric_limits<double>::infinity();
+};
+
+struct SupervisedExit {
+    pid_t pid = -1;
+    // The status in the format of waitpid.
+    int status = 0;
+    // Whether the supervisor sent SIGTERM and SIGKILL to the child. The
+    // child may still have exited on its own after them.
+    bool timed_out = false;
+    bool killed = false;
+};
+
+namespace supervisor_detail {
+
+using Clock = std::chrono::steady_clock;
+
+// The wrappers from <sys/pidfd.h> lack C linkage in some glibc versions.
+inline int PidfdOpen(pid_t pid) {
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+inline int PidfdSendSignal(int pidfd, int signal) {
+    return static_cast<int>(
+        syscall(SYS_pidfd_send_signal, pidfd, signal, nullptr, 0));
+}
+
+// Converts seconds to a duration, Clock::duration::max() for infinity.
+// Returns false for a negative or NaN number.
+inline bool ToDuration(double seconds, Clock::duration* duration) {
+    if (!(seconds >= 0)) {
+        return false;
+    }
+    std::chrono::duration<double> limit{seconds};
+    if (!std::isfinite(seconds) || limit >= Clock::duration::max()) {
+        *duration = Clock::duration::max();
+    } else {
+        *duration = std::chrono::duration_cast<Clock::duration>(limit);
+    }
+    return true;
+}
+
+inline Clock::time_point After(Clock::time_point now,
+                               Clock::duration duration) {
+    if (duration >= Clock::time_point::max() - now) {
+        return Clock::time_point::max();
+    }
+    return now + duration;
+}
+
+}  // namespace supervisor_detail
+
+// Watches children of the calling process from a single thread and
+// enforces their time limits.
+//
+// Every child is held by a pidfd, so signals always reach the right
+// process even if its pid is reused, and the children sit in one epoll
+// set together with a single timerfd. The timer is armed for the nearest
+// deadline only: the deadlines are kept in a heap, so a thousand children
+// cost a thousand pidfds and nothing else, and the thread sleeps in
+// epoll_wait until a child exits or a deadline passes.
+//
+// Only children passed to Watch are reaped. Children still watched when
+// the supervisor is destroyed are left alone.
+class Supervisor {
+  public:
+    static std::variant<Supervisor, int> Create() {
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd == -1) {
+            return errno;
+        }
+        Supervisor supervisor{epoll_fd};
+        supervisor.timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (supervisor.timer_fd_ == -1) {
+            return errno;
+        }
+        epoll_event event = {.events = EPOLLIN, .data = {.u64 = kTimerId}};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, supervisor.timer_fd_,
+                      &event) == -1) {
+            return errno;
+        }
+        return supervisor;
+    }
+
+    Supervisor(Supervisor&& other)
+        : epoll_fd_{std::exchange(other.epoll_fd_, -1)},
+          timer_fd_{std::exchange(other.timer_fd_, -1)},
+          armed_{other.armed_},
+          next_id_{other.next_id_},
+          children_{std::move(other.children_)},
+          deadlines_{std::move(other.deadlines_)},
+          exited_{std::move(other.exited_)} {
+    }
+
+    Supervisor& operator=(Supervisor&& other) {
+        Supervisor tmp{std::move(other)};
+        std::swap(epoll_fd_, tmp.epoll_fd_);
+        std::swap(timer_fd_, tmp.timer_fd_);
+        std::swap(armed_, tmp.armed_);
+        std::swap(next_id_, tmp.next_id_);
+        std::swap(children_, tmp.children_);
+        std::swap(deadlines_, tmp.deadlines_);
+        std::swap(exited_, tmp.exited_);
+        return *this;
+    }
+
+    ~Supervisor() {
+        for (const auto& [id, child] : children_) {
+            close(child.pidfd);
+        }
+        if (timer_fd_ != -1) {
+            close(timer_fd_);
+        }
+        if (epoll_fd_ != -1) {
+            close(epoll_fd_);
+        }
+    }
+
+    // Starts enforcing `limits` on `pid`, counting from now. The child must
+    // not have been reaped yet. Returns 0 or an errno: EINVAL for negative
+    // limits, and whatever pidfd_open or epoll_ctl fail with.
+    int Watch(pid_t pid, const TimeLimits& limits) {
+        using namespace supervisor_detail;
+        Child child = {.pid = pid};
+        Clock::duration timeout;
+        if (!ToDuration(limits.timeout, &timeout) ||
+            !ToDuration(limits.kill_after, &child.kill_after)) {
+            return EINVAL;
+        }
+        child.pidfd = PidfdOpen(pid);
+        if (child.pidfd == -1) {
+            return errno;
+        }
+        uint64_t id = next_id_++;
+        epoll_event event = {.events = EPOLLIN, .data = {.u64 = id}};
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, child.pidfd, &event) == -1) {
+            int err = errno;
+            close(child.pidfd);
+            return err;
+        }
+        child.deadline = After(Clock::now(), timeout);
+        Schedule(id, child.deadline);
+        children_.emplace(id, child);
+        return 0;
+    }
+
+    // The number of watched children not yet returned by Next.
+    size_t Size() const {
+        return children_.size();
+    }
+
+    // Waits until some watched child exits, sending signals to the others
+    // as their deadlines pass, then reaps it. Returns ECHILD if no child is
+    // watched, or the errno of a failed epoll_wait or timerfd_settime.
+    std::variant<SupervisedExit, int> Next() {
+        constexpr int kMaxEvents = 64;
+        while (exited_.empty()) {
+            if (children_.empty()) {
+                return ECHILD;
+            }
+            if (int err = ArmTimer(); err != 0) {
+                return err;
+            }
+            epoll_event events[kMaxEvents];
+            int ready = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+            if (ready == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno;
+            }
+            for (int i = 0; i < ready; ++i) {
+                if (events[i].data.u64 != kTimerId) {
+                    exited_.push_back(events[i].data.u64);
+                }
+            }
+            SendDueSignals();
+        }
+
+        uint64_t id = exited_.front();
+        exited_.pop_front();
+        auto node = children_.extract(id);
+        return Reap(node.mapped());
+    }
+
+  private:
+    using Clock = supervisor_detail::Clock;
+
+    static constexpr uint64_t kTimerId =
+        std::numeric_limits<uint64_t>::max();
+
+    struct Child {
+        pid_t pid;
+        int pidfd = -1;
+        Clock::duration kill_after = {};
+        Clock::time_point deadline = {};
+        bool timed_out = false;
+        bool killed = false;
+    };
+
+    // A deadline of the child with `id`. Entries are not removed when the
+    // child exits or moves on to the next deadline; they are skipped once
+    // they reach the top and no longer match the child.
+    struct Deadline {
+        Clock::time_point when;
+        uint64_t id;
+
+        bool operator>(const Deadline& other) const {
+            return when > other.when;
+        }
+    };
+
+    explicit Supervisor(int epoll_fd) : epoll_fd_{epoll_fd} {
+    }
+
+    void Schedule(uint64_t id, Clock::time_point when) {
+        if (when != Clock::time_point::max()) {
+            deadlines_.push({.when = when, .id = id});
+        }
+    }
+
+    bool IsStale(const Deadline& deadline) const {
+        auto it = children_.find(deadline.id);
+        return it == children_.end() || it->second.deadline != deadline.when;
+    }
+
+    // Arms the timer for the nearest deadline, or disarms it if there are
+    // none. The deadline is absolute, so time spent between here and
+    // epoll_wait is not added to it. Setting the timer also clears an
+    // expiration that was not read, so the timerfd is never read at all.
+    int ArmTimer() {
+        while (!deadlines_.empty() && IsStale(deadlines_.top())) {
+            deadlines_.pop();
+        }
+        itimerspec spec = {};
+        if (!deadlines_.empty()) {
+            auto since_epoch = deadlines_.top().when.time_since_epoch();
+            auto seconds =
+                std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+            spec.it_value.tv_sec = seconds.count();
+            spec.it_value.tv_nsec =
+                std::chrono::nanoseconds{since_epoch - seconds}.count();
+            // A zero it_value disarms the timer, but this one has passed.
+            if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+                spec.it_value.tv_nsec = 1;
+            }
+        } else if (!armed_) {
+            return 0;
+        }
+        if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) ==
+            -1) {
+            return errno;
+        }
+        armed_ = !deadlines_.empty();
+        return 0;
+    }
+
+    // Sends SIGTERM or SIGKILL to every child whose deadline has passed.
+    void SendDueSignals() {
+        using supervisor_detail::After;
+        using supervisor_detail::PidfdSendSignal;
+        auto now = Clock::now();
+        while (!deadlines_.empty() && deadlines_.top().when <= now) {
+            Deadline due = deadlines_.top();
+            deadlines_.pop();
+            if (IsStale(due)) {
+                continue;
+            }
+            Child& child = children_.at(due.id);
+            // Fails with ESRCH only if the child has exited already, and
+            // then its pidfd is readable and it is reaped as usual.
+            if (!child.timed_out) {
+                PidfdSendSignal(child.pidfd, SIGTERM);
+                child.timed_out = true;
+                child.deadline = After(now, child.kill_after);
+                Schedule(due.id, child.deadline);
+            } else {
+                PidfdSendSignal(child.pidfd, SIGKILL);
+                child.killed = true;
+                child.deadline = Clock::time_point::max();
+            }
+        }
+    }
+
+    // Reaps an exited child and drops its pidfd. Closing it is not enough
+    // to leave the epoll set: children forked later hold copies of it.
+    SupervisedExit Reap(const Child& child) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, child.pidfd, nullptr);
+        siginfo_t info = {};
+        while (waitid(P_PIDFD, child.pidfd, &info, WEXITED) == -1 &&
+               errno == EINTR) {
+        }
+        close(child.pidfd);
+        int status = W_EXITCODE(0, info.si_status) |
+                     (info.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+        if (info.si_code == CLD_EXITED) {
+            status = W_EXITCODE(info.si_status, 0);
+        }
+        return {.pid = child.pid,
+                .status = status,
+                .timed_out = child.timed_out,
+                .killed = child.killed};
+    }
+
+    int epoll_fd_ = -1;
+    int timer_fd_ = -1;
+    bool armed_ = false;
+    uint64_t next_id_ = 0;
+    std::unordered_map<uint64_t, Child> children_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>>
+        deadlines_;
+    std::deque<uint64_t> exited_;
+};
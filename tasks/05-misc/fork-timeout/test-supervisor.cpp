@@ -0,0 +1,170 @@
+#include "supervisor.hpp"
+
+#include <fd-guard.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <csignal>
+#include <map>
+
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Supervisor MakeSupervisor() {
+    auto created = Supervisor::Create();
+    REQUIRE(created.index() == 0);
+    return std::get<0>(std::move(created));
+}
+
+// Forks a child that exits with `code` after `seconds`, or never if
+// `seconds` is negative.
+pid_t Child(double seconds, int code = 0, bool ignore_term = false) {
+    pid_t pid = fork();
+    REQUIRE(pid != -1);
+    if (pid == 0) {
+        // Catch's handler for SIGTERM is inherited and would report it.
+        signal(SIGTERM, ignore_term ? SIG_IGN : SIG_DFL);
+        if (seconds < 0) {
+            while (true) {
+                pause();
+            }
+        }
+        usleep(static_cast<useconds_t>(seconds * 1e6));
+        _exit(code);
+    }
+    return pid;
+}
+
+SupervisedExit Next(Supervisor& supervisor) {
+    auto exited = supervisor.Next();
+    REQUIRE(exited.index() == 0);
+    return std::get<0>(exited);
+}
+
+double Since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+TEST_CASE("ExitsInTime") {
+    FileDescriptorsGuard guard;
+    {
+        auto supervisor = MakeSupervisor();
+        pid_t pid = Child(0.01, 7);
+        REQUIRE(supervisor.Watch(pid, {.timeout = 5, .kill_after = 1}) == 0);
+        CHECK(supervisor.Size() == 1);
+
+        auto result = Next(supervisor);
+        CHECK(result.pid == pid);
+        REQUIRE(WIFEXITED(result.status));
+        CHECK(WEXITSTATUS(result.status) == 7);
+        CHECK_FALSE(result.timed_out);
+        CHECK_FALSE(result.killed);
+        CHECK(supervisor.Size() == 0);
+        CHECK(std::get<int>(supervisor.Next()) == ECHILD);
+    }
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("SubSecondTimeout") {
+    auto supervisor = MakeSupervisor();
+    auto start = Clock::now();
+    REQUIRE(supervisor.Watch(Child(-1), {.timeout = 0.05}) == 0);
+
+    auto result = Next(supervisor);
+    double elapsed = Since(start);
+    REQUIRE(WIFSIGNALED(result.status));
+    CHECK(WTERMSIG(result.status) == SIGTERM);
+    CHECK(result.timed_out);
+    CHECK_FALSE(result.killed);
+    CHECK(elapsed >= 0.05);
+    CHECK(elapsed < 0.5);
+}
+
+TEST_CASE("KillAfterGrace") {
+    auto supervisor = MakeSupervisor();
+    auto start = Clock::now();
+    pid_t pid = Child(-1, 0, true);
+    // Lets the child ignore SIGTERM before it comes.
+    usleep(20'000);
+    REQUIRE(supervisor.Watch(pid, {.timeout = 0.02, .kill_after = 0.1}) ==
+            0);
+
+    auto result = Next(supervisor);
+    double elapsed = Since(start);
+    REQUIRE(WIFSIGNALED(result.status));
+    CHECK(WTERMSIG(result.status) == SIGKILL);
+    CHECK(result.timed_out);
+    CHECK(result.killed);
+    CHECK(elapsed >= 0.14);
+    CHECK(elapsed < 1);
+}
+
+TEST_CASE("ExitsDuringGrace") {
+    auto supervisor = MakeSupervisor();
+    pid_t pid = Child(0.1, 3, true);
+    REQUIRE(supervisor.Watch(pid, {.timeout = 0.02, .kill_after = 5}) == 0);
+
+    auto result = Next(supervisor);
+    REQUIRE(WIFEXITED(result.status));
+    CHECK(WEXITSTATUS(result.status) == 3);
+    CHECK(result.timed_out);
+    CHECK_FALSE(result.killed);
+}
+
+TEST_CASE("ManyChildren") {
+    FileDescriptorsGuard guard;
+    {
+        constexpr int kChildren = 300;
+        auto supervisor = MakeSupervisor();
+        auto start = Clock::now();
+
+        // Even children exit by themselves, odd ones hang until their own
+        // deadline, which comes in reverse order of starting.
+        std::map<pid_t, int> index;
+        for (int i = 0; i < kChildren; ++i) {
+            bool hangs = i % 2 == 1;
+            pid_t pid = Child(hangs ? -1 : 0.001 * (i % 50), i % 100);
+            index[pid] = i;
+            double timeout = hangs ? 0.3 - 0.001 * i : 10;
+            REQUIRE(supervisor.Watch(pid, {.timeout = timeout}) == 0);
+        }
+        REQUIRE(supervisor.Size() == kChildren);
+
+        for (int i = 0; i < kChildren; ++i) {
+            auto result = Next(supervisor);
+            REQUIRE(index.contains(result.pid));
+            int child = index[result.pid];
+            index.erase(result.pid);
+            if (child % 2 == 1) {
+                REQUIRE(WIFSIGNALED(result.status));
+                CHECK(WTERMSIG(result.status) == SIGTERM);
+                CHECK(result.timed_out);
+            } else {
+                REQUIRE(WIFEXITED(result.status));
+                CHECK(WEXITSTATUS(result.status) == child % 100);
+                CHECK_FALSE(result.timed_out);
+            }
+        }
+        CHECK(index.empty());
+        CHECK(Since(start) < 3);
+        CHECK(std::get<int>(supervisor.Next()) == ECHILD);
+    }
+    CHECK(guard.TestDescriptorsState());
+}
+
+TEST_CASE("InvalidLimits") {
+    FileDescriptorsGuard guard;
+    {
+        auto supervisor = MakeSupervisor();
+        CHECK(supervisor.Watch(getpid(), {.timeout = -1}) == EINVAL);
+        CHECK(supervisor.Watch(getpid(), {.kill_after = NAN}) == EINVAL);
+        CHECK(supervisor.Size() == 0);
+    }
+    CHECK(guard.TestDescriptorsState());
+}
@@ -1,6 +1,118 @@
-#include <unused.hpp>  // TODO: remove before flight.
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kFailure = 125;
+constexpr int kTimedOut = 124;
+
+int Usage() {
+    std::fprintf(stderr, "usage: timeout duration command [args ...]\n");
+    return kFailure;
+}
+
+// A non-negative integer number of seconds.
+bool ParseDuration(const char* str, unsigned* seconds) {
+    if (*str == '\0') {
+        return false;
+    }
+    unsigned long value = 0;
+    for (; *str != '\0'; ++str) {
+        if (*str < '0' || *str > '9') {
+            return false;
+        }
+        value = value * 10 + (*str - '0');
+        if (value > UINT_MAX) {
+            return false;
+        }
+    }
+    *seconds = static_cast<unsigned>(value);
+    return true;
+}
+
+int Wait(pid_t pid, int* status) {
+    pid_t res;
+    do {
+        res = waitpid(pid, status, 0);
+    } while (res == -1 && errno == EINTR);
+    return res;
+}
+
+int ExitCode(int status) {
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
-    UNUSED(argc, argv);  // TODO: remove before flight.
-    // TODO: your code here.
+    unsigned seconds;
+    if (argc < 3 || !ParseDuration(argv[1], &seconds)) {
+        return Usage();
+    }
+    char** command = argv + 2;
+
+    pid_t child = fork();
+    if (child == -1) {
+        std::perror("timeout: fork");
+        return kFailure;
+    }
+    if (child == 0) {
+        execvp(command[0], command);
+        std::fprintf(stderr, "timeout: %s: %s\n", command[0],
+                     std::strerror(errno));
+        _exit(kFailure);
+    }
+
+    int status;
+    // Zero means no limit, as in coreutils.
+    if (seconds == 0) {
+        return Wait(child, &status) == -1 ? kFailure : ExitCode(status);
+    }
+
+    // The second child only sleeps, so whichever of the two exits first
+    // tells whether the command finished in time.
+    pid_t timer = fork();
+    if (timer == -1) {
+        std::perror("timeout: fork");
+        kill(child, SIGKILL);
+        Wait(child, &status);
+        return kFailure;
+    }
+    if (timer == 0) {
+        // sleep returns what is left if a signal interrupts it.
+        while ((seconds = sleep(seconds)) > 0) {
+        }
+        _exit(0);
+    }
+
+    pid_t first;
+    do {
+        first = wait(&status);
+    } while (first == -1 && errno == EINTR);
+
+    if (first == timer) {
+        kill(child, SIGTERM);
+        Wait(child, &status);
+        return kTimedOut;
+    }
+    // SIGKILL: the timer inherits the dispositions of the parent, which may
+    // ignore SIGTERM.
+    kill(timer, SIGKILL);
+    Wait(timer, nullptr);
+    if (first == -1) {
+        std::perror("timeout: wait");
+        kill(child, SIGKILL);
+        Wait(child, &status);
+        return kFailure;
+    }
+    return ExitCode(status);
 }
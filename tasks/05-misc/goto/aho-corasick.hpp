@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+// A string literal that can be passed as a template argument.
+template <size_t N>
+struct FixedString {
+    constexpr FixedString(const char (&str)[N]) {
+        std::copy_n(str, N, chars);
+    }
+
+    constexpr std::string_view View() const {
+        return {chars, N - 1};
+    }
+
+    char chars[N] = {};
+};
+
+namespace aho_corasick_detail {
+
+inline constexpr int kNone = -1;
+
+template <size_t kMax>
+using UintFor = std::conditional_t<
+    kMax <= UINT8_MAX, uint8_t,
+    std::conditional_t<kMax <= UINT16_MAX, uint16_t, uint32_t>>;
+
+template <size_t kPatterns>
+using Patterns = std::array<std::string_view, kPatterns>;
+
+// Bytes that occur in the patterns get classes 1, 2, ... in order of
+// appearance, all the others share class 0. The automaton moves the same
+// way on all bytes of a class, so its rows only need a column per class.
+template <size_t kPatterns>
+consteval std::array<uint8_t, 256> ByteClasses(
+    const Patterns<kPatterns>& patterns) {
+    std::array<uint8_t, 256> classes{};
+    int next = 1;
+    for (auto pattern : patterns) {
+        for (char c : pattern) {
+            auto& cls = classes[static_cast<unsigned char>(c)];
+            if (cls == 0) {
+                cls = static_cast<uint8_t>(next++);
+            }
+        }
+    }
+    return classes;
+}
+
+consteval size_t ClassCount(const std::array<uint8_t, 256>& classes) {
+    return *std::max_element(classes.begin(), classes.end()) + size_t{1};
+}
+
+// The trie of the patterns completed to a DFA: `next` has a transition for
+// every state and class. States are numbered in the order of insertion.
+template <size_t kPatterns, size_t kMaxStates, size_t kClasses>
+struct Trie {
+    std::array<int, kMaxStates * kClasses> next{};
+    // The longest proper suffix of the state that is a state too, and the
+    // longest one that ends a pattern.
+    std::array<int, kMaxStates> fail{};
+    std::array<int, kMaxStates> dict{};
+    std::array<bool, kMaxStates> terminal{};
+    // The state reached by each pattern.
+    std::array<int, kPatterns> ends{};
+    // States in the order of breadth-first search, so by depth.
+    std::array<int, kMaxStates> order{};
+    size_t size = 1;
+};
+
+template <size_t kMaxStates, size_t kClasses, size_t kPatterns>
+consteval auto BuildTrie(const Patterns<kPatterns>& patterns,
+                         const std::array<uint8_t, 256>& classes) {
+    Trie<kPatterns, kMaxStates, kClasses> trie;
+    trie.next.fill(kNone);
+    trie.dict.fill(kNone);
+    for (size_t p = 0; p < kPatterns; ++p) {
+        int state = 0;
+        for (char c : patterns[p]) {
+            auto& next = trie.next[state * kClasses +
+                                   classes[static_cast<unsigned char>(c)]];
+            if (next == kNone) {
+                next = static_cast<int>(trie.size++);
+            }
+            state = next;
+        }
+        trie.terminal[state] = true;
+        trie.ends[p] = state;
+    }
+
+    // A child's failure link is the parent's one moved by the same class.
+    // It is shallower than the child, so its row is complete by then.
+    size_t head = 0;
+    size_t tail = 1;
+    while (head < tail) {
+        int state = trie.order[head++];
+        for (size_t cls = 0; cls < kClasses; ++cls) {
+            int fallback =
+                state == 0 ? 0 : trie.next[trie.fail[state] * kClasses + cls];
+            int& next = trie.next[state * kClasses + cls];
+            if (next == kNone) {
+                next = fallback;
+                continue;
+            }
+            trie.fail[next] = fallback;
+            trie.dict[next] =
+                trie.terminal[fallback] ? fallback : trie.dict[fallback];
+            trie.order[tail++] = next;
+        }
+    }
+    return trie;
+}
+
+}  // namespace aho_corasick_detail
+
+// Counts occurrences of every pattern in a text in a single pass, with an
+// Aho-Corasick automaton built at compile time. Occurrences may overlap:
+// "aa" occurs twice in "aaa". Patterns must not be empty.
+//
+//     using Keywords = PatternCounter<"error", "warning", "timeout">;
+//     auto [errors, warnings, timeouts] = Keywords::Count(log);
+//
+// The automaton is a dense table indexed by the state and the class of the
+// next byte, so a step is two loads and no branches. States are renumbered
+// so that the ones where some pattern ends come last, which leaves a single
+// well-predicted comparison per byte to find out whether to count. Each of
+// them is counted once per visit; matches of shorter patterns that end at
+// the same byte are added at the end along the dictionary links.
+//
+// Long texts are split into several parts scanned in the same loop. The
+// next state depends on the previous one through a load, and independent
+// chains let the CPU overlap their latencies.
+template <FixedString... Patterns>
+class PatternCounter {
+  public:
+    static constexpr size_t kPatterns = sizeof...(Patterns);
+
+    static_assert(kPatterns > 0);
+    static_assert(((Patterns.View().size() > 0) && ...),
+                  "patterns must not be empty");
+
+    static constexpr std::array<std::string_view, kPatterns> kPatternViews = {
+        Patterns.View()...};
+
+    using Counts = std::array<size_t, kPatterns>;
+
+    static Counts Count(std::string_view text) {
+        std::array<size_t, kOutStates> hits{};
+        const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+        size_t size = text.size();
+
+        size_t pos = 0;
+        Offset state = 0;
+        if (size / kLanes >= std::max(kMinLane, kMaxLength)) {
+            size_t lane = size / kLanes;
+            // A lane counts matches that end inside it. Those that start
+            // before it are found since every lane but the first starts a
+            // pattern length early, and the automaton state depends only on
+            // that many last bytes.
+            const unsigned char* lanes[kLanes];
+            Offset states[kLanes] = {};
+            lanes[0] = bytes;
+            for (size_t i = 1; i < kLanes; ++i) {
+                lanes[i] = bytes + i * lane;
+                for (const auto* p = lanes[i] - (kMaxLength - 1); p < lanes[i];
+                     ++p) {
+                    states[i] = Next(states[i], *p);
+                }
+            }
+            // Written out so the states stay in registers.
+            static_assert(kLanes == 4);
+            auto [s0, s1, s2, s3] = states;
+            for (size_t j = 0; j < lane; ++j) {
+                s0 = Next(s0, lanes[0][j]);
+                s1 = Next(s1, lanes[1][j]);
+                s2 = Next(s2, lanes[2][j]);
+                s3 = Next(s3, lanes[3][j]);
+                Hit(s0, hits);
+                Hit(s1, hits);
+                Hit(s2, hits);
+                Hit(s3, hits);
+            }
+            state = s3;
+            pos = kLanes * lane;
+        }
+        for (; pos < size; ++pos) {
+            state = Next(state, bytes[pos]);
+            Hit(state, hits);
+        }
+
+        // The dictionary link is shallower, so it comes earlier.
+        for (size_t i = kOutStates; i-- > 0;) {
+            if (kDictLinks[i] != aho_corasick_detail::kNone) {
+                hits[kDictLinks[i]] += hits[i];
+            }
+        }
+        Counts counts;
+        for (size_t p = 0; p < kPatterns; ++p) {
+            counts[p] = hits[kEnds[p]];
+        }
+        return counts;
+    }
+
+    // The number of states of the automaton and of the byte classes.
+    static constexpr size_t States() {
+        return kStates;
+    }
+
+    static constexpr size_t Classes() {
+        return kClasses;
+    }
+
+  private:
+    static constexpr size_t kLanes = 4;
+    static constexpr size_t kMinLane = 4096;
+
+    static constexpr size_t kMaxLength =
+        std::max({Patterns.View().size()...});
+    static constexpr size_t kMaxStates =
+        1 + (Patterns.View().size() + ...);
+
+    static constexpr std::array<uint8_t, 256> kByteClasses =
+        aho_corasick_detail::ByteClasses(kPatternViews);
+    static constexpr size_t kClasses =
+        aho_corasick_detail::ClassCount(kByteClasses);
+
+    static constexpr auto kTrie =
+        aho_corasick_detail::BuildTrie<kMaxStates, kClasses>(kPatternViews,
+                                                             kByteClasses);
+    static constexpr size_t kStates = kTrie.size;
+
+    // States are stored premultiplied by kClasses, as offsets of their
+    // rows in the table, which takes a multiplication off the chain.
+    using Offset = aho_corasick_detail::UintFor<kStates * kClasses>;
+
+    static constexpr bool IsOut(int state) {
+        return kTrie.terminal[state] ||
+               kTrie.dict[state] != aho_corasick_detail::kNone;
+    }
+
+    static constexpr size_t kOutStates = [] {
+        size_t count = 0;
+        for (size_t i = 0; i < kStates; ++i) {
+            count += IsOut(static_cast<int>(i));
+        }
+        return count;
+    }();
+    static constexpr size_t kFirstOut = kStates - kOutStates;
+
+    // New numbers of the trie states: the others first, then the ones
+    // where something ends, both by depth. The root stays 0.
+    static constexpr std::array<int, kStates> kIds = [] {
+        std::array<int, kStates> ids{};
+        int other = 0;
+        int out = static_cast<int>(kFirstOut);
+        for (size_t i = 0; i < kStates; ++i) {
+            int state = kTrie.order[i];
+            ids[state] = IsOut(state) ? out++ : other++;
+        }
+        return ids;
+    }();
+
+    static constexpr std::array<Offset, kStates * kClasses> kTable = [] {
+        std::array<Offset, kStates * kClasses> table{};
+        for (size_t state = 0; state < kStates; ++state) {
+            for (size_t cls = 0; cls < kClasses; ++cls) {
+                int next = kTrie.next[state * kClasses + cls];
+                table[kIds[state] * kClasses + cls] =
+                    static_cast<Offset>(kIds[next] * kClasses);
+            }
+        }
+        return table;
+    }();
+
+    // Indices below are of states in the out part, kNone for no link.
+    static constexpr std::array<int, kOutStates> kDictLinks = [] {
+        std::array<int, kOutStates> links{};
+        for (size_t state = 0; state < kStates; ++state) {
+            if (!IsOut(static_cast<int>(state))) {
+                continue;
+            }
+            int dict = kTrie.dict[state];
+            links[kIds[state] - kFirstOut] =
+                dict == aho_corasick_detail::kNone
+                    ? dict
+                    : kIds[dict] - static_cast<int>(kFirstOut);
+        }
+        return links;
+    }();
+
+    static constexpr std::array<size_t, kPatterns> kEnds = [] {
+        std::array<size_t, kPatterns> ends{};
+        for (size_t p = 0; p < kPatterns; ++p) {
+            ends[p] = kIds[kTrie.ends[p]] - kFirstOut;
+        }
+        return ends;
+    }();
+
+    static Offset Next(Offset state, unsigned char byte) {
+        return kTable[state + kByteClasses[byte]];
+    }
+
+    static void Hit(Offset state, std::array<size_t, kOutStates>& hits) {
+        if (state >= kFirstOut * kClasses) [[unlikely]] {
+            ++hits[state / kClasses - kFirstOut];
+        }
+    }
+};
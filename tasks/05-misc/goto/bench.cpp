@@ -0,0 +1,136 @@
+#include "aho-corasick.hpp"
+#include "count-substrings.h"
+
+#include <benchmark/compiler.hpp>
+#include <benchmark/timer.hpp>
+#include <distributions.hpp>
+#include <pcg-random.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Prints the cost per byte of counting keywords in a 64 MiB text in one
+// pass of PatternCounter and with one strstr pass per keyword: for the two
+// patterns of CountSubstrings in random lowercase text, where the goto
+// automaton runs too, and for a couple dozen keywords in a log.
+
+namespace {
+
+using LogKeywords =
+    PatternCounter<"ERROR", "WARN", "FATAL", "panic", "timeout", "refused",
+                   "denied", "segfault", "Traceback", "exception",
+                   "oom-kill", "killed", "retry", "failed", "unreachable",
+                   "reset by peer", "broken pipe", "ENOSPC", "EACCES",
+                   "ETIMEDOUT", "status=500", "status=503", "code 137",
+                   "deadlock">;
+
+constexpr size_t kTextSize = size_t{1} << 26;
+
+template <class F>
+double NanosPerByte(const std::string& text, F&& f) {
+    constexpr int kRuns = 3;
+    f(text);
+    CPUTimer timer;
+    for (int i = 0; i < kRuns; ++i) {
+        DoNotOptimize(f(text));
+    }
+    auto ns = std::chrono::duration<double, std::nano>(
+                  timer.GetTimes().wall_time)
+                  .count();
+    return ns / static_cast<double>(kRuns * text.size());
+}
+
+// Counts with one strstr pass per pattern, overlapping occurrences too.
+template <size_t N>
+size_t StrstrCount(const std::string& text,
+                   const std::array<std::string_view, N>& patterns) {
+    size_t total = 0;
+    for (auto pattern : patterns) {
+        // The views of PatternCounter point into null-terminated literals.
+        const char* p = text.c_str();
+        while ((p = std::strstr(p, pattern.data())) != nullptr) {
+            ++total;
+            ++p;
+        }
+    }
+    return total;
+}
+
+template <class Counter>
+size_t CounterCount(const std::string& text) {
+    size_t total = 0;
+    for (size_t count : Counter::Count(text)) {
+        total += count;
+    }
+    return total;
+}
+
+std::string LowercaseText(PCGRandom& rng) {
+    std::string text;
+    UniformCharDistribution distr('a', 'z');
+    while (text.size() < kTextSize) {
+        text.push_back(distr(rng));
+    }
+    return text;
+}
+
+std::string LogText(PCGRandom& rng) {
+    constexpr const char* kLevels[] = {"INFO", "INFO", "INFO", "DEBUG",
+                                       "WARN", "ERROR"};
+    constexpr const char* kMessages[] = {
+        "request served",
+        "connection reset by peer",
+        "retrying in 5s",
+        "upstream returned status=503",
+        "cache miss for key user:",
+        "job finished with code 137",
+        "permission denied while opening /var/lib/data",
+        "worker timeout after 30s",
+    };
+    std::string text;
+    char line[256];
+    while (text.size() < kTextSize) {
+        auto ms = rng.Generate32() % 1000;
+        std::snprintf(line, sizeof(line),
+                      "2026-10-18T12:%02u:%02u.%03u %s [pid %u] %s %u\n",
+                      ms % 60, ms % 59, ms, kLevels[rng.Generate32() % 6],
+                      rng.Generate32() % 32768,
+                      kMessages[rng.Generate32() % 8], rng.Generate32());
+        text += line;
+    }
+    return text;
+}
+
+}  // namespace
+
+int main() {
+    PCGRandom rng{4249};
+    using Substrings = PatternCounter<"rop", "os">;
+
+    auto lowercase = LowercaseText(rng);
+    std::printf("2 patterns in lowercase text, ns per byte\n");
+    std::printf("%-16s %8.3f\n", "goto automaton",
+                NanosPerByte(lowercase, [](const std::string& text) {
+                    auto count = CountSubstrings(text.c_str());
+                    return count.rop_num + count.os_num;
+                }));
+    std::printf("%-16s %8.3f\n", "PatternCounter",
+                NanosPerByte(lowercase, CounterCount<Substrings>));
+    std::printf("%-16s %8.3f\n", "strstr",
+                NanosPerByte(lowercase, [](const std::string& text) {
+                    return StrstrCount(text, Substrings::kPatternViews);
+                }));
+
+    auto log = LogText(rng);
+    std::printf("%zu patterns in a log, ns per byte\n", LogKeywords::kPatterns);
+    std::printf("%-16s %8.3f\n", "PatternCounter",
+                NanosPerByte(log, CounterCount<LogKeywords>));
+    std::printf("%-16s %8.3f\n", "strstr",
+                NanosPerByte(log, [](const std::string& text) {
+                    return StrstrCount(text, LogKeywords::kPatternViews);
+                }));
+    return 0;
+}
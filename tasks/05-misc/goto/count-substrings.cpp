@@ -1,8 +1,70 @@
 #include "count-substrings.h"
 
-#include <unused.hpp>  // TODO: remove before flight.
-
+// The automaton, one state per prefix of "os" and "rop" that can be the end
+// of the text read so far; transitions not listed lead to `start`:
+//
+//     start --o--> o      o  --o--> o    r  --r--> r    ro --o--> o
+//     start --r--> r      o  --r--> r    r  --o--> ro   ro --r--> r
+//                         o  --s--> start, ++os         ro --s--> start, ++os
+//                                                       ro --p--> start, ++rop
+//
+// "ros" ends with "os", hence the os count from `ro`. The ab automaton of
+// example.cpp is drawn in example.svg; this one is drawn the same way.
 SubstringsCount CountSubstrings(const char* s) {
-    UNUSED(s);  // TODO: remove before flight.
-    return {};  // TODO: remove before flight.
+    SubstringsCount count;
+start:
+    switch (*s++) {
+    case 'o':
+        goto o;
+    case 'r':
+        goto r;
+    case '\0':
+        goto finish;
+    default:
+        goto start;
+    }
+o:
+    switch (*s++) {
+    case 's':
+        ++count.os_num;
+        goto start;
+    case 'o':
+        goto o;
+    case 'r':
+        goto r;
+    case '\0':
+        goto finish;
+    default:
+        goto start;
+    }
+r:
+    switch (*s++) {
+    case 'o':
+        goto ro;
+    case 'r':
+        goto r;
+    case '\0':
+        goto finish;
+    default:
+        goto start;
+    }
+ro:
+    switch (*s++) {
+    case 'p':
+        ++count.rop_num;
+        goto start;
+    case 's':
+        ++count.os_num;
+        goto start;
+    case 'o':
+        goto o;
+    case 'r':
+        goto r;
+    case '\0':
+        goto finish;
+    default:
+        goto start;
+    }
+finish:
+    return count;
 }
@@ -1,3 +1,4 @@
+#include "aho-corasick.hpp"
 #include "count-substrings.h"
 
 #include <build.hpp>
@@ -8,6 +9,8 @@
 
 #include <cmath>
 #include <string>
+#include <string_view>
+#include <vector>
 
 std::ostream& operator<<(std::ostream& os, SubstringsCount cnt) {
     return os << "{rop = " << cnt.rop_num << ", os = " << cnt.os_num << "}";
@@ -85,3 +88,99 @@ TEST_CASE("StressTest") {
         }
     }
 }
+
+TEST_CASE("GeneratedAutomaton") {
+    using Counter = PatternCounter<"rop", "os">;
+    static_assert(Counter::States() == 6);
+    static_assert(Counter::Classes() == 5);
+
+    PatternCounter<"rop", "os">::Counts expected = {3, 3};
+    CHECK(Counter::Count("osososroproprop") == expected);
+
+    PCGRandom rng{43};
+    rng.Warmup();
+    for (size_t len : {0, 1, 100, 16383, 16384, 16387, 100000}) {
+        std::string test = GenerateBiasedString(len, rng);
+        auto [rop, os] = Counter::Count(test);
+        CHECK(SubstringsCount{.rop_num = rop, .os_num = os} ==
+              CountSubstrings(test.c_str()));
+    }
+}
+
+namespace {
+
+size_t NaiveCount(std::string_view text, std::string_view pattern) {
+    size_t count = 0;
+    for (auto pos = text.find(pattern); pos != std::string_view::npos;
+         pos = text.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+template <class Counter>
+void CheckAgainstNaive(std::string_view text) {
+    auto counts = Counter::Count(text);
+    for (size_t p = 0; p < Counter::kPatterns; ++p) {
+        INFO(Counter::kPatternViews[p]);
+        CHECK(counts[p] == NaiveCount(text, Counter::kPatternViews[p]));
+    }
+}
+
+}  // namespace
+
+TEST_CASE("NestedPatterns") {
+    // Patterns that are prefixes, suffixes and infixes of each other, and
+    // a duplicate.
+    using Counter = PatternCounter<"he", "she", "his", "hers", "e", "hershe",
+                                   "aaa", "a", "aa", "he">;
+    CheckAgainstNaive<Counter>("ushershehishers");
+    CheckAgainstNaive<Counter>("aaaaaaaaaa");
+    CheckAgainstNaive<Counter>("");
+
+    std::string text;
+    PCGRandom rng{44};
+    for (size_t i = 0; i < 50000; ++i) {
+        text.push_back("aehisr"[rng.Generate32() % 6]);
+    }
+    CheckAgainstNaive<Counter>(text);
+    CheckAgainstNaive<Counter>(std::string_view{text}.substr(1, 16385));
+}
+
+TEST_CASE("LogKeywords") {
+    using Counter =
+        PatternCounter<"ERROR", "WARN", "FATAL", "panic", "timeout",
+                       "timed out", "refused", "denied", "segfault",
+                       "Traceback", "exception", "Exception", "oom-kill",
+                       "Out of memory", "killed", "retry", "retrying",
+                       "failed", "failure", "unreachable", "reset by peer",
+                       "broken pipe", "ENOSPC", "EACCES", "ETIMEDOUT",
+                       "\xd0\x9e\xd1\x88", "\t\n", "\\", "status=5",
+                       "code 137">;
+    static_assert(Counter::kPatterns == 30);
+
+    std::vector<std::string_view> words;
+    for (auto pattern : Counter::kPatternViews) {
+        words.push_back(pattern);
+        // Halves of the patterns, so the automaton often goes far and falls
+        // back.
+        words.push_back(pattern.substr(0, pattern.size() / 2));
+        words.push_back(pattern.substr(pattern.size() / 2));
+    }
+    for (std::string_view word : {" ", "\n", "request ", "id=42 ", "\xff"}) {
+        words.push_back(word);
+    }
+    words.emplace_back("\0", 1);
+
+    PCGRandom rng{45};
+    rng.Warmup();
+    size_t len = 10;
+    for (int i = 0; i < 6; ++i) {
+        std::string text;
+        while (text.size() < len) {
+            text += words[rng.Generate32() % words.size()];
+        }
+        CheckAgainstNaive<Counter>(text);
+        len *= 10;
+    }
+}
@@ -1,9 +1,16 @@
+#include "utf-count.hpp"
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-int main() {
-    int total_chars = 0;
-    int cyrillic_chars = 0;
+#include <unistd.h>
 
-    // TODO: your code here.
-    std::cout << total_chars << ' ' << cyrillic_chars << std::endl;
+int main() {
+    Utf8Counts counts;
+    if (int err = CountUtf8FromFd(STDIN_FILENO, &counts); err != 0) {
+        std::cerr << std::strerror(-err) << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << counts.chars << ' ' << counts.cyrillic << std::endl;
 }
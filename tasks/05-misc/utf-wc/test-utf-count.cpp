@@ -0,0 +1,200 @@
+#include "utf-count.hpp"
+
+#include <internal-assert.hpp>
+#include <pcg-random.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr const char* kFileName = "/tmp/deleteme-utf-wc";
+
+std::ostream& operator<<(std::ostream& os, const Utf8Counts& counts) {
+    return os << "{chars = " << counts.chars
+              << ", cyrillic = " << counts.cyrillic << "}";
+}
+
+void AppendCodepoint(std::string* s, uint32_t cp) {
+    if (cp < 0x80) {
+        s->push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        s->push_back(static_cast<char>(0xC0 | cp >> 6));
+        s->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        s->push_back(static_cast<char>(0xE0 | cp >> 12));
+        s->push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3F)));
+        s->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        s->push_back(static_cast<char>(0xF0 | cp >> 18));
+        s->push_back(static_cast<char>(0x80 | (cp >> 12 & 0x3F)));
+        s->push_back(static_cast<char>(0x80 | (cp >> 6 & 0x3F)));
+        s->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Valid UTF-8 with characters of every length, mostly around the Cyrillic
+// block to hit its edges.
+std::string RandomText(size_t size, PCGRandom& rng) {
+    std::string s;
+    while (s.size() < size) {
+        uint32_t cp;
+        switch (rng() % 5) {
+            case 0:
+                cp = rng() % 0x80;
+                break;
+            case 1:
+                cp = 0x3F0 + rng() % 0x120;
+                break;
+            case 2:
+                cp = 0x80 + rng() % 0x780;
+                break;
+            case 3:
+                cp = 0x800 + rng() % 0xD000;
+                break;
+            default:
+                cp = 0x10000 + rng() % 0x100000;
+        }
+        AppendCodepoint(&s, cp);
+    }
+    return s;
+}
+
+// Decodes the text, unlike the kernels.
+Utf8Counts NaiveCount(std::string_view s) {
+    Utf8Counts counts;
+    for (size_t i = 0; i < s.size(); ++counts.chars) {
+        auto lead = static_cast<uint8_t>(s[i]);
+        size_t len = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+        uint32_t cp = len == 1 ? lead : lead & (0x7F >> len);
+        for (size_t k = 1; k < len; ++k) {
+            cp = cp << 6 | (static_cast<uint8_t>(s[i + k]) & 0x3F);
+        }
+        counts.cyrillic += cp >= 0x400 && cp <= 0x4FF;
+        i += len;
+    }
+    return counts;
+}
+
+struct TempFile {
+    explicit TempFile(std::string_view data) {
+        fd = open(kFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        INTERNAL_ASSERT(fd != -1);
+        size_t pos = 0;
+        while (pos < data.size()) {
+            ssize_t w = write(fd, data.data() + pos, data.size() - pos);
+            INTERNAL_ASSERT(w > 0);
+            pos += w;
+        }
+        INTERNAL_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    }
+
+    ~TempFile() {
+        close(fd);
+        unlink(kFileName);
+    }
+
+    int fd;
+};
+
+TEST_CASE("Example") {
+    std::string_view s = "Привет, мир! Ёж, Ѣ, ї, ӿ; Ԁ is not.\n";
+    CHECK(CountUtf8(s.data(), s.size()) ==
+          Utf8Counts{.chars = 36, .cyrillic = 14});
+    CHECK(CountUtf8(s.data(), 0) == Utf8Counts{});
+}
+
+TEST_CASE("Kernels") {
+    PCGRandom rng{4243};
+    auto data = RandomText(1 << 14, rng);
+
+    for (size_t iter = 0; iter < 2000; ++iter) {
+        // Starts and ends at characters, so the naive count can decode it.
+        size_t offset = rng() % 64;
+        while ((data[offset] & 0xC0) == 0x80) {
+            ++offset;
+        }
+        size_t end = offset + rng() % (data.size() - offset);
+        while (end < data.size() && (data[end] & 0xC0) == 0x80) {
+            ++end;
+        }
+        std::string_view s{data.data() + offset, end - offset};
+        auto expected = NaiveCount(s);
+
+        REQUIRE(CountUtf8(s.data(), s.size()) == expected);
+#if defined(__x86_64__)
+        REQUIRE(utf_count_detail::CountSse2(s.data(), s.size()) == expected);
+        if (__builtin_cpu_supports("avx2")) {
+            REQUIRE(utf_count_detail::CountAvx2(s.data(), s.size()) ==
+                    expected);
+        }
+#endif
+    }
+}
+
+TEST_CASE("SplitCharacters") {
+    PCGRandom rng{44};
+    auto data = RandomText(10000, rng);
+    auto expected = NaiveCount(data);
+    for (size_t split = 0; split < 64; ++split) {
+        auto counts = CountUtf8(data.data(), split);
+        counts += CountUtf8(data.data() + split, data.size() - split);
+        REQUIRE(counts == expected);
+    }
+}
+
+TEST_CASE("AllCyrillic") {
+    // Overflows the bytewise accumulators many times over.
+    std::string s;
+    for (int i = 0; i < (1 << 19); ++i) {
+        s += "ж";
+    }
+    CHECK(CountUtf8(s.data(), s.size()) ==
+          Utf8Counts{.chars = 1 << 19, .cyrillic = 1 << 19});
+}
+
+TEST_CASE("RegularFile") {
+    PCGRandom rng{43};
+    // Spans several mapping windows, with characters across their edges.
+    auto data = RandomText(utf_count_detail::kMapWindow * 2 + 12345, rng);
+    TempFile file{data};
+
+    Utf8Counts counts;
+    REQUIRE(CountUtf8FromFd(file.fd, &counts) == 0);
+    CHECK(counts == NaiveCount(data));
+    CHECK(lseek(file.fd, 0, SEEK_CUR) == static_cast<off_t>(data.size()));
+
+    // Starts at the current offset, not at the beginning.
+    size_t offset = 5000;
+    while ((data[offset] & 0xC0) == 0x80) {
+        ++offset;
+    }
+    REQUIRE(lseek(file.fd, offset, SEEK_SET) == static_cast<off_t>(offset));
+    REQUIRE(CountUtf8FromFd(file.fd, &counts) == 0);
+    CHECK(counts == NaiveCount(std::string_view{data}.substr(offset)));
+
+    REQUIRE(CountUtf8FromFd(file.fd, &counts) == 0);
+    CHECK(counts == Utf8Counts{});
+}
+
+TEST_CASE("Pipe") {
+    PCGRandom rng{4243};
+    auto data = RandomText(10000, rng);
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    REQUIRE(write(fds[1], data.data(), data.size()) ==
+            static_cast<ssize_t>(data.size()));
+    close(fds[1]);
+
+    Utf8Counts counts;
+    REQUIRE(CountUtf8FromFd(fds[0], &counts) == 0);
+    CHECK(counts == NaiveCount(data));
+    close(fds[0]);
+
+    CHECK(CountUtf8FromFd(-1, &counts) == -EBADF);
+}
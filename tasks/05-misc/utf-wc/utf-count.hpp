@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Characters of valid UTF-8 text, and how many of them are in the Cyrillic
+// block U+0400..U+04FF.
+//
+// Both are counted by looking at single bytes. Every character has exactly
+// one byte that is not a continuation byte 10xxxxxx, and the Cyrillic ones
+// are exactly those with lead bytes 0xD0..0xD3. So the text can be split
+// anywhere, even inside a character, and the counts of the parts add up.
+struct Utf8Counts {
+    uint64_t chars = 0;
+    uint64_t cyrillic = 0;
+
+    Utf8Counts& operator+=(const Utf8Counts& other) {
+        chars += other.chars;
+        cyrillic += other.cyrillic;
+        return *this;
+    }
+
+    bool operator==(const Utf8Counts&) const = default;
+};
+
+namespace utf_count_detail {
+
+inline constexpr size_t kReadBufferSize = 1 << 18;
+inline constexpr size_t kMapWindow = 1 << 24;
+
+inline Utf8Counts CountScalar(const char* data, size_t size) {
+    Utf8Counts counts;
+    for (size_t i = 0; i < size; ++i) {
+        auto byte = static_cast<uint8_t>(data[i]);
+        counts.chars += (byte & 0xC0) != 0x80;
+        counts.cyrillic += (byte & 0xFC) == 0xD0;
+    }
+    return counts;
+}
+
+#if defined(__x86_64__)
+
+inline uint64_t SumLanes(__m128i v) {
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(v)) +
+           static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v)));
+}
+
+__attribute__((target("avx2"))) inline uint64_t SumLanes(__m256i v) {
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+// Blocks are counted in bytewise accumulators: a matching byte is an all-ones
+// mask, -1, and subtracting it adds one. They are flushed into 64-bit lanes
+// with psadbw before any of them can overflow. Continuation bytes are the
+// signed ones below -64, so a single signed comparison finds characters.
+inline Utf8Counts CountSse2(const char* data, size_t size) {
+    const __m128i last_continuation = _mm_set1_epi8(-65);
+    const __m128i lead_mask = _mm_set1_epi8(static_cast<char>(0xFC));
+    const __m128i cyrillic_lead = _mm_set1_epi8(static_cast<char>(0xD0));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i chars = _mm_setzero_si128();
+    __m128i cyrillic = _mm_setzero_si128();
+
+    size_t i = 0;
+    while (i + 16 <= size) {
+        __m128i chars8 = _mm_setzero_si128();
+        __m128i cyrillic8 = _mm_setzero_si128();
+        size_t end = std::min(size - size % 16, i + 255 * 16);
+        for (; i < end; i += 16) {
+            __m128i b = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + i));
+            chars8 = _mm_sub_epi8(chars8,
+                                  _mm_cmpgt_epi8(b, last_continuation));
+            cyrillic8 = _mm_sub_epi8(
+                cyrillic8,
+                _mm_cmpeq_epi8(_mm_and_si128(b, lead_mask), cyrillic_lead));
+        }
+        chars = _mm_add_epi64(chars, _mm_sad_epu8(chars8, zero));
+        cyrillic = _mm_add_epi64(cyrillic, _mm_sad_epu8(cyrillic8, zero));
+    }
+
+    Utf8Counts counts = {.chars = SumLanes(chars),
+                         .cyrillic = SumLanes(cyrillic)};
+    return counts += CountScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline Utf8Counts CountAvx2(
+    const char* data, size_t size) {
+    const __m256i last_continuation = _mm256_set1_epi8(-65);
+    const __m256i lead_mask = _mm256_set1_epi8(static_cast<char>(0xFC));
+    const __m256i cyrillic_lead = _mm256_set1_epi8(static_cast<char>(0xD0));
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i chars = _mm256_setzero_si256();
+    __m256i cyrillic = _mm256_setzero_si256();
+
+    // Two blocks per step, each into its own accumulators, so a flush
+    // happens after 255 steps of 64 bytes.
+    size_t i = 0;
+    while (i + 64 <= size) {
+        __m256i chars8[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+        __m256i cyrillic8[2] = {_mm256_setzero_si256(),
+                                _mm256_setzero_si256()};
+        size_t end = std::min(size - size % 64, i + 255 * 64);
+        for (; i < end; i += 64) {
+            auto* p = reinterpret_cast<const __m256i*>(data + i);
+            for (int k = 0; k < 2; ++k) {
+                __m256i b = _mm256_loadu_si256(p + k);
+                chars8[k] = _mm256_sub_epi8(
+                    chars8[k], _mm256_cmpgt_epi8(b, last_continuation));
+                cyrillic8[k] = _mm256_sub_epi8(
+                    cyrillic8[k],
+                    _mm256_cmpeq_epi8(_mm256_and_si256(b, lead_mask),
+                                      cyrillic_lead));
+            }
+        }
+        chars = _mm256_add_epi64(
+            chars, _mm256_add_epi64(_mm256_sad_epu8(chars8[0], zero),
+                                    _mm256_sad_epu8(chars8[1], zero)));
+        cyrillic = _mm256_add_epi64(
+            cyrillic, _mm256_add_epi64(_mm256_sad_epu8(cyrillic8[0], zero),
+                                       _mm256_sad_epu8(cyrillic8[1], zero)));
+    }
+
+    Utf8Counts counts = {.chars = SumLanes(chars),
+                         .cyrillic = SumLanes(cyrillic)};
+    return counts += CountSse2(data + i, size - i);
+}
+
+using Kernel = Utf8Counts (*)(const char*, size_t);
+
+inline Kernel SelectKernel() {
+    return __builtin_cpu_supports("avx2") ? CountAvx2 : CountSse2;
+}
+
+#endif
+
+}  // namespace utf_count_detail
+
+// Counts of `data`, which may start and end in the middle of a character.
+// Uses AVX2 when the CPU has it and SSE2 otherwise; on other architectures
+// a scalar loop the compiler is free to vectorize.
+inline Utf8Counts CountUtf8(const char* data, size_t size) {
+#if defined(__x86_64__)
+    static const utf_count_detail::Kernel kernel =
+        utf_count_detail::SelectKernel();
+    return kernel(data, size);
+#else
+    return utf_count_detail::CountScalar(data, size);
+#endif
+}
+
+namespace utf_count_detail {
+
+// Regular files are mapped a window at a time from the current offset, so
+// memory use does not depend on the file size. Returns 1 if `fd` can not be
+// mapped and has to be read instead.
+inline int CountMapped(int fd, Utf8Counts* counts) {
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        return 1;
+    }
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    // Files like the ones in /proc report zero size but are not empty.
+    if (offset == -1 || offset >= st.st_size) {
+        return 1;
+    }
+
+    auto page = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+    off_t pos = offset - offset % page;
+    while (pos < st.st_size) {
+        auto len = static_cast<size_t>(
+            std::min<off_t>(kMapWindow, st.st_size - pos));
+        void* window = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, pos);
+        if (window == MAP_FAILED) {
+            // Nothing is consumed yet if the very first window fails.
+            return pos <= offset ? 1 : -errno;
+        }
+        madvise(window, len, MADV_SEQUENTIAL);
+        size_t skip = pos < offset ? static_cast<size_t>(offset - pos) : 0;
+        *counts +=
+            CountUtf8(static_cast<const char*>(window) + skip, len - skip);
+        munmap(window, len);
+        pos += static_cast<off_t>(len);
+    }
+    lseek(fd, st.st_size, SEEK_SET);
+    return 0;
+}
+
+}  // namespace utf_count_detail
+
+// Counts everything readable from `fd` in O(1) memory. Returns 0 or -errno.
+inline int CountUtf8FromFd(int fd, Utf8Counts* counts) {
+    *counts = {};
+    if (int res = utf_count_detail::CountMapped(fd, counts); res <= 0) {
+        return res;
+    }
+
+    auto buf = std::make_unique<char[]>(utf_count_detail::kReadBufferSize);
+    while (true) {
+        ssize_t res = read(fd, buf.get(), utf_count_detail::kReadBufferSize);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (res == 0) {
+            return 0;
+        }
+        *counts += CountUtf8(buf.get(), static_cast<size_t>(res));
+    }
+}